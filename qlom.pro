@@ -28,6 +28,7 @@ QMAKE_SUBSTITUTES += config.h.in
 HEADERS += \
 		   src/table.h \
 		   src/relationship.h \
+		   src/relationship_lookup.h \
 		   src/error.h \
 		   src/gui/list_view.h \
 		   src/gui/main_window.h \
@@ -36,12 +37,30 @@ HEADERS += \
 		   src/list_layout_model.h \
 		   src/layout_delegates.h \
 		   src/document.h \
+		   src/document_loader.h \
+		   src/metadata_cache.h \
+		   src/table_registry.h \
+		   src/startup_profiler.h \
+		   src/trace.h \
+		   src/query_statistics.h \
+		   src/gui/diagnostics_panel.h \
+		   src/paint_statistics.h \
+		   src/memory_budget.h \
+		   src/row_cache.h \
+		   src/row_page.h \
+		   src/display_formatter.h \
+		   src/sort_index.h \
+		   src/row_filter.h \
+		   src/quick_search.h \
+		   src/trigram_index.h \
+		   src/filter_kernels.h \
 		   src/utils.h
 
 SOURCES += \
 		   src/qlom.cc \
 		   src/table.cc \
 		   src/relationship.cc \
+		   src/relationship_lookup.cc \
 		   src/error.cc \
 		   src/gui/list_view.cc \
 		   src/gui/main_window.cc \
@@ -50,4 +69,21 @@ SOURCES += \
 		   src/list_layout_model.cc \
 		   src/layout_delegates.cc \
 		   src/document.cc \
+		   src/document_loader.cc \
+		   src/metadata_cache.cc \
+		   src/table_registry.cc \
+		   src/startup_profiler.cc \
+		   src/trace.cc \
+		   src/query_statistics.cc \
+		   src/gui/diagnostics_panel.cc \
+		   src/paint_statistics.cc \
+		   src/memory_budget.cc \
+		   src/row_cache.cc \
+		   src/row_page.cc \
+		   src/display_formatter.cc \
+		   src/sort_index.cc \
+		   src/row_filter.cc \
+		   src/quick_search.cc \
+		   src/trigram_index.cc \
+		   src/filter_kernels.cc \
 		   src/utils.cc
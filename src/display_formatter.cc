@@ -0,0 +1,237 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "display_formatter.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+/** The rows formatted by one task of formatPage(). */
+static const int rowsPerTask = 64;
+
+/** The memory used by the header of a QString, besides its characters. */
+static const qint64 stringHeaderBytes = 24;
+
+/** Formats a range of rows of a page, for QlomDisplayFormatter::formatPage().
+ *  Each task writes to its own rows of the texts, which are allocated before
+ *  the tasks start, so that no locking is needed. */
+class QlomFormatTask : public QRunnable
+{
+public:
+    /** Create a task.
+     *  @param[in] page the values
+     *  @param[in] formatters a formatter per column of the page
+     *  @param[out] texts the display texts, by column
+     *  @param[in] locale the locale to format for
+     *  @param[in] firstRow the first row to format
+     *  @param[in] lastRow the row after the last row to format
+     *  @param[in] done released once the rows are formatted, or 0 */
+    QlomFormatTask(const QlomRowPage &page,
+        const QVector<QlomDisplayFormatter> &formatters, QString *texts,
+        const QLocale &locale, int firstRow, int lastRow, QSemaphore *done) :
+        thePage(page),
+        theFormatters(formatters),
+        theTexts(texts),
+        theLocale(locale),
+        theFirstRow(firstRow),
+        theLastRow(lastRow),
+        theDone(done)
+    {}
+
+    /** Format the rows. */
+    virtual void run()
+    {
+        QLOM_TRACE_SCOPE("format rows", "format");
+        const int rows = thePage.rowCount();
+        for (int column = 0; column < theFormatters.size(); ++column) {
+            const QlomDisplayFormatter &formatter = theFormatters.at(column);
+            if (!formatter.isFormatting()) {
+                continue;
+            }
+
+            for (int row = theFirstRow; row < theLastRow; ++row) {
+                theTexts[column * rows + row] =
+                    formatter.format(thePage.value(row, column), theLocale);
+            }
+        }
+
+        if (theDone) {
+            theDone->release();
+        }
+    }
+
+private:
+    const QlomRowPage &thePage; /**< the values */
+    const QVector<QlomDisplayFormatter> &theFormatters; /**< by column */
+    QString *theTexts; /**< the display texts, by column */
+    const QLocale theLocale; /**< the locale to format for */
+    const int theFirstRow; /**< the first row to format */
+    const int theLastRow; /**< the row after the last row to format */
+    QSemaphore *theDone; /**< released once the rows are formatted */
+};
+
+QlomDisplayFormatter::QlomDisplayFormatter() :
+    theType(Glom::Field::TYPE_INVALID),
+    theThousandsSeparatorFlag(false),
+    thePrecision(0),
+    theFormat('g')
+{}
+
+Glom::Field::glom_field_type QlomDisplayFormatter::type() const
+{
+    return theType;
+}
+
+QlomDisplayFormatter::QlomDisplayFormatter(Glom::Field::glom_field_type type,
+    const Glom::NumericFormat &format) :
+    theType(type),
+    theThousandsSeparatorFlag(format.m_use_thousands_separator),
+    // TODO: check max precision in Glom source.
+    thePrecision(format.m_decimal_places_restricted
+        ? format.m_decimal_places : format.get_default_precision()),
+    /* 'g' trims trailing zeroes, although not documented in [1], whereas 'f'
+       prints the decimal places instead of using mantisse + exponent.
+       [1] http://doc.trolltech.com/4.6/qstring.html#argument-formats */
+    theFormat(format.m_decimal_places_restricted ? 'f' : 'g'),
+    theDateFormat(theLocale.dateFormat(QLocale::ShortFormat)),
+    theTimeFormat(theLocale.timeFormat(QLocale::ShortFormat))
+{
+    if (!format.m_currency_symbol.empty()) {
+        // Add a whitespace for the currency prefix.
+        theCurrencyPrefix =
+            ustringToQstring(format.m_currency_symbol) + QLatin1Char(' ');
+    }
+}
+
+bool QlomDisplayFormatter::isFormatting() const
+{
+    return (Glom::Field::TYPE_NUMERIC == theType
+        || Glom::Field::TYPE_DATE == theType
+        || Glom::Field::TYPE_TIME == theType);
+}
+
+QString QlomDisplayFormatter::format(const QVariant &value,
+    const QLocale &locale) const
+{
+    if (value.isNull()) {
+        return QString();
+    }
+
+    switch (theType) {
+    case Glom::Field::TYPE_NUMERIC: {
+        /* The Glom numeric type is treated as doubles by the Sqlite backend,
+         * and may be a string from other backends. */
+        bool conversionSucceeded = false;
+        const double numeric = value.toDouble(&conversionSucceeded);
+        if (conversionSucceeded) {
+            return formatNumber(numeric, locale);
+        }
+    } break;
+
+    case Glom::Field::TYPE_DATE: {
+        // QlomRowCache stores dates natively, so toDate() does not parse.
+        const QDate date = value.toDate();
+        if (date.isValid()) {
+            return formatDate(date, locale);
+        }
+    } break;
+
+    case Glom::Field::TYPE_TIME: {
+        const QTime time = value.toTime();
+        if (time.isValid()) {
+            return formatTime(time, locale);
+        }
+    } break;
+
+    default:
+        break;
+    }
+
+    return QString();
+}
+
+QString QlomDisplayFormatter::formatNumber(double numeric,
+    const QLocale &locale) const
+{
+    QLocale myLocale = QLocale(locale);
+
+    if(!theThousandsSeparatorFlag) {
+        myLocale.setNumberOptions(QLocale::OmitGroupSeparator);
+    } else {
+        myLocale.setNumberOptions(0); // Do not rely on defaults here.
+    }
+
+    // This already removes trailing zeroes and also adds thousand separators.
+    return theCurrencyPrefix
+        + myLocale.toString(numeric, theFormat, thePrecision);
+}
+
+QString QlomDisplayFormatter::formatDate(const QDate &date,
+    const QLocale &locale) const
+{
+    return (locale == theLocale ? theLocale.toString(date, theDateFormat)
+        : locale.toString(date, QLocale::ShortFormat));
+}
+
+QString QlomDisplayFormatter::formatTime(const QTime &time,
+    const QLocale &locale) const
+{
+    return (locale == theLocale ? theLocale.toString(time, theTimeFormat)
+        : locale.toString(time, QLocale::ShortFormat));
+}
+
+qint64 QlomDisplayFormatter::formatPage(const QlomRowPage &page,
+    const QVector<QlomDisplayFormatter> &formatters, QVector<QString> &texts,
+    const QLocale &locale)
+{
+    QLOM_TRACE_SCOPE("format page", "format");
+    const int rows = page.rowCount();
+    texts = QVector<QString>(formatters.size() * rows);
+
+    // Detach once, before the tasks write to their rows.
+    QString *data = texts.data();
+
+    // The calling thread formats the first rows itself.
+    QSemaphore done;
+    int tasks = 0;
+    for (int firstRow = rowsPerTask; firstRow < rows;
+         firstRow += rowsPerTask) {
+        QlomFormatTask *task = new QlomFormatTask(page, formatters, data,
+            locale, firstRow, qMin(firstRow + rowsPerTask, rows), &done);
+        QThreadPool::globalInstance()->start(task);
+        ++tasks;
+    }
+
+    QlomFormatTask(page, formatters, data, locale, 0,
+        qMin(rowsPerTask, rows), 0).run();
+    done.acquire(tasks);
+
+    qint64 bytes = texts.capacity() * sizeof(QString);
+    for (QVector<QString>::const_iterator iter = texts.begin();
+         iter != texts.end();
+         ++iter) {
+        if (!(*iter).isNull()) {
+            bytes += stringHeaderBytes + (*iter).size() * sizeof(QChar);
+        }
+    }
+
+    return bytes;
+}
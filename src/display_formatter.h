@@ -0,0 +1,112 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_DISPLAY_FORMATTER_H_
+#define QLOM_DISPLAY_FORMATTER_H_
+
+#include "row_page.h"
+
+#include <QDate>
+#include <QLocale>
+#include <QString>
+#include <QTime>
+#include <QVariant>
+#include <QVector>
+
+#include <libglom/data_structure/field.h>
+#include <libglom/data_structure/numeric_format.h>
+
+/** Formats the values of a field for display, following its Glom formatting.
+ *  The formatter copies what it needs from the Glom formatting, so that it
+ *  can be used on any thread: by the delegates of the view, and by the
+ *  formatting stage of QlomRowCache, which formats fetched pages on the
+ *  global QThreadPool before their rows are published. The date and time
+ *  formats of the default locale are looked up once, when the formatter is
+ *  created. */
+class QlomDisplayFormatter
+{
+public:
+    /** Create a formatter that formats nothing. */
+    QlomDisplayFormatter();
+
+    /** Create a formatter for a field.
+     *  @param[in] type the Glom type of the field
+     *  @param[in] format the numeric formatting of the field */
+    QlomDisplayFormatter(Glom::Field::glom_field_type type,
+        const Glom::NumericFormat &format);
+
+    /** Get the Glom type of the field. */
+    Glom::Field::glom_field_type type() const;
+
+    /** Whether format() formats any values of the field. If not, their
+     *  QVariant::toString() is shown. */
+    bool isFormatting() const;
+
+    /** Format a value.
+     *  @param[in] value the value
+     *  @param[in] locale the locale of the view
+     *  @returns the display text, or a null QString if the value is not
+     *  formatted */
+    QString format(const QVariant &value, const QLocale &locale) const;
+
+    /** Format a number, with the currency, thousands separators and decimal
+     *  places of the field.
+     *  @param[in] numeric the number
+     *  @param[in] locale the locale of the view
+     *  @returns the display text */
+    QString formatNumber(double numeric, const QLocale &locale) const;
+
+    /** Format a date, in the short format of the locale.
+     *  @param[in] date the date
+     *  @param[in] locale the locale of the view
+     *  @returns the display text */
+    QString formatDate(const QDate &date, const QLocale &locale) const;
+
+    /** Format a time, in the short format of the locale.
+     *  @param[in] time the time
+     *  @param[in] locale the locale of the view
+     *  @returns the display text */
+    QString formatTime(const QTime &time, const QLocale &locale) const;
+
+    /** Format the values of a page, splitting the rows across the global
+     *  QThreadPool. The calling thread formats a share of the rows as well,
+     *  and returns once all rows are formatted.
+     *  @param[in] page the values
+     *  @param[in] formatters a formatter per column of the page
+     *  @param[out] texts the display texts, by column, with null QStrings
+     *  for the values that are not formatted
+     *  @param[in] locale the locale to format for
+     *  @returns the memory used by texts, in bytes */
+    static qint64 formatPage(const QlomRowPage &page,
+        const QVector<QlomDisplayFormatter> &formatters,
+        QVector<QString> &texts, const QLocale &locale);
+
+private:
+    Glom::Field::glom_field_type theType; /**< the Glom type of the field */
+    QString theCurrencyPrefix; /**< the currency symbol and a space, or
+                                    empty */
+    bool theThousandsSeparatorFlag; /**< whether to group the digits */
+    int thePrecision; /**< the decimal places, or the significant digits */
+    char theFormat; /**< 'f' for fixed decimal places, otherwise 'g' */
+    QLocale theLocale; /**< the default locale, when the formatter was
+                            created */
+    QString theDateFormat; /**< the short date format of theLocale */
+    QString theTimeFormat; /**< the short time format of theLocale */
+};
+
+#endif /* QLOM_DISPLAY_FORMATTER_H_ */
@@ -21,6 +21,9 @@
 #include "tables_model.h"
 #include "list_layout_model.h"
 #include "connection_dialog.h"
+#include "metadata_cache.h"
+#include "startup_profiler.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <QDialog>
@@ -41,67 +44,219 @@
 
 QlomDocument::QlomDocument(QObject *parent) :
     QObject(parent),
-    document(0)
+    document(0),
+    theLoader(0),
+    theConnectingFlag(false),
+    theMemoryBudget(std::make_shared<QlomMemoryBudget>()),
+    theTables(std::make_shared<QlomTableRegistry>())
 {
     /* No document case. */
  }
 
+QlomDocument::~QlomDocument()
+{
+    // Loaders that were replaced by a newer load might still be running, too.
+    const QList<QlomDocumentLoader *> loaders =
+        findChildren<QlomDocumentLoader *>();
+    for (QList<QlomDocumentLoader *>::const_iterator iter = loaders.begin();
+         iter != loaders.end();
+         ++iter) {
+        (*iter)->disconnect(this);
+        (*iter)->cancel();
+        (*iter)->wait();
+    }
+
+    clear();
+}
+
 bool QlomDocument::loadDocument(const QString &filepath)
 {
-    QFileInfo info(filepath);
-    if(!info.exists()) {
-        qWarning("The file does not exist with filepath %s",
-            qPrintable(filepath));
+    clear();
 
-        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
-            tr("The file does not exist"),
-            Qlom::CRITICAL_ERROR_SEVERITY);
+    // The loader waits for libglom, which must be initialised here.
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.begin("libglom_init");
+    ensureLibglomInitialised();
+    profiler.end("libglom_init");
+
+    QlomDocumentLoader loader(filepath);
+    if(!loader.load()) {
+        theLastError = loader.lastError();
         return false;
     }
 
-    // filepathToUri provides an error if it fails.
-    const std::string uri(filepathToUri(filepath));
-    if(uri.empty()) {
-        return false;
+    document = loader.takeDocument();
+    theFilepath = filepath;
+    theDocumentStamp = loader.documentStamp();
+    if (loader.hasCachedTables()) {
+        setCachedTables(loader.cachedTables());
+        attachTableList();
+    } else {
+        fillTableList();
     }
 
-    // Load a Glom document with a given file URI.
-    document = new Glom::Document();
-    document->set_file_uri(uri);
-    int failure_code = 0;
-    const bool test = document->load(failure_code);
-    if(!test) {
-        qWarning("Document loading failed with uri %s (failure_code=%d)", 
-            uri.c_str(), failure_code);
+    return openConnection();
+}
 
-        QString message;
-        if(failure_code == Glom::Document::LOAD_FAILURE_CODE_FILE_VERSION_TOO_NEW) {
-           message = tr("The document's format is too new.");
-        }
-        else {
-           message = tr("libglom failed to load the Glom document");
-        }
-       
-        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN, message,
-            Qlom::CRITICAL_ERROR_SEVERITY);
-        return false;
+void QlomDocument::loadDocumentAsync(const QString &filepath)
+{
+    clear();
+
+    theLoader = new QlomDocumentLoader(filepath, this);
+    connect(theLoader, SIGNAL(stageStarted(int)),
+        this, SIGNAL(loadingStageChanged(int)));
+    connect(theLoader, SIGNAL(cachedMetadataLoaded()),
+        this, SLOT(onLoaderCachedMetadataLoaded()));
+    connect(theLoader, SIGNAL(finished()),
+        this, SLOT(onLoaderFinished()));
+    // The loader deletes itself, even if it was replaced by a newer load.
+    connect(theLoader, SIGNAL(finished()),
+        theLoader, SLOT(deleteLater()));
+    theLoader->start();
+
+    /* libglom is initialised on the main thread, once the event loop runs,
+     * so that the window is shown first. The loader waits for it. */
+    QMetaObject::invokeMethod(this, "onInitialiseLibglom",
+        Qt::QueuedConnection);
+}
+
+void QlomDocument::onInitialiseLibglom()
+{
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.begin("libglom_init");
+    ensureLibglomInitialised();
+    profiler.end("libglom_init");
+}
+
+void QlomDocument::cancelLoading()
+{
+    if (theLoader) {
+        theLoader->cancel();
     }
 
-    /* Check that the document is not an example document, which must be
-     * resaved — that would be an extra feature. */
-    if(document->get_is_example_file()) {
-        qWarning("Document is an example file, cannot process");
-        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
-            tr("Cannot open the document because it is an example file"),
-            Qlom::CRITICAL_ERROR_SEVERITY);
-        return false;
+    // onOpenConnection() notices that the connection is no longer wanted.
+    theConnectingFlag = false;
+}
+
+bool QlomDocument::isLoading() const
+{
+    return (0 != theLoader || theConnectingFlag);
+}
+
+void QlomDocument::onLoaderFinished()
+{
+    QlomDocumentLoader *loader = qobject_cast<QlomDocumentLoader *>(sender());
+    if (!loader || loader != theLoader) {
+        return; // A replaced loader, whose signals arrived late.
+    }
+
+    theLoader = 0;
+
+    if (loader->isCancelled()) {
+        Q_EMIT loadingCancelled();
+        return;
+    }
+
+    document = loader->takeDocument();
+    if (!document) {
+        theLastError = loader->lastError();
+        Q_EMIT loadingFailed();
+        return;
     }
 
-    /* Check that the document is not self-hosting, because that would require
-     * starting/stopping PostgreSQL. */
+    theFilepath = loader->filepath();
+    theDocumentStamp = loader->documentStamp();
+
+    // With a valid metadata cache, the table list is shown already.
+    if (loader->hasCachedTables()) {
+        attachTableList();
+    } else {
+        Q_EMIT loadingStageChanged(Qlom::TABLE_LIST_LOADING_STAGE);
+        fillTableList();
+        Q_EMIT metadataLoaded();
+        QlomStartupProfiler::instance().mark("table list shown");
+    }
+
+    // Let the event loop show the table list before connecting.
+    theConnectingFlag = true;
+    QMetaObject::invokeMethod(this, "onOpenConnection", Qt::QueuedConnection);
+}
+
+void QlomDocument::onLoaderCachedMetadataLoaded()
+{
+    QlomDocumentLoader *loader = qobject_cast<QlomDocumentLoader *>(sender());
+    if (!loader || loader != theLoader) {
+        return;
+    }
+
+    setCachedTables(loader->cachedTables());
+    Q_EMIT metadataLoaded();
+    QlomStartupProfiler::instance().mark("table list shown");
+}
+
+void QlomDocument::onOpenConnection()
+{
+    if (!document || theLoader) {
+        return; // Closed or replaced in the meantime.
+    }
+
+    if (!theConnectingFlag) {
+        Q_EMIT loadingCancelled();
+        return;
+    }
+
+    theConnectingFlag = false;
+    Q_EMIT loadingStageChanged(Qlom::CONNECTION_LOADING_STAGE);
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.begin("open connection");
+    const bool connected = openConnection();
+    profiler.end("open connection");
+    if (!connected) {
+        Q_EMIT loadingFailed();
+        return;
+    }
+
+    Q_EMIT documentLoaded();
+}
+
+void QlomDocument::clear()
+{
+    if (theLoader) {
+        // The loader deletes itself once it notices the cancellation.
+        theLoader->disconnect(this);
+        theLoader->cancel();
+        theLoader = 0;
+    }
+
+    theConnectingFlag = false;
+
+    /* The tables read so far are cached for the next time. Models might
+     * still hold copies of the tables, so they are detached from the
+     * document before it is destroyed. */
+    saveMetadataCache();
+    Glom::Document *oldDocument = document;
+    document = 0;
+    attachTableList();
+    delete oldDocument;
+    theTables = std::make_shared<QlomTableRegistry>();
+    theFilepath.clear();
+    theDocumentStamp = QlomMetadataCache::Stamp();
+}
+
+bool QlomDocument::openConnection()
+{
+    QLOM_TRACE_SCOPE("open connection", "load");
+    Q_ASSERT(document);
+
+    /* The loader has already checked that the hosting mode is supported, but
+     * the checks are kept together with the connection code. */
     switch (document->get_hosting_mode()) {
     case Glom::Document::HOSTING_MODE_POSTGRES_CENTRAL:
     {
+        if (!checkDriver("QPSQL")) {
+            return false;
+        }
+
         /* Modal dialogs can be deleted by code elsewhere, hence this resource
          * is wrapped in a QPointer. However, it's only correct if *each*
          * access to this resource is 0-checked afterwards. See
@@ -148,6 +303,10 @@ bool QlomDocument::loadDocument(const QString &filepath)
     break;
     case Glom::Document::HOSTING_MODE_SQLITE:
     {
+        if (!checkDriver("QSQLITE")) {
+            return false;
+        }
+
         if(!openSqlite()) {
             qWarning("Failed to open the SQLite database");
             theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
@@ -168,44 +327,70 @@ bool QlomDocument::loadDocument(const QString &filepath)
         break;
     }
 
-    fillTableList();
     return true;
 }
 
+bool QlomDocument::checkDriver(const QString &driver)
+{
+    /* Only the driver that the document needs is created, rather than
+     * enumerating all QtSql drivers with QSqlDatabase::drivers(), which is
+     * also what isDriverAvailable() does. The probe connection goes out of
+     * scope before it is removed. */
+    const QString probeName("qlom-driver-probe");
+    bool available = false;
+    {
+        const QSqlDatabase probe = QSqlDatabase::addDatabase(driver,
+            probeName);
+        available = probe.isValid();
+    }
+    QSqlDatabase::removeDatabase(probeName);
+
+    if (available) {
+        return true;
+    }
+
+    qWarning("The QtSql database driver %s is not available",
+        qPrintable(driver));
+    theLastError = QlomError(Qlom::DATABASE_ERROR_DOMAIN,
+        tr("Your installation of Qlom is not complete, because the QtSql "
+           "database driver %1, which this document needs, is not available "
+           "on your system.\n\nPlease report this bug to your vendor or your "
+           "system administrator so it can be corrected.").arg(driver),
+        Qlom::CRITICAL_ERROR_SEVERITY);
+    return false;
+}
+
 QlomTablesModel * QlomDocument::createTablesModel()
 {
-    return new QlomTablesModel(tableList, qobject_cast<QObject*>(this));
+    return new QlomTablesModel(theTables, qobject_cast<QObject*>(this));
 }
 
 QlomListLayoutModel * QlomDocument::createListLayoutModel(
     const QString &tableName)
 {
-    for (typeTableList::const_iterator iter = tableList.begin();
-         iter != tableList.end();
-         ++iter) {
-        if ((*iter).tableName() == tableName) {
-            bool error = false;
-            QlomListLayoutModel *model = new QlomListLayoutModel(document, *iter, error, this);
-            if (error) {
-                qWarning("GlomLayoutModel: no list model found");
-                theLastError = QlomError(Qlom::DATABASE_ERROR_DOMAIN,
-                    tr("%1: no list model found").arg("GlomLayoutModel"),
-                    Qlom::WARNING_ERROR_SEVERITY);
-                delete model;
-                model = 0;
-                return 0;
-            }
-            return model;
-        }
+    const QlomTable *table = theTables->findByName(tableName);
+    if (!table) {
+        /* TODO: change from critical to warning once Qlom can handle failed
+         * model initialisations. */
+        qWarning("Cannot find requested table.");
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("Cannot find requested table."), Qlom::CRITICAL_ERROR_SEVERITY);
+        return 0;
     }
 
-    /* TODO: change from critical to warning once Qlom can handle failed model
-     * initialisations. */
-    qWarning("Cannot find requested table.");
-    theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
-        tr("Cannot find requested table."), Qlom::CRITICAL_ERROR_SEVERITY);
-
-    return 0;
+    bool error = false;
+    QlomListLayoutModel *model = new QlomListLayoutModel(*table, error, this,
+        QSqlDatabase::database(), &theQueryStatistics, theMemoryBudget);
+    if (error) {
+        qWarning("GlomLayoutModel: no list model found");
+        theLastError = QlomError(Qlom::DATABASE_ERROR_DOMAIN,
+            tr("%1: no list model found").arg("GlomLayoutModel"),
+            Qlom::WARNING_ERROR_SEVERITY);
+        delete model;
+        model = 0;
+        return 0;
+    }
+    return model;
 }
 
 QlomListLayoutModel * QlomDocument::createDefaultTableListLayoutModel()
@@ -221,12 +406,10 @@ QlomListLayoutModel * QlomDocument::createDefaultTableListLayoutModel()
 
     //Use the first non-hidden table if a default table is not specified.
     if (defaultTable.isEmpty()) {
-        for (typeTableList::const_iterator iter = tableList.begin();
-            iter != tableList.end(); ++iter) {
-            const QlomTable& table = *iter;
-            const QString tableName = table.tableName();
-            if(!(document->get_table_is_hidden(qstringToUstring(tableName)))) {
-                defaultTable = tableName;
+        for (int index = 0; index < theTables->count(); ++index) {
+            const QlomTable &table = theTables->at(index);
+            if(!table.isHidden()) {
+                defaultTable = table.tableName();
                 break;
             }
        }
@@ -251,35 +434,14 @@ QlomError QlomDocument::lastError() const
     return theLastError;
 }
 
-std::string QlomDocument::filepathToUri(const QString &theFilepath)
+QlomQueryStatistics * QlomDocument::queryStatistics()
 {
-    const std::string filepath(theFilepath.toUtf8().constData());
-    std::string uri;
-
-#ifdef GLIBMM_EXCEPTIONS_ENABLED
-    try {
-        uri = Glib::filename_to_uri(filepath);
-    }
-    catch(const Glib::ConvertError& convertException) {
-        qWarning("Exception from Glib::filename_to_uri(): %s",
-            convertException.what().c_str());
-        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
-            tr("Failed to convert the document file name to a URI"),
-            Qlom::CRITICAL_ERROR_SEVERITY);
-    }
-#else /* !GLIBMM_EXCEPTIONS_ENABLED */
-    std::auto_ptr<Glib::Error> convertError;
-    uri = Glib::filename_to_uri(filepath, convertError);
-    if(convertError.get()) {
-        qWarning("Error from Glib::filename_to_uri(): %s",
-            convertError->what());
-        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
-            tr("Failed to convert the document file name to a URI"),
-            Qlom::CRITICAL_ERROR_SEVERITY);
-    }
-#endif /* GLIBMM_EXCEPTIONS_ENABLED */
+    return &theQueryStatistics;
+}
 
-    return uri;
+QlomMemoryBudget * QlomDocument::memoryBudget()
+{
+    return theMemoryBudget.get();
 }
 
 bool QlomDocument::openSqlite()
@@ -351,17 +513,14 @@ bool QlomDocument::openSqlite()
 
 void QlomDocument::fillTableList()
 {
-    Q_ASSERT(tableList.empty());
+    Q_ASSERT(0 == theTables->count());
+    QlomStartupPhase phase("fillTableList");
+    QLOM_TRACE_SCOPE("fillTableList", "load");
 
     GlomTables tables = document->get_tables();
     for(GlomTables::const_iterator iter(tables.begin());
         iter != tables.end(); ++iter) {
         std::shared_ptr<Glom::TableInfo> table = *iter;
-        Glom::Document::type_vec_relationships documentRelationships(
-            document->get_relationships(table->get_name()));
-        // Get a list of GlomRelationship items from the document.
-        QList<QlomRelationship> relationships(
-            fillRelationships(documentRelationships));
 
         // Check for flags.
         QFlags<QlomTable::QlomTableFlags> flags;
@@ -371,26 +530,33 @@ void QlomDocument::fillTableList()
             flags |= QlomTable::DEFAULT_TABLE;
 
         // Fill the GlomDocument with a list of GlomTables.
-        tableList.push_back(QlomTable(ustringToQstring(table->get_name()),
-            ustringToQstring(document->get_table_title(table->get_name(), getCurrentLocaleId())),
-            relationships, flags));
+        theTables->addTable(QlomTable(ustringToQstring(table->get_name()),
+            flags, document));
+    }
+}
+
+void QlomDocument::attachTableList()
+{
+    theTables->setDocument(document);
+}
+
+void QlomDocument::setCachedTables(const QList<QlomTable> &tables)
+{
+    Q_ASSERT(0 == theTables->count());
+
+    for (QList<QlomTable>::const_iterator iter = tables.begin();
+         iter != tables.end();
+         ++iter) {
+        theTables->addTable(*iter);
     }
 }
 
-QList<QlomRelationship> QlomDocument::fillRelationships(
-    const Glom::Document::type_vec_relationships &documentRelationships)
+void QlomDocument::saveMetadataCache()
 {
-    QList<QlomRelationship> relationships;
-    for (Glom::Document::type_vec_relationships::const_iterator iter(
-        documentRelationships.begin()); iter != documentRelationships.end();
-        ++iter) {
-        const std::shared_ptr<const Glom::Relationship>
-            documentRelationship(*iter);
-        relationships.push_back(QlomRelationship(
-            ustringToQstring(documentRelationship->get_from_field()),
-            ustringToQstring(documentRelationship->get_to_table()),
-            ustringToQstring(documentRelationship->get_to_field())));
-    }
-
-    return relationships;
+    if (!document || theFilepath.isEmpty()) {
+        return;
+    }
+
+    QlomMetadataCache::save(theFilepath, theTables->tables(),
+        theDocumentStamp);
 }
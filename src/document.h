@@ -20,11 +20,17 @@
 #define QLOM_DOCUMENT_H_
 
 
+class QlomDocumentLoader;
 class QlomListLayoutModel;
 class QlomTablesModel;
 
 #include "table.h"
+#include "table_registry.h"
 #include "error.h"
+#include "document_loader.h"
+#include "metadata_cache.h"
+#include "memory_budget.h"
+#include "query_statistics.h"
 
 #include <memory>
 #include <string>
@@ -38,13 +44,14 @@ class QlomTablesModel;
 /** A Glom document.
  *  A Glom document contains the information that is in a .glom file. It is
  *  initially blank, but a document can be loaded with the loadDocument()
- *  method. Models are obtained via the create*() calls. createTablesModel()
- *  creates a model for the list of tables in the document.
- *  createListLayoutModel() creates a model for the list layout of a
- *  specified table. createDefaultTableListLayoutModel() creates a model of the
- *  list layout for the default table of the document. As the create prefix
- *  suggests, the responsibility of destroying the models once they are no
- *  longer needed is placed on the caller. */
+ *  method, or without blocking the caller with loadDocumentAsync(). Models
+ *  are obtained via the create*() calls. createTablesModel() creates a model
+ *  for the list of tables in the document. createListLayoutModel() creates a
+ *  model for the list layout of a specified table.
+ *  createDefaultTableListLayoutModel() creates a model of the list layout for
+ *  the default table of the document. As the create prefix suggests, the
+ *  responsibility of destroying the models once they are no longer needed is
+ *  placed on the caller. */
 class QlomDocument : public QObject
 {
     Q_OBJECT
@@ -58,6 +65,10 @@ public:
      *  @param[in] parent a parent object, which errors will be sent to */
     QlomDocument(QObject *parent = 0);
 
+    /** Waits for a running loader, because a QThread must not be destroyed
+     *  while it runs. */
+    virtual ~QlomDocument();
+
     /** Load a Glom document from a file.
      *  Loads a Glom document from a file. This method can be called on a
      *  QlomDocument safely, even if a document has already been loaded.
@@ -66,6 +77,26 @@ public:
      *  @returns true on success, false on failure */
     bool loadDocument(const QString &filepath);
 
+    /** Load a Glom document from a file, without blocking the caller.
+     *  The file checks and the parsing run on a worker thread. The progress
+     *  is reported with loadingStageChanged(). Once the document is parsed,
+     *  or earlier if the document has a valid QlomMetadataCache sidecar,
+     *  metadataLoaded() is emitted, so that the table list can be shown while
+     *  the rest of the document is loaded. Finally, either documentLoaded(),
+     *  loadingFailed() or loadingCancelled() is emitted. A load that is still
+     *  running is cancelled.
+     *  @param[in] filepath the location of the Glom document as an absolute
+     *  filepath. */
+    void loadDocumentAsync(const QString &filepath);
+
+    /** Cancel a load started with loadDocumentAsync(). loadingCancelled() is
+     *  emitted once the worker thread has stopped. */
+    void cancelLoading();
+
+    /** Whether a load started with loadDocumentAsync() is still running,
+     *  including the connection that follows the loader. */
+    bool isLoading() const;
+
     /** Get a list of tables in the document.
      *  Creates a new model of the list of tables in the Glom document. The
      *  model must be destroyed by the caller when it is no longer needed.
@@ -90,13 +121,67 @@ public:
     /** Returns the error of the last operation that has failed. */
     QlomError lastError() const;
 
+    /** Get the latency and throughput statistics of the queries of the
+     *  models created by this document. They are kept across documents.
+     *  @returns the statistics */
+    QlomQueryStatistics * queryStatistics();
+
+    /** Get the memory budget of the rows of the models created by this
+     *  document. It is kept across documents, and shared with the models, so
+     *  that it outlives them.
+     *  @returns the budget */
+    QlomMemoryBudget * memoryBudget();
+
+Q_SIGNALS:
+    /** Emitted when a stage of loadDocumentAsync() starts.
+     *  @param[in] stage a Qlom::DocumentLoadingStage */
+    void loadingStageChanged(int stage);
+
+    /** Emitted when the tables of the document are known, before the
+     *  database connection has been opened. */
+    void metadataLoaded();
+
+    /** Emitted when loadDocumentAsync() succeeded. */
+    void documentLoaded();
+
+    /** Emitted when loadDocumentAsync() failed. The error can be obtained
+     *  with lastError(). */
+    void loadingFailed();
+
+    /** Emitted when loadDocumentAsync() was cancelled. */
+    void loadingCancelled();
+
+private Q_SLOTS:
+    /** Initialises libglom on the main thread, for theLoader. This is queued
+     *  by loadDocumentAsync(), so that the event loop runs first. */
+    void onInitialiseLibglom();
+
+    /** Slot for the finished() signal of theLoader. */
+    void onLoaderFinished();
+
+    /** Slot to show the table list from the metadata cache, while theLoader
+     *  is still parsing the document. */
+    void onLoaderCachedMetadataLoaded();
+
+    /** Opens the database connection of a document loaded with
+     *  loadDocumentAsync(). This is queued after metadataLoaded(), so that
+     *  the table list can be shown first. */
+    void onOpenConnection();
+
 private:
-    /** Convert a filepath to a URI.
-     *  Converts an absolute filepath into a file URI. Any errors that occur
-     *  are signalled via the errorRaised signal.
-     *  @param[in] theFilepath the absolute filepath
-     *  @returns the URI of the file */
-    std::string filepathToUri(const QString &theFilepath);
+    /** Forget the current document, its tables and its loader. */
+    void clear();
+
+    /** Open the database connection for the hosting mode of the document.
+     *  Any errors that occur are stored in theLastError.
+     *  @returns true on success, false on failure */
+    bool openConnection();
+
+    /** Check that a QtSql driver is available. Any errors that occur are
+     *  stored in theLastError.
+     *  @param[in] driver the name of the driver, such as QPSQL
+     *  @returns true if the driver is available, false otherwise */
+    bool checkDriver(const QString &driver);
 
     /** Open an SQLite database connection.
      *  Creates and opens a default QSqlDatabase connection. If authentication
@@ -107,27 +192,42 @@ private:
      *  @returns true on success, false on failure */
     bool openSqlite();
 
-    /** Fill tableList with tables read from the document.
-     *  Fills the tableList member with a list of QlomTables read from the Glom
-     *  document. In turn, calls fillRelationships() to fill each table with a
-     *  list of relationships.
-     *  @see fillRelationships() */
+    /** Fill theTables with tables read from the document.
+     *  Fills a new registry with the QlomTables read from the Glom document.
+     *  Only the names and flags are read here. The titles, the relationships
+     *  and the list layouts are read by each QlomTable on first access. */
     void fillTableList();
 
-    /** Fill a list with relationships from the document.
-     *  Fills a QList with GlomRelationships, that can then be used in a
-     *  GlomTable.
-     *  @param[in] documentRelationships a list of relationships from the
-     document, for a single table
-     *  @returns a list of relationships */
-    QList<QlomRelationship> fillRelationships(
-        const Glom::Document::type_vec_relationships &documentRelationships);
+    /** Attach the document to the tables in theTables, for tables that were
+     *  read from the metadata cache before the document was parsed. */
+    void attachTableList();
+
+    /** Fill theTables with the tables read from the metadata cache.
+     *  @param[in] tables the tables of QlomDocumentLoader::cachedTables() */
+    void setCachedTables(const QList<QlomTable> &tables);
+
+    /** Write the tables read so far to the metadata cache. Relationships are
+     *  only written for the tables that had them read. */
+    void saveMetadataCache();
 
     Glom::Document *document; /**< libglom's representaton of a Glom document */
+    QString theFilepath; /**< the location of the current document */
+    QlomMetadataCache::Stamp theDocumentStamp; /**< the stamp of the current
+                                                    document, from theLoader */
+    QlomDocumentLoader *theLoader; /**< the loader of loadDocumentAsync(), or
+                                        0 if no load is running */
+    bool theConnectingFlag; /**< whether loadDocumentAsync() still has to
+                                 connect after theLoader finished */
     QlomError theLastError; /**< contains the error of the last failed operation */
-
-    typedef QList<QlomTable> typeTableList;
-    typeTableList tableList; /**< a list of tables in the document */
+    QlomQueryStatistics theQueryStatistics; /**< see queryStatistics() */
+    std::shared_ptr<QlomMemoryBudget> theMemoryBudget; /**< see
+                                                            memoryBudget() */
+    std::shared_ptr<QlomTableRegistry> theTables; /**< the tables in the
+                                                       document, shared with
+                                                       the tables models.
+                                                       Replaced, not modified,
+                                                       when a new document is
+                                                       loaded. */
 };
 
 #endif /* QLOM_DOCUMENT_H_ */
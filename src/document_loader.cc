@@ -0,0 +1,250 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "document_loader.h"
+#include "metadata_cache.h"
+#include "startup_profiler.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <QFileInfo>
+
+#include <libglom/document/document.h>
+#include <glibmm/convert.h>
+
+/** How long the loader waits for libglom at a time, in milliseconds, before
+ *  checking whether it was cancelled. */
+static const unsigned long libglomWaitMsecs = 50;
+
+QlomDocumentLoader::QlomDocumentLoader(const QString &filepath,
+    QObject *parent) :
+    QThread(parent),
+    theFilepath(filepath),
+    theDocument(0),
+    theCachedTablesFlag(false),
+    theCancelledFlag(0)
+{}
+
+QlomDocumentLoader::~QlomDocumentLoader()
+{
+    delete theDocument;
+}
+
+void QlomDocumentLoader::run()
+{
+    load();
+}
+
+bool QlomDocumentLoader::load()
+{
+    QLOM_TRACE_SCOPE("load document", "load");
+    Q_EMIT stageStarted(Qlom::FILE_CHECK_LOADING_STAGE);
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+
+    QFileInfo info(theFilepath);
+    if(!info.exists()) {
+        qWarning("The file does not exist with filepath %s",
+            qPrintable(theFilepath));
+
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("The file does not exist"),
+            Qlom::CRITICAL_ERROR_SEVERITY);
+        return false;
+    }
+
+    // filepathToUri provides an error if it fails.
+    const std::string uri(filepathToUri(theFilepath));
+    if(uri.empty()) {
+        return false;
+    }
+
+    if(isCancelled()) {
+        return false;
+    }
+
+    // The table list can be shown while libglom is still parsing.
+    profiler.begin("read metadata cache");
+    theCachedTablesFlag = QlomMetadataCache::load(theFilepath, theCachedTables,
+        theDocumentStamp);
+    profiler.end("read metadata cache");
+    if(theCachedTablesFlag) {
+        Q_EMIT cachedMetadataLoaded();
+    } else {
+        /* Hashed here, while libglom is initialised, so that writing the
+         * sidecar when the document is closed does not read the file. */
+        theDocumentStamp = QlomMetadataCache::stamp(theFilepath);
+    }
+
+    Q_EMIT stageStarted(Qlom::PARSE_LOADING_STAGE);
+    /* QlomDocument initialises libglom on the main thread while the metadata
+     * cache is read. The wait is short, so that cancelling is noticed. */
+    profiler.begin("wait for libglom_init");
+    while(!waitForLibglom(libglomWaitMsecs)) {
+        if(isCancelled()) {
+            break;
+        }
+    }
+    profiler.end("wait for libglom_init");
+
+    if(isCancelled()) {
+        return false;
+    }
+
+    QlomStartupPhase parsePhase("parse document");
+    if(!parseDocument(uri)) {
+        delete theDocument;
+        theDocument = 0;
+        return false;
+    }
+
+    // The parsed document is discarded by the destructor.
+    return !isCancelled();
+}
+
+void QlomDocumentLoader::cancel()
+{
+    theCancelledFlag.storeRelease(1);
+}
+
+bool QlomDocumentLoader::isCancelled() const
+{
+    return theCancelledFlag.loadAcquire() != 0;
+}
+
+Glom::Document * QlomDocumentLoader::takeDocument()
+{
+    if(isCancelled()) {
+        return 0;
+    }
+
+    Glom::Document *document = theDocument;
+    theDocument = 0;
+    return document;
+}
+
+QlomError QlomDocumentLoader::lastError() const
+{
+    return theLastError;
+}
+
+QString QlomDocumentLoader::filepath() const
+{
+    return theFilepath;
+}
+
+bool QlomDocumentLoader::hasCachedTables() const
+{
+    return theCachedTablesFlag;
+}
+
+QList<QlomTable> QlomDocumentLoader::cachedTables() const
+{
+    return theCachedTables;
+}
+
+QlomMetadataCache::Stamp QlomDocumentLoader::documentStamp() const
+{
+    return theDocumentStamp;
+}
+
+bool QlomDocumentLoader::parseDocument(const std::string &uri)
+{
+    QLOM_TRACE_SCOPE("parse document", "load");
+    // Load a Glom document with a given file URI.
+    theDocument = new Glom::Document();
+    theDocument->set_file_uri(uri);
+    int failure_code = 0;
+    const bool test = theDocument->load(failure_code);
+    if(!test) {
+        qWarning("Document loading failed with uri %s (failure_code=%d)",
+            uri.c_str(), failure_code);
+
+        QString message;
+        if(failure_code == Glom::Document::LOAD_FAILURE_CODE_FILE_VERSION_TOO_NEW) {
+           message = tr("The document's format is too new.");
+        }
+        else {
+           message = tr("libglom failed to load the Glom document");
+        }
+
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN, message,
+            Qlom::CRITICAL_ERROR_SEVERITY);
+        return false;
+    }
+
+    /* Check that the document is not an example document, which must be
+     * resaved — that would be an extra feature. */
+    if(theDocument->get_is_example_file()) {
+        qWarning("Document is an example file, cannot process");
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("Cannot open the document because it is an example file"),
+            Qlom::CRITICAL_ERROR_SEVERITY);
+        return false;
+    }
+
+    /* Check that the document is not self-hosting, because that would require
+     * starting/stopping PostgreSQL. This is checked here rather than when
+     * connecting, so that the table list of such a document is not shown. */
+    switch (theDocument->get_hosting_mode()) {
+    case Glom::Document::HOSTING_MODE_POSTGRES_CENTRAL:
+    case Glom::Document::HOSTING_MODE_SQLITE:
+        break;
+    case Glom::Document::HOSTING_MODE_POSTGRES_SELF:
+    // Fall through.
+    default:
+        qWarning("Database type not supported, cannot process");
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("Database type not supported, failed to open the Glom document"),
+            Qlom::CRITICAL_ERROR_SEVERITY);
+        return false;
+        break;
+    }
+
+    return true;
+}
+
+std::string QlomDocumentLoader::filepathToUri(const QString &theFilepath)
+{
+    const std::string filepath(theFilepath.toUtf8().constData());
+    std::string uri;
+
+#ifdef GLIBMM_EXCEPTIONS_ENABLED
+    try {
+        uri = Glib::filename_to_uri(filepath);
+    }
+    catch(const Glib::ConvertError& convertException) {
+        qWarning("Exception from Glib::filename_to_uri(): %s",
+            convertException.what().c_str());
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("Failed to convert the document file name to a URI"),
+            Qlom::CRITICAL_ERROR_SEVERITY);
+    }
+#else /* !GLIBMM_EXCEPTIONS_ENABLED */
+    std::auto_ptr<Glib::Error> convertError;
+    uri = Glib::filename_to_uri(filepath, convertError);
+    if(convertError.get()) {
+        qWarning("Error from Glib::filename_to_uri(): %s",
+            convertError->what());
+        theLastError = QlomError(Qlom::DOCUMENT_ERROR_DOMAIN,
+            tr("Failed to convert the document file name to a URI"),
+            Qlom::CRITICAL_ERROR_SEVERITY);
+    }
+#endif /* GLIBMM_EXCEPTIONS_ENABLED */
+
+    return uri;
+}
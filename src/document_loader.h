@@ -0,0 +1,152 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_DOCUMENT_LOADER_H_
+#define QLOM_DOCUMENT_LOADER_H_
+
+#include "error.h"
+#include "metadata_cache.h"
+#include "table.h"
+
+#include <string>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+#include <QThread>
+
+namespace Glom
+{
+class Document;
+};
+
+namespace Qlom
+{
+
+/** Stages of loading a Glom document, in the order in which they run. */
+enum DocumentLoadingStage {
+    FILE_CHECK_LOADING_STAGE, /**< checking that the file exists */
+    PARSE_LOADING_STAGE, /**< parsing the Glom document with libglom */
+    TABLE_LIST_LOADING_STAGE, /**< reading the list of tables */
+    CONNECTION_LOADING_STAGE, /**< opening the database connection */
+    LOADING_STAGE_COUNT /**< the number of stages, not a stage */
+};
+
+} // namespace Qlom
+
+/** Loads a Glom document, on a worker thread.
+ *  The file checks and the parsing neither need the GUI nor the database
+ *  connection, so they run on the loader's thread once start() is called.
+ *  libglom is initialised on the main thread, with
+ *  ensureLibglomInitialised(), and the loader waits for it before parsing. Each stage is announced with
+ *  stageStarted(). The database connection is opened by QlomDocument
+ *  afterwards, on the GUI thread, because a QSqlDatabase connection can only
+ *  be used by the thread that created it.
+ *  If the document has a valid QlomMetadataCache sidecar, its tables are
+ *  read before parsing, and announced with cachedMetadataLoaded().
+ *  The results may only be read once finished() has been emitted, or once
+ *  load() has returned when the loader is used synchronously. */
+class QlomDocumentLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    /** Create a loader for a Glom document.
+     *  @param[in] filepath the location of the Glom document as an absolute
+     *  filepath
+     *  @param[in] parent a parent object */
+    explicit QlomDocumentLoader(const QString &filepath, QObject *parent = 0);
+
+    /** Destroys the parsed document, unless takeDocument() was called. */
+    virtual ~QlomDocumentLoader();
+
+    /** Run all stages on the calling thread.
+     *  @returns true on success, false on failure or cancellation */
+    bool load();
+
+    /** Ask the loader to stop. libglom cannot be interrupted while it parses,
+     *  so the loader stops at the next stage boundary. This method can be
+     *  called from any thread. */
+    void cancel();
+
+    /** Whether cancel() has been called. */
+    bool isCancelled() const;
+
+    /** Take ownership of the parsed document.
+     *  @returns the document, or 0 if loading failed or was cancelled */
+    Glom::Document * takeDocument();
+
+    /** Returns the error that made loading fail. */
+    QlomError lastError() const;
+
+    /** Get the location of the document being loaded. */
+    QString filepath() const;
+
+    /** Whether the tables were read from the metadata cache. Only valid once
+     *  cachedMetadataLoaded() or finished() has been emitted. */
+    bool hasCachedTables() const;
+
+    /** Get the tables read from the metadata cache.
+     *  @returns the tables, or an empty list if hasCachedTables() is false */
+    QList<QlomTable> cachedTables() const;
+
+    /** Get the stamp of the document, for QlomMetadataCache::save(). Only
+     *  valid once finished() has been emitted.
+     *  @returns the stamp, which is invalid if the file could not be read */
+    QlomMetadataCache::Stamp documentStamp() const;
+
+Q_SIGNALS:
+    /** Emitted when a stage starts. If the loader runs on its own thread,
+     *  the signal is emitted from that thread.
+     *  @param[in] stage a Qlom::DocumentLoadingStage */
+    void stageStarted(int stage);
+
+    /** Emitted when the tables have been read from the metadata cache, while
+     *  the document is still being parsed. */
+    void cachedMetadataLoaded();
+
+protected:
+    /** Reimplemented from QThread to call load(). */
+    virtual void run();
+
+private:
+    /** Convert a filepath to a URI.
+     *  Converts an absolute filepath into a file URI. Any errors that occur
+     *  are stored in theLastError.
+     *  @param[in] theFilepath the absolute filepath
+     *  @returns the URI of the file, or an empty string on failure */
+    std::string filepathToUri(const QString &theFilepath);
+
+    /** Parse the document, and check that Qlom can show it.
+     *  @param[in] uri the URI of the Glom document
+     *  @returns true on success, false on failure */
+    bool parseDocument(const std::string &uri);
+
+    QString theFilepath; /**< the location of the Glom document */
+    Glom::Document *theDocument; /**< the parsed document, owned by the
+                                      loader until takeDocument() */
+    QlomError theLastError; /**< the error that made loading fail */
+    QList<QlomTable> theCachedTables; /**< tables from the metadata cache.
+                                           Not modified after
+                                           cachedMetadataLoaded(). */
+    bool theCachedTablesFlag; /**< see hasCachedTables() */
+    QlomMetadataCache::Stamp theDocumentStamp; /**< see documentStamp() */
+    QAtomicInt theCancelledFlag; /**< set by cancel(), from any thread */
+};
+
+#endif /* QLOM_DOCUMENT_LOADER_H_ */
@@ -0,0 +1,227 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QLOM_FILTER_X86
+#include <immintrin.h>
+#endif
+
+/** The rows of a word of the selection bitmap. */
+static const int rowsPerWord = QlomFilterKernels::rowsPerWord;
+
+/** Add the rows of a range of numbers to a selection, one at a time.
+ *  @param[in] numbers the number of each row
+ *  @param[in] firstRow the first row to compare
+ *  @param[in] rows the number of rows
+ *  @param[in] low the lowest matching number
+ *  @param[in] high the highest matching number
+ *  @param[in,out] bits the selection */
+static void selectRangeScalar(const double *numbers, int firstRow, int rows,
+    double low, double high, quint64 *bits)
+{
+    for (int row = firstRow; row < rows; ++row) {
+        // Comparisons with NaN are false, so nulls do not match.
+        const double number = numbers[row];
+        if (low <= number && number <= high) {
+            bits[row / rowsPerWord] |= quint64(1) << (row % rowsPerWord);
+        }
+    }
+}
+
+/** Add the rows of a set of codes to a selection, one at a time.
+ *  @param[in] codes the code of each row
+ *  @param[in] firstRow the first row to look up
+ *  @param[in] rows the number of rows
+ *  @param[in] accepted -1 for each code that matches, 0 for the others
+ *  @param[in,out] bits the selection */
+static void selectCodesScalar(const qint32 *codes, int firstRow, int rows,
+    const qint32 *accepted, quint64 *bits)
+{
+    for (int row = firstRow; row < rows; ++row) {
+        if (accepted[codes[row]]) {
+            bits[row / rowsPerWord] |= quint64(1) << (row % rowsPerWord);
+        }
+    }
+}
+
+#ifdef QLOM_FILTER_X86
+/** Whether the processor, and the operating system, support AVX. */
+static bool hasAvx()
+{
+    static const bool avx = __builtin_cpu_supports("avx");
+    return avx;
+}
+
+/** Whether the processor has AVX2, which implies AVX. */
+static bool hasAvx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#ifdef __SSE2__
+/** See selectRangeScalar(), for two numbers at a time. */
+static void selectRangeSse2(const double *numbers, int rows, double low,
+    double high, quint64 *bits)
+{
+    const __m128d lows = _mm_set1_pd(low);
+    const __m128d highs = _mm_set1_pd(high);
+    const int words = rows / rowsPerWord;
+    for (int word = 0; word < words; ++word) {
+        const double *first = numbers + word * rowsPerWord;
+        quint64 matches = 0;
+        for (int row = 0; row < rowsPerWord; row += 2) {
+            const __m128d values = _mm_loadu_pd(first + row);
+            const __m128d inRange = _mm_and_pd(_mm_cmpge_pd(values, lows),
+                _mm_cmple_pd(values, highs));
+            matches |= quint64(_mm_movemask_pd(inRange)) << row;
+        }
+        bits[word] |= matches;
+    }
+
+    selectRangeScalar(numbers, words * rowsPerWord, rows, low, high, bits);
+}
+#endif /* __SSE2__ */
+
+/** See selectRangeScalar(), for four numbers at a time. */
+__attribute__((target("avx")))
+static void selectRangeAvx(const double *numbers, int rows, double low,
+    double high, quint64 *bits)
+{
+    const __m256d lows = _mm256_set1_pd(low);
+    const __m256d highs = _mm256_set1_pd(high);
+    const int words = rows / rowsPerWord;
+    for (int word = 0; word < words; ++word) {
+        const double *first = numbers + word * rowsPerWord;
+        quint64 matches = 0;
+        for (int row = 0; row < rowsPerWord; row += 4) {
+            const __m256d values = _mm256_loadu_pd(first + row);
+            // The ordered predicates are false for NaN.
+            const __m256d inRange = _mm256_and_pd(
+                _mm256_cmp_pd(values, lows, _CMP_GE_OQ),
+                _mm256_cmp_pd(values, highs, _CMP_LE_OQ));
+            matches |= quint64(_mm256_movemask_pd(inRange)) << row;
+        }
+        bits[word] |= matches;
+    }
+
+    selectRangeScalar(numbers, words * rowsPerWord, rows, low, high, bits);
+}
+
+/** See selectCodesScalar(), for eight codes at a time. */
+__attribute__((target("avx2")))
+static void selectCodesAvx2(const qint32 *codes, int rows,
+    const qint32 *accepted, quint64 *bits)
+{
+    const int words = rows / rowsPerWord;
+    for (int word = 0; word < words; ++word) {
+        const qint32 *first = codes + word * rowsPerWord;
+        quint64 matches = 0;
+        for (int row = 0; row < rowsPerWord; row += 8) {
+            const __m256i indexes = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(first + row));
+            const __m256i flags = _mm256_i32gather_epi32(
+                reinterpret_cast<const int *>(accepted), indexes, 4);
+            matches |= quint64(quint32(_mm256_movemask_ps(
+                _mm256_castsi256_ps(flags)))) << row;
+        }
+        bits[word] |= matches;
+    }
+
+    selectCodesScalar(codes, words * rowsPerWord, rows, accepted, bits);
+}
+#endif /* QLOM_FILTER_X86 */
+
+bool QlomFilterKernels::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case SCALAR_KERNEL:
+        return true;
+        break;
+#ifdef QLOM_FILTER_X86
+#ifdef __SSE2__
+    case SSE2_KERNEL:
+        return true;
+        break;
+#endif
+    case AVX_KERNEL:
+        return hasAvx();
+        break;
+    case AVX2_KERNEL:
+        return hasAvx2();
+        break;
+#endif
+    default:
+        return false;
+        break;
+    }
+}
+
+QlomFilterKernels::Kernel QlomFilterKernels::fastest()
+{
+    if (isSupported(AVX2_KERNEL)) {
+        return AVX2_KERNEL;
+    } else if (isSupported(AVX_KERNEL)) {
+        return AVX_KERNEL;
+    } else if (isSupported(SSE2_KERNEL)) {
+        return SSE2_KERNEL;
+    }
+
+    return SCALAR_KERNEL;
+}
+
+void QlomFilterKernels::selectRange(Kernel kernel, const double *numbers,
+    int rows, double low, double high, quint64 *bits)
+{
+    Q_ASSERT(isSupported(kernel));
+    switch (kernel) {
+#ifdef QLOM_FILTER_X86
+    case AVX_KERNEL:
+    case AVX2_KERNEL:
+        // AVX2 has nothing to add to the comparisons of doubles.
+        selectRangeAvx(numbers, rows, low, high, bits);
+        break;
+#ifdef __SSE2__
+    case SSE2_KERNEL:
+        selectRangeSse2(numbers, rows, low, high, bits);
+        break;
+#endif
+#endif
+    default:
+        selectRangeScalar(numbers, 0, rows, low, high, bits);
+        break;
+    }
+}
+
+void QlomFilterKernels::selectCodes(Kernel kernel, const qint32 *codes,
+    int rows, const qint32 *accepted, quint64 *bits)
+{
+    Q_ASSERT(isSupported(kernel));
+    switch (kernel) {
+#ifdef QLOM_FILTER_X86
+    case AVX2_KERNEL:
+        selectCodesAvx2(codes, rows, accepted, bits);
+        break;
+#endif
+    default:
+        selectCodesScalar(codes, 0, rows, accepted, bits);
+        break;
+    }
+}
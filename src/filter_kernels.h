@@ -0,0 +1,76 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_FILTER_KERNELS_H_
+#define QLOM_FILTER_KERNELS_H_
+
+#include <QtGlobal>
+
+/** The loops of QlomRowFilter, which add the matching rows of a column to a
+ *  selection bitmap with a bit per row, 64 rows per word, with the first row
+ *  in the lowest bit of the first word. Each loop has a scalar kernel, and
+ *  SIMD kernels for x86 processors: ranges of numbers are compared by SSE2
+ *  or AVX, and sets of codes are looked up by an AVX2 gather. The SIMD
+ *  kernels handle whole words, and the scalar kernel the remaining rows.
+ *  The kernels are public so that qlom-bench-filter can check each of them
+ *  against the scalar one. */
+class QlomFilterKernels
+{
+public:
+    /** The kernels, from the slowest to the fastest. */
+    enum Kernel {
+        SCALAR_KERNEL,
+        SSE2_KERNEL,
+        AVX_KERNEL,
+        AVX2_KERNEL
+    };
+
+    /** The rows of a word of the selection bitmap. */
+    static const int rowsPerWord = 64;
+
+    /** Whether the processor, and the build, support a kernel.
+     *  @param[in] kernel the kernel
+     *  @returns true if the kernel can run, false otherwise */
+    static bool isSupported(Kernel kernel);
+
+    /** Get the fastest kernel that the processor supports. */
+    static Kernel fastest();
+
+    /** Add the rows of a range of numbers to a selection. NaN never matches.
+     *  @param[in] kernel the kernel, which must be supported
+     *  @param[in] numbers the number of each row
+     *  @param[in] rows the number of rows
+     *  @param[in] low the lowest matching number
+     *  @param[in] high the highest matching number
+     *  @param[in,out] bits the selection, with a word per 64 rows */
+    static void selectRange(Kernel kernel, const double *numbers, int rows,
+        double low, double high, quint64 *bits);
+
+    /** Add the rows of a set of codes to a selection. Only the AVX2 kernel
+     *  has SIMD code; the SSE2 and AVX kernels are the scalar one.
+     *  @param[in] kernel the kernel, which must be supported
+     *  @param[in] codes the code of each row
+     *  @param[in] rows the number of rows
+     *  @param[in] accepted -1 for each code that matches, 0 for the others,
+     *  with an entry for each code of the rows
+     *  @param[in,out] bits the selection, with a word per 64 rows */
+    static void selectCodes(Kernel kernel, const qint32 *codes, int rows,
+        const qint32 *accepted, quint64 *bits);
+};
+
+#endif /* QLOM_FILTER_KERNELS_H_ */
@@ -0,0 +1,231 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diagnostics_panel.h"
+#include "memory_budget.h"
+#include "query_statistics.h"
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QStringList>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+/** The delay between an update of the statistics and a refresh, in
+ *  milliseconds. Further updates during the delay are shown together. */
+static const int refreshDelay = 500;
+
+/** The columns of the queries table. */
+enum QueriesTableColumn {
+    QUERY_COLUMN,
+    EXECUTIONS_COLUMN,
+    FETCHES_COLUMN,
+    P50_COLUMN,
+    P95_COLUMN,
+    P99_COLUMN,
+    MAX_COLUMN,
+    ROWS_COLUMN,
+    BYTES_COLUMN,
+    ROWS_PER_SECOND_COLUMN,
+    BYTES_PER_SECOND_COLUMN,
+    COLUMN_COUNT
+};
+
+/** The columns of the memory table. */
+enum MemoryTableColumn {
+    MODEL_COLUMN,
+    MODEL_ROWS_COLUMN,
+    RESIDENT_PAGES_COLUMN,
+    PAGES_COLUMN,
+    EVICTED_PAGES_COLUMN,
+    MODEL_BYTES_COLUMN,
+    MEMORY_COLUMN_COUNT
+};
+
+/** Create a right-aligned, read-only table item for a number.
+ *  @param[in] text the formatted number
+ *  @returns the item */
+static QTableWidgetItem * numberItem(const QString &text)
+{
+    QTableWidgetItem *item = new QTableWidgetItem(text);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+    return item;
+}
+
+/** Create a read-only table for the diagnostics.
+ *  @param[in] labels the column headers
+ *  @param[in] parent the parent widget
+ *  @returns the table */
+static QTableWidget * diagnosticsTable(const QStringList &labels,
+    QWidget *parent)
+{
+    QTableWidget *table = new QTableWidget(0, labels.size(), parent);
+    table->setHorizontalHeaderLabels(labels);
+    table->verticalHeader()->hide();
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setAlternatingRowColors(true);
+    table->horizontalHeader()->setSectionResizeMode(
+        QHeaderView::ResizeToContents);
+    return table;
+}
+
+QlomDiagnosticsPanel::QlomDiagnosticsPanel(QlomQueryStatistics *statistics,
+    QlomMemoryBudget *budget, QWidget *parent) :
+    QDockWidget(tr("Diagnostics"), parent),
+    theStatistics(statistics),
+    theMemoryBudget(budget),
+    theQueriesTable(0),
+    theMemoryLabel(0),
+    theMemoryTable(0),
+    theRefreshTimer(0)
+{
+    Q_ASSERT(theStatistics);
+    Q_ASSERT(theMemoryBudget);
+    setObjectName("DiagnosticsPanel"); // For QMainWindow::saveState().
+
+    QTabWidget *tabs = new QTabWidget(this);
+
+    theQueriesTable = diagnosticsTable(QStringList()
+        << tr("Query") << tr("Runs") << tr("Fetches") << tr("p50 ms")
+        << tr("p95 ms") << tr("p99 ms") << tr("Max ms") << tr("Rows")
+        << tr("Bytes") << tr("Rows/s") << tr("Bytes/s"), tabs);
+    tabs->addTab(theQueriesTable, tr("Queries"));
+
+    QWidget *memory = new QWidget(tabs);
+    QVBoxLayout *memoryLayout = new QVBoxLayout(memory);
+    theMemoryLabel = new QLabel(memory);
+    memoryLayout->addWidget(theMemoryLabel);
+    theMemoryTable = diagnosticsTable(QStringList()
+        << tr("Model") << tr("Rows") << tr("Pages in memory") << tr("Pages")
+        << tr("Evicted") << tr("Bytes"), memory);
+    memoryLayout->addWidget(theMemoryTable);
+    tabs->addTab(memory, tr("Memory"));
+
+    setWidget(tabs);
+
+    theRefreshTimer = new QTimer(this);
+    theRefreshTimer->setSingleShot(true);
+    theRefreshTimer->setInterval(refreshDelay);
+    connect(theRefreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+
+    connect(theStatistics, SIGNAL(updated()),
+        this, SLOT(onStatisticsUpdated()));
+}
+
+QlomDiagnosticsPanel::~QlomDiagnosticsPanel()
+{}
+
+void QlomDiagnosticsPanel::showEvent(QShowEvent *event)
+{
+    QDockWidget::showEvent(event);
+    refresh();
+}
+
+void QlomDiagnosticsPanel::onStatisticsUpdated()
+{
+    // Hidden panels are refreshed by showEvent().
+    if (isVisible() && !theRefreshTimer->isActive()) {
+        theRefreshTimer->start();
+    }
+}
+
+void QlomDiagnosticsPanel::refresh()
+{
+    const QList<QlomQueryStatistics::Summary> summaries =
+        theStatistics->summaries();
+    const QLocale locale;
+
+    theQueriesTable->setRowCount(summaries.size());
+    int row = 0;
+    for (QList<QlomQueryStatistics::Summary>::const_iterator iter =
+             summaries.begin();
+         iter != summaries.end();
+         ++iter, ++row) {
+        const QlomQueryStatistics::Summary &summary = *iter;
+
+        QTableWidgetItem *queryItem = new QTableWidgetItem(summary.query);
+        queryItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+        theQueriesTable->setItem(row, QUERY_COLUMN, queryItem);
+        theQueriesTable->setItem(row, EXECUTIONS_COLUMN,
+            numberItem(locale.toString(summary.executions)));
+        theQueriesTable->setItem(row, FETCHES_COLUMN,
+            numberItem(locale.toString(summary.fetches)));
+        theQueriesTable->setItem(row, P50_COLUMN,
+            numberItem(locale.toString(summary.p50Msecs, 'f', 1)));
+        theQueriesTable->setItem(row, P95_COLUMN,
+            numberItem(locale.toString(summary.p95Msecs, 'f', 1)));
+        theQueriesTable->setItem(row, P99_COLUMN,
+            numberItem(locale.toString(summary.p99Msecs, 'f', 1)));
+        theQueriesTable->setItem(row, MAX_COLUMN,
+            numberItem(locale.toString(summary.maxMsecs, 'f', 1)));
+        theQueriesTable->setItem(row, ROWS_COLUMN,
+            numberItem(locale.toString(summary.rows)));
+        theQueriesTable->setItem(row, BYTES_COLUMN,
+            numberItem(locale.toString(summary.bytes)));
+        theQueriesTable->setItem(row, ROWS_PER_SECOND_COLUMN,
+            numberItem(locale.toString(summary.rowsPerSecond(), 'f', 0)));
+        theQueriesTable->setItem(row, BYTES_PER_SECOND_COLUMN,
+            numberItem(locale.toString(summary.bytesPerSecond(), 'f', 0)));
+    }
+
+    refreshMemory();
+}
+
+void QlomDiagnosticsPanel::refreshMemory()
+{
+    const QList<QlomMemoryBudget::Usage> usages = theMemoryBudget->usages();
+    const QLocale locale;
+
+    const qint64 mebibyte = 1024 * 1024;
+    const QString used = locale.toString(
+        theMemoryBudget->usage() / double(mebibyte), 'f', 1);
+    if (theMemoryBudget->limit() > 0) {
+        theMemoryLabel->setText(tr("%1 MiB of %2 MiB used by %3 models").arg(
+            used, locale.toString(theMemoryBudget->limit() / mebibyte),
+            locale.toString(usages.size())));
+    } else {
+        theMemoryLabel->setText(tr("%1 MiB used by %2 models, no limit").arg(
+            used, locale.toString(usages.size())));
+    }
+
+    theMemoryTable->setRowCount(usages.size());
+    int row = 0;
+    for (QList<QlomMemoryBudget::Usage>::const_iterator iter = usages.begin();
+         iter != usages.end();
+         ++iter, ++row) {
+        const QlomMemoryBudget::Usage &usage = *iter;
+
+        QTableWidgetItem *modelItem = new QTableWidgetItem(usage.name);
+        modelItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+        theMemoryTable->setItem(row, MODEL_COLUMN, modelItem);
+        theMemoryTable->setItem(row, MODEL_ROWS_COLUMN,
+            numberItem(locale.toString(usage.rows)));
+        theMemoryTable->setItem(row, RESIDENT_PAGES_COLUMN,
+            numberItem(locale.toString(usage.residentPages)));
+        theMemoryTable->setItem(row, PAGES_COLUMN,
+            numberItem(locale.toString(usage.pages)));
+        theMemoryTable->setItem(row, EVICTED_PAGES_COLUMN,
+            numberItem(locale.toString(usage.evictedPages)));
+        theMemoryTable->setItem(row, MODEL_BYTES_COLUMN,
+            numberItem(locale.toString(usage.bytes)));
+    }
+}
@@ -0,0 +1,74 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_DIAGNOSTICS_PANEL_H_
+#define QLOM_DIAGNOSTICS_PANEL_H_
+
+#include <QDockWidget>
+
+class QlomMemoryBudget;
+class QlomQueryStatistics;
+class QLabel;
+class QTableWidget;
+class QTimer;
+
+/** A dockable panel with diagnostics of the current document.
+ *  The panel shows the latency percentiles and the throughput of each query,
+ *  from a QlomQueryStatistics, and the memory used by the rows of each model,
+ *  from a QlomMemoryBudget. The budget is refreshed together with the
+ *  statistics, since the caches only grow when they query. It is refreshed
+ *  at most a few times per second, and only while it is visible, so that
+ *  scrolling through a large table does not rebuild it after every fetch. */
+class QlomDiagnosticsPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    /** Create a diagnostics panel.
+     *  @param[in] statistics the query statistics to show
+     *  @param[in] budget the memory budget to show
+     *  @param[in] parent a parent widget, usually the main window */
+    QlomDiagnosticsPanel(QlomQueryStatistics *statistics,
+        QlomMemoryBudget *budget, QWidget *parent = 0);
+    virtual ~QlomDiagnosticsPanel();
+
+protected:
+    /** Reimplemented to refresh the panel when it is shown.
+     *  @param[in] event the show event */
+    virtual void showEvent(QShowEvent *event);
+
+private Q_SLOTS:
+    /** Slot to schedule a refresh once the statistics have changed. */
+    void onStatisticsUpdated();
+
+    /** Slot to show the current statistics. */
+    void refresh();
+
+private:
+    /** Show the current usage of the memory budget. */
+    void refreshMemory();
+
+    QlomQueryStatistics *theStatistics; /**< the statistics to show */
+    QlomMemoryBudget *theMemoryBudget; /**< the budget to show */
+    QTableWidget *theQueriesTable; /**< a row per query */
+    QLabel *theMemoryLabel; /**< the total usage and the limit */
+    QTableWidget *theMemoryTable; /**< a row per row cache */
+    QTimer *theRefreshTimer; /**< delays refreshes after updates */
+};
+
+#endif /* QLOM_DIAGNOSTICS_PANEL_H_ */
@@ -19,22 +19,266 @@
 #include "list_view.h"
 #include "layout_delegates.h"
 #include "list_layout_model.h"
+#include "paint_statistics.h"
+#include "quick_search.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <QHeaderView>
+#include <QInputDialog>
+#include <QItemSelection>
+#include <QMenu>
+#include <QMessageBox>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QTimer>
+
+/** The interval at which the overlay is refreshed, in milliseconds. */
+static const int overlayRefreshInterval = 500;
+
+/** The margin around the text of the overlay, in pixels. */
+static const int overlayMargin = 6;
 
 QlomListView::QlomListView(QWidget *parent) :
     QTableView(parent),
+    theOverlayTimer(0),
+    theQuickSearch(new QlomQuickSearch(this)),
+    theQuickSearchScrolledFlag(false),
     theLastColumnIndex(-1),
     theToggledFlag(false)
 {
     connect(horizontalHeader(), SIGNAL(sectionPressed(int)),
         this, SLOT(onHeaderSectionPressed(int)));
+    horizontalHeader()->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(horizontalHeader(),
+        SIGNAL(customContextMenuRequested(QPoint)),
+        this, SLOT(onHeaderContextMenuRequested(QPoint)));
+    connect(theQuickSearch, SIGNAL(searchStarted()),
+        this, SLOT(onQuickSearchStarted()));
+    connect(theQuickSearch, SIGNAL(matchesFound(QVector<int>)),
+        this, SLOT(onQuickSearchMatchesFound(QVector<int>)));
+    connect(theQuickSearch, SIGNAL(searchFinished(int, bool)),
+        this, SIGNAL(quickSearchFinished(int, bool)));
+    connect(theQuickSearch, SIGNAL(indexProgressChanged(int)),
+        this, SIGNAL(quickSearchIndexProgressChanged(int)));
+    connect(theQuickSearch, SIGNAL(indexBuilt(qint64)),
+        this, SIGNAL(quickSearchIndexBuilt(qint64)));
 }
 
 QlomListView::~QlomListView()
 {}
 
+void QlomListView::paintEvent(QPaintEvent *event)
+{
+    QLOM_TRACE_SCOPE("QlomListView::paintEvent", "paint");
+    if (!theOverlayTimer) {
+        QTableView::paintEvent(event);
+        return;
+    }
+
+    // Refreshes of the overlay alone are not counted as frames.
+    QlomPaintStatistics &statistics = QlomPaintStatistics::instance();
+    const bool overlayOnly = (event->rect() == theOverlayRect);
+    if (!overlayOnly) {
+        statistics.beginFrame();
+    }
+
+    QTableView::paintEvent(event);
+
+    if (!overlayOnly) {
+        statistics.endFrame();
+    }
+
+    paintOverlay(overlayOnly);
+}
+
+bool QlomListView::isOverlayVisible() const
+{
+    return (0 != theOverlayTimer);
+}
+
+void QlomListView::setOverlayVisible(bool visible)
+{
+    if (visible == isOverlayVisible()) {
+        return;
+    }
+
+    QlomPaintStatistics::instance().setEnabled(visible);
+    if (visible) {
+        theOverlayTimer = new QTimer(this);
+        theOverlayTimer->setInterval(overlayRefreshInterval);
+        connect(theOverlayTimer, SIGNAL(timeout()),
+            this, SLOT(onOverlayTimeout()));
+        theOverlayTimer->start();
+    } else {
+        delete theOverlayTimer;
+        theOverlayTimer = 0;
+        theOverlayRect = QRect();
+    }
+
+    viewport()->update();
+}
+
+void QlomListView::onOverlayTimeout()
+{
+    viewport()->update(theOverlayRect);
+}
+
+void QlomListView::paintOverlay(bool overlayOnly)
+{
+    const QStringList lines = QlomPaintStatistics::instance().describe();
+
+    QPainter painter(viewport());
+    const QFontMetrics metrics(painter.fontMetrics());
+    int width = 0;
+    for (QStringList::const_iterator iter = lines.begin();
+         iter != lines.end();
+         ++iter) {
+        width = qMax(width, metrics.width(*iter));
+    }
+
+    const QRect overlayRect(
+        viewport()->width() - width - 3 * overlayMargin, overlayMargin,
+        width + 2 * overlayMargin,
+        lines.size() * metrics.lineSpacing() + 2 * overlayMargin);
+
+    /* If the overlay grew, a refresh of the overlay alone was clipped to the
+     * previous size, so the next refresh covers both. */
+    theOverlayRect =
+        (overlayOnly ? overlayRect.united(theOverlayRect) : overlayRect);
+
+    painter.fillRect(overlayRect, QColor(0, 0, 0, 180));
+    painter.setPen(Qt::white);
+    int y = overlayRect.top() + overlayMargin + metrics.ascent();
+    for (QStringList::const_iterator iter = lines.begin();
+         iter != lines.end();
+         ++iter) {
+        painter.drawText(overlayRect.left() + overlayMargin, y, *iter);
+        y += metrics.lineSpacing();
+    }
+}
+
+void QlomListView::setModel(QAbstractItemModel *model)
+{
+    theFilterTexts.clear();
+    QTableView::setModel(model);
+    theQuickSearch->setModel(qobject_cast<QlomListLayoutModel *>(model));
+}
+
+void QlomListView::setQuickSearchText(const QString &text)
+{
+    theQuickSearch->search(text);
+}
+
+void QlomListView::buildQuickSearchIndex()
+{
+    theQuickSearch->buildIndex();
+}
+
+void QlomListView::onQuickSearchStarted()
+{
+    theQuickSearchScrolledFlag = false;
+    clearSelection();
+}
+
+void QlomListView::onQuickSearchMatchesFound(const QVector<int> &rows)
+{
+    QAbstractItemModel *searched = model();
+    if (!searched || rows.isEmpty()) {
+        return;
+    }
+
+    // Neighbouring rows are selected as one range.
+    const int lastColumn = searched->columnCount() - 1;
+    QItemSelection selection;
+    int first = rows.first();
+    int last = first;
+    for (QVector<int>::const_iterator iter = rows.begin() + 1;
+         iter != rows.end();
+         ++iter) {
+        if (*iter != last + 1) {
+            selection.select(searched->index(first, 0),
+                searched->index(last, lastColumn));
+            first = *iter;
+        }
+        last = *iter;
+    }
+    selection.select(searched->index(first, 0),
+        searched->index(last, lastColumn));
+    selectionModel()->select(selection, QItemSelectionModel::Select);
+
+    if (!theQuickSearchScrolledFlag) {
+        scrollTo(searched->index(rows.first(), 0));
+        theQuickSearchScrolledFlag = true;
+    }
+}
+
+void QlomListView::onHeaderContextMenuRequested(const QPoint &position)
+{
+    QlomListLayoutModel *model =
+        qobject_cast<QlomListLayoutModel *>(this->model());
+    const int column = horizontalHeader()->logicalIndexAt(position);
+    if (!model || -1 == column
+        || Glom::Field::TYPE_INVALID == model->columnType(column)) {
+        return;
+    }
+
+    QMenu menu(this);
+    QAction *filterAction = menu.addAction(tr("&Filter..."));
+    QAction *removeAction = menu.addAction(tr("&Remove Filter"));
+    removeAction->setEnabled(model->hasRowFilter(column));
+
+    const QAction *chosen =
+        menu.exec(horizontalHeader()->viewport()->mapToGlobal(position));
+    if (chosen == filterAction) {
+        editRowFilter(column);
+    } else if (chosen == removeAction) {
+        model->removeRowFilter(column);
+        theFilterTexts.remove(column);
+    }
+}
+
+void QlomListView::editRowFilter(int column)
+{
+    QlomListLayoutModel *model =
+        qobject_cast<QlomListLayoutModel *>(this->model());
+    if (!model) {
+        return;
+    }
+
+    // A sort in the query drops the filters of the model.
+    if (!model->hasRowFilter(column)) {
+        theFilterTexts.remove(column);
+    }
+
+    const QString header =
+        model->headerData(column, Qt::Horizontal).toString();
+    bool accepted = false;
+    const QString text = QInputDialog::getText(this, tr("Filter"),
+        tr("Show the rows whose %1 matches, such as > 1000, 10 .. 20 or "
+           "a, b, c:").arg(header),
+        QLineEdit::Normal, theFilterTexts.value(column), &accepted);
+    if (!accepted) {
+        return;
+    }
+
+    QlomRowFilter filter;
+    if (!QlomRowFilter::parse(text, model->columnType(column), filter)) {
+        QMessageBox::warning(this, tr("Filter"),
+            tr("\"%1\" is not a filter of %2.").arg(text).arg(header));
+        return;
+    }
+
+    if (!model->setRowFilter(column, filter)) {
+        QMessageBox::information(this, tr("Filter"),
+            tr("Filters need all rows of the table in memory. Scroll to the "
+               "end of the table first, or raise the memory budget."));
+        return;
+    }
+
+    theFilterTexts.insert(column, text);
+}
+
 void QlomListView::setupDelegateForColumn(int column)
 {
     QlomListLayoutModel *model =
@@ -73,7 +317,7 @@ QStyledItemDelegate * QlomListView::createDelegateFromColumn(
             std::shared_ptr<const Glom::LayoutItem_Field> fieldItem =
                 std::dynamic_pointer_cast<const Glom::LayoutItem_Field>(*iter);
             if(fieldItem)
-                return new QlomLayoutItemFieldDelegate(
+                return QlomLayoutItemFieldDelegate::create(
                     fieldItem->get_formatting_used(),
                     fieldItem->get_full_field_details());
         }
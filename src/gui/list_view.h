@@ -21,11 +21,20 @@
 
 #include "document.h"
 
+#include <QHash>
+#include <QRect>
+#include <QString>
 #include <QStyledItemDelegate>
 #include <QTableView>
+#include <QVector>
+
+class QlomQuickSearch;
+class QTimer;
 
 /** This class extends the QTableView by a delegate factory specialised to the
- *  QlomListLayoutModel. */
+ *  QlomListLayoutModel. It also selects the rows found by a QlomQuickSearch,
+ *  as they are found, and offers the quick filters of the model in the
+ *  context menu of the header. */
 class QlomListView : public QTableView
 {
     Q_OBJECT
@@ -49,11 +58,88 @@ public:
     static QStyledItemDelegate * createDelegateFromColumn(
         QlomListLayoutModel *model, int column);
 
+    /** Whether the paint statistics overlay is shown. */
+    bool isOverlayVisible() const;
+
+    /** Overridden to search the model with the quick search.
+     *  @param[in] model the model, which is searched if it is a
+     *  QlomListLayoutModel */
+    virtual void setModel(QAbstractItemModel *model);
+
+Q_SIGNALS:
+    /** Emitted when the quick search has found all its matches.
+     *  @param[in] matchCount the number of rows that match
+     *  @param[in] allColumns whether all text columns were searched, see
+     *  QlomQuickSearch::searchFinished() */
+    void quickSearchFinished(int matchCount, bool allColumns);
+
+    /** Emitted while the index of the quick search is built.
+     *  @param[in] percent the share of the texts indexed so far */
+    void quickSearchIndexProgressChanged(int percent);
+
+    /** Emitted when the index of the quick search has been built.
+     *  @param[in] bytes the memory used by the index */
+    void quickSearchIndexBuilt(qint64 bytes);
+
+protected:
+    /** Overridden to trace the painting of the cells, and to measure it for
+     *  the overlay.
+     *  @param[in] event the paint event */
+    virtual void paintEvent(QPaintEvent *event);
+
 public Q_SLOTS:
     /** Slot to sort columns. */
     void onHeaderSectionPressed(int columnIndex);
 
+    /** Show or hide an overlay with the frame time, the cells painted per
+     *  frame, the time spent in each delegate class and the hit rates of the
+     *  display text caches. While it is shown, QlomPaintStatistics records.
+     *  @param[in] visible whether to show the overlay */
+    void setOverlayVisible(bool visible);
+
+    /** Select the rows whose texts contain a text, see QlomQuickSearch.
+     *  @param[in] text the text, or an empty string to stop searching */
+    void setQuickSearchText(const QString &text);
+
+    /** Build a trigram index of the texts of the model in the background,
+     *  to speed up the quick search, see QlomQuickSearch::buildIndex(). */
+    void buildQuickSearchIndex();
+
+private Q_SLOTS:
+    /** Slot to clear the selection of the previous quick search. */
+    void onQuickSearchStarted();
+
+    /** Slot to select the matches of the quick search, scrolling to the
+     *  first one.
+     *  @param[in] rows the model rows, in ascending order */
+    void onQuickSearchMatchesFound(const QVector<int> &rows);
+
+    /** Slot to repaint the overlay with the latest statistics. */
+    void onOverlayTimeout();
+
+    /** Slot to show the filter actions of a column of the header.
+     *  @param[in] position the position of the click in the header */
+    void onHeaderContextMenuRequested(const QPoint &position);
+
 private:
+    /** Ask for a filter of a column, and show only the matching rows, see
+     *  QlomListLayoutModel::setRowFilter().
+     *  @param[in] column the model column */
+    void editRowFilter(int column);
+
+    /** Paint the overlay in the top right corner of the viewport, and
+     *  remember where it was painted in theOverlayRect.
+     *  @param[in] overlayOnly whether only the overlay is being repainted */
+    void paintOverlay(bool overlayOnly);
+
+    QTimer *theOverlayTimer; /**< refreshes the overlay while it is shown,
+                                  or 0 */
+    QRect theOverlayRect; /**< where the overlay was last painted */
+    QlomQuickSearch *theQuickSearch; /**< searches the model */
+    bool theQuickSearchScrolledFlag; /**< whether the view was scrolled to
+                                          the first match of the search */
+    QHash<int, QString> theFilterTexts; /**< the filter typed for each
+                                             column, see editRowFilter() */
     int theLastColumnIndex; /**< the last column that was used for sorting, default is -1 (i.e., none). */
     bool theToggledFlag;
 };
@@ -17,10 +17,13 @@
  */
 
 #include "main_window.h"
+#include "diagnostics_panel.h"
 #include "document.h"
 #include "error.h"
 #include "list_view.h"
+#include "startup_profiler.h"
 #include "tables_model.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <memory>
@@ -39,7 +42,12 @@ QlomMainWindow::QlomMainWindow() :
     theTablesTreeView(0),
     theListLayoutView(0),
     theTablesComboBox(0),
-    theValidFlag(true)
+    theQuickSearchEdit(0),
+    theLoadingProgressBar(0),
+    theIndexProgressBar(0),
+    theDiagnosticsPanel(0),
+    theValidFlag(true),
+    theQuitOnLoadingFailureFlag(false)
 {
   setup();
 }
@@ -50,24 +58,23 @@ QlomMainWindow::QlomMainWindow(const QString &filepath) :
     theTablesTreeView(0),
     theListLayoutView(0),
     theTablesComboBox(0),
-    theValidFlag(true)
+    theQuickSearchEdit(0),
+    theLoadingProgressBar(0),
+    theIndexProgressBar(0),
+    theDiagnosticsPanel(0),
+    theValidFlag(true),
+    theQuitOnLoadingFailureFlag(false)
 {
+    /* Errors are reported asynchronously now, so a document given on the
+     * command line makes the application quit if it cannot be loaded. */
+    theQuitOnLoadingFailureFlag = true;
+
+    /* The document is parsed on a worker thread while the widgets are
+     * created. Its signals are queued until the event loop runs, by which
+     * time setup() has connected them. */
+    theGlomDocument.loadDocumentAsync(filepath);
     setup();
-
-    if(!theGlomDocument.loadDocument(filepath)) {
-        theValidFlag = false;
-        return;
-    }
-
-    QlomTablesModel *model = theGlomDocument.createTablesModel();
-    theTablesTreeView->setModel(model);
-
-    connect(theTablesTreeView, SIGNAL(doubleClicked(QModelIndex)),
-        this, SLOT(onTablesTreeviewDoubleclicked(QModelIndex)));
     show();
-
-    // Open default table.
-    showDefaultTable();
 }
 
 bool QlomMainWindow::isValid() const
@@ -75,6 +82,16 @@ bool QlomMainWindow::isValid() const
     return theValidFlag;
 }
 
+bool QlomMainWindow::saveQueryStatistics(const QString &filepath)
+{
+    return theGlomDocument.queryStatistics()->saveJson(filepath);
+}
+
+void QlomMainWindow::setMemoryBudget(qint64 bytes)
+{
+    theGlomDocument.memoryBudget()->setLimit(bytes);
+}
+
 void QlomMainWindow::showError(const QlomError &error)
 {
     if(!error.what().isNull()) {
@@ -101,6 +118,7 @@ void QlomMainWindow::showError(const QlomError &error)
 
 void QlomMainWindow::setup()
 {
+    QlomStartupPhase phase("main window setup");
     readSettings();
     setWindowTitle(qApp->applicationName());
 
@@ -122,7 +140,45 @@ void QlomMainWindow::setup()
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(fileOpen);
     fileMenu->addAction(fileClose);
+    if (QlomTrace::isEnabled()) {
+        // Only offered with --trace, because nothing is recorded otherwise.
+        QAction *fileSaveTrace = new QAction(tr("Save &Trace..."), this);
+        fileSaveTrace->setStatusTip(
+            tr("Save the recent trace events, for chrome://tracing"));
+        fileMenu->addAction(fileSaveTrace);
+        connect(fileSaveTrace, SIGNAL(triggered(bool)),
+            this, SLOT(onFileSaveTraceTriggered()));
+    }
     fileMenu->addAction(fileQuit);
+
+    theDiagnosticsPanel =
+        new QlomDiagnosticsPanel(theGlomDocument.queryStatistics(),
+            theGlomDocument.memoryBudget(), this);
+    addDockWidget(Qt::BottomDockWidgetArea, theDiagnosticsPanel);
+    theDiagnosticsPanel->hide();
+    QAction *viewDiagnostics = theDiagnosticsPanel->toggleViewAction();
+    viewDiagnostics->setShortcut(tr("Ctrl+D", "Show diagnostics"));
+    viewDiagnostics->setStatusTip(
+        tr("Show the latency and throughput of the database queries"));
+    QAction *viewPaintOverlay =
+        new QAction(tr("&Paint Statistics Overlay"), this);
+    viewPaintOverlay->setCheckable(true);
+    viewPaintOverlay->setShortcut(
+        tr("Ctrl+Shift+P", "Show paint statistics overlay"));
+    viewPaintOverlay->setStatusTip(
+        tr("Show the frame time and the painting cost of the table"));
+    QAction *viewFind = new QAction(tr("&Find"), this);
+    viewFind->setShortcut(tr("Ctrl+F", "Find rows"));
+    viewFind->setStatusTip(tr("Find the rows that contain a text"));
+    QAction *viewBuildIndex = new QAction(tr("Build &Search Index"), this);
+    viewBuildIndex->setStatusTip(
+        tr("Index the texts of the table, to speed up the quick search"));
+    QMenu *viewMenu = menuBar()->addMenu(tr("&View"));
+    viewMenu->addAction(viewFind);
+    viewMenu->addAction(viewBuildIndex);
+    viewMenu->addAction(viewDiagnostics);
+    viewMenu->addAction(viewPaintOverlay);
+
     QMenu *aboutMenu = menuBar()->addMenu(tr("&Help"));
     aboutMenu->addAction(helpAbout);
 
@@ -134,6 +190,8 @@ void QlomMainWindow::setup()
         this, SLOT(onFileQuitTriggered()));
     connect(helpAbout, SIGNAL(triggered(bool)),
         this, SLOT(onHelpAboutTriggered()));
+    connect(viewFind, SIGNAL(triggered(bool)),
+        this, SLOT(onViewFindTriggered()));
 
     theMainWidget = new QStackedWidget(this);
 
@@ -142,6 +200,8 @@ void QlomMainWindow::setup()
     theTablesTreeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
     theTablesTreeView->setAlternatingRowColors(true);
     theMainWidget->addWidget(theTablesTreeView);
+    connect(theTablesTreeView, SIGNAL(doubleClicked(QModelIndex)),
+        this, SLOT(onTablesTreeviewDoubleclicked(QModelIndex)));
 
     // Create page containing the table and the navigation widget.
     QWidget *tableContainer = new QWidget;
@@ -161,9 +221,24 @@ void QlomMainWindow::setup()
     connect(listLayoutBackButton, SIGNAL(clicked(bool)),
         this, SLOT(onBackButton()));
 
+    theQuickSearchEdit = new QLineEdit(tableContainer);
+    theQuickSearchEdit->setPlaceholderText(tr("Quick search"));
+    theQuickSearchEdit->setClearButtonEnabled(true);
+    connect(theQuickSearchEdit, SIGNAL(textChanged(QString)),
+        theListLayoutView, SLOT(setQuickSearchText(QString)));
+    connect(theListLayoutView, SIGNAL(quickSearchFinished(int, bool)),
+        this, SLOT(onQuickSearchFinished(int, bool)));
+    connect(viewBuildIndex, SIGNAL(triggered(bool)),
+        theListLayoutView, SLOT(buildQuickSearchIndex()));
+    connect(theListLayoutView, SIGNAL(quickSearchIndexProgressChanged(int)),
+        this, SLOT(onQuickSearchIndexProgressChanged(int)));
+    connect(theListLayoutView, SIGNAL(quickSearchIndexBuilt(qint64)),
+        this, SLOT(onQuickSearchIndexBuilt(qint64)));
+
     QWidget *navigationContainer = new QWidget;
     QHBoxLayout *navigationLayout = new QHBoxLayout(navigationContainer);
     navigationLayout->addWidget(theTablesComboBox, 1);
+    navigationLayout->addWidget(theQuickSearchEdit, 1);
     navigationLayout->addWidget(listLayoutBackButton, 0, Qt::AlignRight);
 
     QVBoxLayout *tableLayout = new QVBoxLayout(tableContainer);
@@ -172,7 +247,75 @@ void QlomMainWindow::setup()
 
     theMainWidget->addWidget(tableContainer);
 
+    connect(viewPaintOverlay, SIGNAL(toggled(bool)),
+        theListLayoutView, SLOT(setOverlayVisible(bool)));
+
     setCentralWidget(theMainWidget);
+
+    // Show the progress of loading a document in the status bar.
+    theLoadingProgressBar = new QProgressBar;
+    theLoadingProgressBar->setRange(0, Qlom::LOADING_STAGE_COUNT);
+    theLoadingProgressBar->hide();
+    statusBar()->addPermanentWidget(theLoadingProgressBar);
+
+    theIndexProgressBar = new QProgressBar;
+    theIndexProgressBar->setRange(0, 100);
+    theIndexProgressBar->setFormat(tr("Indexing %p%"));
+    theIndexProgressBar->hide();
+    statusBar()->addPermanentWidget(theIndexProgressBar);
+
+    connect(&theGlomDocument, SIGNAL(loadingStageChanged(int)),
+        this, SLOT(onDocumentLoadingStageChanged(int)));
+    connect(&theGlomDocument, SIGNAL(metadataLoaded()),
+        this, SLOT(onDocumentMetadataLoaded()));
+    connect(&theGlomDocument, SIGNAL(documentLoaded()),
+        this, SLOT(onDocumentLoaded()));
+    connect(&theGlomDocument, SIGNAL(loadingFailed()),
+        this, SLOT(onDocumentLoadingFailed()));
+    connect(&theGlomDocument, SIGNAL(loadingCancelled()),
+        this, SLOT(onDocumentLoadingCancelled()));
+
+    if (QlomStartupProfiler::instance().isEnabled()) {
+        installEventFilter(this);
+        theListLayoutView->viewport()->installEventFilter(this);
+    }
+}
+
+bool QlomMainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Paint) {
+        /* The filter sees the event before the paint, so the paint is only
+         * done once a queued call is delivered. */
+        if (watched == this) {
+            removeEventFilter(this);
+            QMetaObject::invokeMethod(this, "onFirstWindowPainted",
+                Qt::QueuedConnection);
+        } else if (watched == theListLayoutView->viewport()) {
+            watched->removeEventFilter(this);
+            QMetaObject::invokeMethod(this, "onFirstTablePainted",
+                Qt::QueuedConnection);
+        }
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void QlomMainWindow::onFirstWindowPainted()
+{
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.mark("window painted");
+
+    // Without a document, the startup ends here.
+    if (!theGlomDocument.isLoading()) {
+        profiler.finish();
+    }
+}
+
+void QlomMainWindow::onFirstTablePainted()
+{
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.mark("table painted");
+    profiler.finish();
 }
 
 QlomMainWindow::~QlomMainWindow()
@@ -206,6 +349,29 @@ void QlomMainWindow::readSettings()
     restoreState(settings.value("MainWindow/InternalProperties").toByteArray());
 }
 
+QString QlomMainWindow::loadingStageLookup(
+    const Qlom::DocumentLoadingStage stage) const
+{
+    switch (stage) {
+    case Qlom::FILE_CHECK_LOADING_STAGE:
+        return tr("Opening the document");
+        break;
+    case Qlom::PARSE_LOADING_STAGE:
+        return tr("Reading the document");
+        break;
+    case Qlom::TABLE_LIST_LOADING_STAGE:
+        return tr("Reading the list of tables");
+        break;
+    case Qlom::CONNECTION_LOADING_STAGE:
+        return tr("Connecting to the database");
+        break;
+    default:
+        qWarning("Unhandled loading stage: %i", stage);
+        return QString();
+        break;
+    }
+}
+
 QString QlomMainWindow::errorDomainLookup(
     const Qlom::QlomErrorDomain errorDomain) const
 {
@@ -240,26 +406,11 @@ void QlomMainWindow::onFileOpenTriggered()
     dialog->setFileMode(QFileDialog::ExistingFile);
     dialog->setNameFilter("Glom document (*.glom)");
 
-    if (dialog->exec()) {
-        bool wasDocumentLoaded = false;
-
-        if (dialog) {
-            QStringList files = dialog->selectedFiles();
-            wasDocumentLoaded = theGlomDocument.loadDocument(files.first());
-        }
-
-        if (!wasDocumentLoaded) {
-            delete dialog;
-            return;
-        }
-
-        // Document was loaded:
-        QlomTablesModel *model = theGlomDocument.createTablesModel();
-        theTablesTreeView->setModel(model);
-        theTablesComboBox->setModel(model);
-
-        // Open default table.
-        showDefaultTable();
+    if (dialog->exec() && dialog) {
+        // The table list is shown by onDocumentMetadataLoaded().
+        QStringList files = dialog->selectedFiles();
+        theQuitOnLoadingFailureFlag = false;
+        theGlomDocument.loadDocumentAsync(files.first());
     }
 
     delete dialog;
@@ -267,6 +418,8 @@ void QlomMainWindow::onFileOpenTriggered()
 
 void QlomMainWindow::onFileCloseTriggered()
 {
+    theGlomDocument.cancelLoading();
+
     theTablesTreeView->deleteLater();
     theTablesTreeView = new QTreeView(this);
     theTablesTreeView->setAlternatingRowColors(true);
@@ -277,6 +430,64 @@ void QlomMainWindow::onFileCloseTriggered()
         this, SLOT(onTablesTreeviewDoubleclicked(QModelIndex)));
 }
 
+void QlomMainWindow::onDocumentLoadingStageChanged(int stage)
+{
+    statusBar()->showMessage(
+        loadingStageLookup(static_cast<Qlom::DocumentLoadingStage>(stage)));
+    theLoadingProgressBar->setValue(stage);
+    theLoadingProgressBar->show();
+}
+
+void QlomMainWindow::onDocumentMetadataLoaded()
+{
+    QlomTablesModel *model = theGlomDocument.createTablesModel();
+    theTablesTreeView->setModel(model);
+    theTablesComboBox->setModel(model);
+}
+
+void QlomMainWindow::onDocumentLoaded()
+{
+    theLoadingProgressBar->hide();
+    statusBar()->clearMessage();
+
+    // Open default table.
+    showDefaultTable();
+}
+
+void QlomMainWindow::onDocumentLoadingFailed()
+{
+    theLoadingProgressBar->hide();
+    statusBar()->clearMessage();
+
+    QlomStartupProfiler::instance().finish();
+    showError(theGlomDocument.lastError());
+    if (theQuitOnLoadingFailureFlag) {
+        qApp->exit(EXIT_FAILURE);
+    }
+}
+
+void QlomMainWindow::onDocumentLoadingCancelled()
+{
+    theLoadingProgressBar->hide();
+    statusBar()->showMessage(tr("Loading cancelled"), 2000);
+}
+
+void QlomMainWindow::onFileSaveTraceTriggered()
+{
+    const QString filepath = QFileDialog::getSaveFileName(this,
+        tr("Save Trace"), QString(), tr("Chrome trace (*.json)"));
+    if (filepath.isEmpty()) {
+        return;
+    }
+
+    if (QlomTrace::save(filepath)) {
+        statusBar()->showMessage(tr("Trace saved"), 2000);
+    } else {
+        QMessageBox::warning(this, tr("Save Trace"),
+            tr("Failed to save the trace to %1").arg(filepath));
+    }
+}
+
 void QlomMainWindow::onFileQuitTriggered()
 {
     qApp->quit();
@@ -292,6 +503,47 @@ void QlomMainWindow::onBackButton()
     theMainWidget->setCurrentIndex(0);
 }
 
+void QlomMainWindow::onViewFindTriggered()
+{
+    // The quick search belongs to the page of the list layout.
+    if (1 != theMainWidget->currentIndex()) {
+        return;
+    }
+
+    theQuickSearchEdit->setFocus();
+    theQuickSearchEdit->selectAll();
+}
+
+void QlomMainWindow::onQuickSearchFinished(int matchCount, bool allColumns)
+{
+    if (theQuickSearchEdit->text().isEmpty()) {
+        statusBar()->clearMessage();
+        return;
+    }
+
+    if (!allColumns) {
+        statusBar()->showMessage(tr("%n rows found, in the columns whose "
+            "rows are all in memory", 0, matchCount));
+        return;
+    }
+
+    statusBar()->showMessage(tr("%n rows found", 0, matchCount));
+}
+
+void QlomMainWindow::onQuickSearchIndexProgressChanged(int percent)
+{
+    theIndexProgressBar->setValue(percent);
+    theIndexProgressBar->setVisible(percent < 100);
+}
+
+void QlomMainWindow::onQuickSearchIndexBuilt(qint64 bytes)
+{
+    theIndexProgressBar->hide();
+    const qint64 mebibyte = 1024 * 1024;
+    statusBar()->showMessage(tr("Search index built, using %1 MiB").arg(
+        QLocale().toString(bytes / double(mebibyte), 'f', 1)), 2000);
+}
+
 void QlomMainWindow::onTablesTreeviewDoubleclicked(const QModelIndex& index)
 {
     const QString &tableName = index.data(Qlom::TableNameRole).toString();
@@ -310,8 +562,11 @@ void QlomMainWindow::onTablesTreeviewDoubleclicked(const QModelIndex& index)
 void QlomMainWindow::showDefaultTable()
 {
     // Show the default table, or the first non-hidden table, if there is one.
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    profiler.begin("create default table model");
     QlomListLayoutModel *model =
       theGlomDocument.createDefaultTableListLayoutModel();
+    profiler.end("create default table model");
 
     if (model) {
         showTable(model);
@@ -327,11 +582,18 @@ void QlomMainWindow::showDefaultTable()
 void QlomMainWindow::showTable(QlomListLayoutModel *model)
 {
     Q_ASSERT(0 != model);
+    QlomStartupPhase phase("showTable");
 
     const QString tableDisplayName(model->tableDisplayName());
-    theTablesComboBox->setCurrentIndex(
-        theTablesComboBox->findText(tableDisplayName));
+    const QlomTablesModel *tablesModel =
+        qobject_cast<QlomTablesModel *>(theTablesComboBox->model());
+    if (tablesModel) {
+        theTablesComboBox->setCurrentIndex(
+            tablesModel->rowOfTable(model->table().tableName()));
+    }
 
+    // Switching the model cancels building the index of the previous one.
+    theIndexProgressBar->hide();
     theListLayoutView->hide();
     model->setParent(theListLayoutView);
     theListLayoutView->setModel(model);
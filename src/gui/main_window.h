@@ -26,9 +26,12 @@
 #include <QMainWindow>
 #include <QTableView>
 
+class QlomDiagnosticsPanel;
 class QlomListLayoutModel;
 class QComboBox;
+class QLineEdit;
 class QModelIndex;
+class QProgressBar;
 class QPushButton;
 class QStackedWidget;
 class QlomListView;
@@ -64,6 +67,23 @@ public:
      */
     bool isValid() const;
 
+    /** Write a snapshot of the query statistics, as JSON.
+     *  @param[in] filepath the file to write
+     *  @returns true on success, false on failure */
+    bool saveQueryStatistics(const QString &filepath);
+
+    /** Change the memory budget of the rows of the list models.
+     *  @param[in] bytes the budget in bytes, or 0 for no limit */
+    void setMemoryBudget(qint64 bytes);
+
+protected:
+    /** Reimplemented to notice the first paint of the window and of the
+     *  table, for the startup profiler.
+     *  @param[in] watched the object that receives the event
+     *  @param[in] event the event
+     *  @returns false, so that the event is always delivered */
+    virtual bool eventFilter(QObject *watched, QEvent *event);
+
 private:
     /** A generic error message for the error domain is shown in a dialog, and
      *  the detailed error message is shown in the initially-hidden details
@@ -90,6 +110,11 @@ private:
      *  @param[in] model the model to show */
     void showTable(QlomListLayoutModel *model);
 
+    /** Lookup the text that corresponds to a document loading stage.
+     *  @param[in] stage the loading stage to provide a string for
+     *  @returns a human-readable description of the loading stage */
+    QString loadingStageLookup(const Qlom::DocumentLoadingStage stage) const;
+
     /** Lookup the text that corresponds to an error domain.
      *  @param[in] errorDomain the error domain to provide a string for
      *  @returns a human-readable description of the error domain */
@@ -109,9 +134,25 @@ private:
     /** A combo box for the table names model. */
     QComboBox *theTablesComboBox;
 
+    /** The text of the quick search of the list layout. */
+    QLineEdit *theQuickSearchEdit;
+
+    /** Shows the progress of loading a document. */
+    QProgressBar *theLoadingProgressBar;
+
+    /** Shows the progress of building the quick search index. */
+    QProgressBar *theIndexProgressBar;
+
+    /** Shows the query statistics, hidden by default. */
+    QlomDiagnosticsPanel *theDiagnosticsPanel;
+
     /** See isValid(). */
     bool theValidFlag;
 
+    /** Whether a failure to load the document quits the application, which
+     *  is the case for a document given on the command line. */
+    bool theQuitOnLoadingFailureFlag;
+
 private Q_SLOTS:
     /** Slot for the signal from the Open menu item. */
     void onFileOpenTriggered();
@@ -119,6 +160,25 @@ private Q_SLOTS:
     /** Slot for the signal from the Close menu item. */
     void onFileCloseTriggered();
 
+    /** Slot to show the progress of loading a document.
+     *  @param[in] stage the Qlom::DocumentLoadingStage that started */
+    void onDocumentLoadingStageChanged(int stage);
+
+    /** Slot to show the table list as soon as it is known. */
+    void onDocumentMetadataLoaded();
+
+    /** Slot to show the default table once the document is loaded. */
+    void onDocumentLoaded();
+
+    /** Slot to report a failure to load a document. */
+    void onDocumentLoadingFailed();
+
+    /** Slot to report that loading a document was cancelled. */
+    void onDocumentLoadingCancelled();
+
+    /** Slot for the signal from the Save Trace menu item. */
+    void onFileSaveTraceTriggered();
+
     /** Slot for the signal from the Quit menu item. */
     void onFileQuitTriggered();
 
@@ -128,6 +188,22 @@ private Q_SLOTS:
     /** Slot to show the list of tables. */
     void onBackButton();
 
+    /** Slot for the signal from the Find menu item. */
+    void onViewFindTriggered();
+
+    /** Slot to show the number of rows found by the quick search.
+     *  @param[in] matchCount the number of rows
+     *  @param[in] allColumns whether all text columns were searched */
+    void onQuickSearchFinished(int matchCount, bool allColumns);
+
+    /** Slot to show the progress of building the quick search index.
+     *  @param[in] percent the share of the texts indexed so far */
+    void onQuickSearchIndexProgressChanged(int percent);
+
+    /** Slot to report that the quick search index has been built.
+     *  @param[in] bytes the memory used by the index */
+    void onQuickSearchIndexBuilt(qint64 bytes);
+
     /** Slot for the signal from a double-click on the table names treeview.
      *  @param[in] index the row that was double-clicked */
     void onTablesTreeviewDoubleclicked(const QModelIndex &index);
@@ -139,6 +215,14 @@ private Q_SLOTS:
     /** Slot to show a table given a numeric index.
      *  @param[in] index the index of the table to show */
     void onTablesComboActivated(const int index);
+
+    /** Slot called once the window has been painted for the first time, if
+     *  the startup profiler is enabled. */
+    void onFirstWindowPainted();
+
+    /** Slot called once a table has been painted for the first time, if the
+     *  startup profiler is enabled. */
+    void onFirstTablePainted();
 };
 
 #endif /* QLOM_MAIN_WINDOW_H_ */
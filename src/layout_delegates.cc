@@ -17,13 +17,26 @@
  */
 
 #include "layout_delegates.h"
+#include "list_layout_model.h"
+#include "paint_statistics.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <QRegExp>
 #include <QStringList>
 #include <QAbstractItemView>
+#include <QApplication>
+#include <QStyle>
+#include <QStyleOptionButton>
 #include <QPushButton>
 #include <QSignalMapper>
+#include <QtNumeric>
+#include <QDate>
+#include <QTime>
+
+/** The display texts cached per delegate, which covers a few screens of
+ *  distinct values. */
+static const int cachedDisplayTexts = 8192;
 
 QlomFieldFormattingDelegate::QlomFieldFormattingDelegate(
     const Glom::Formatting &formatting, const GlomSharedField details,
@@ -39,6 +52,8 @@ QlomFieldFormattingDelegate::~QlomFieldFormattingDelegate()
 void QlomFieldFormattingDelegate::paint(QPainter *painter,
     const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
+    QLOM_TRACE_SCOPE("QlomFieldFormattingDelegate::paint", "paint");
+    QlomPaintTimer paintTimer(metaObject()->className());
     QStyleOptionViewItemV4 opt = option;
     initStyleOption(&opt, index);
 
@@ -54,14 +69,6 @@ void QlomFieldFormattingDelegate::paint(QPainter *painter,
         fgColor.setNamedColor(fgColorName);
     }
 
-    QColor bgColor = Qt::transparent;
-    QString bgColorName =
-        ustringToQstring(theFormattingUsed.get_text_format_color_background());
-
-    if (!bgColorName.isEmpty()) {
-        bgColor.setNamedColor(bgColorName);
-    }
-
     /* Tried to set fore- and background via setColor/setBrush and all roles
      * listed http://qt.nokia.com/doc/4.6/qpalette.html#ColorRole-enum,
      * highlight and text seem to be honored but not backround/base/window. I
@@ -71,16 +78,29 @@ void QlomFieldFormattingDelegate::paint(QPainter *painter,
     opt.palette.setColor(QPalette::Text, fgColor);
 
     // Still draw the background manually.
-    painter->save();
-    painter->setPen(Qt::NoPen);
-    painter->setBrush(bgColor);
-    painter->drawRect(opt.rect);
-    painter->restore();
+    paintBackground(painter, opt.rect);
 
     // Forward the modified QStyleOptionViewItem to the parent.
     QStyledItemDelegate::paint(painter, opt, index);
 }
 
+void QlomFieldFormattingDelegate::paintBackground(QPainter *painter,
+    const QRect &rect) const
+{
+    const QString bgColorName =
+        ustringToQstring(theFormattingUsed.get_text_format_color_background());
+
+    if (bgColorName.isEmpty()) {
+        return;
+    }
+
+    painter->save();
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(bgColorName));
+    painter->drawRect(rect);
+    painter->restore();
+}
+
 QSize QlomFieldFormattingDelegate::sizeHint(const QStyleOptionViewItem &option,
     const QModelIndex &index) const
 {
@@ -90,78 +110,213 @@ QSize QlomFieldFormattingDelegate::sizeHint(const QStyleOptionViewItem &option,
 QlomLayoutItemFieldDelegate::QlomLayoutItemFieldDelegate(
     const Glom::Formatting &formatting, const GlomSharedField details,
     QObject *parent) :
-    QlomFieldFormattingDelegate(formatting, details, parent)
+    QlomFieldFormattingDelegate(formatting, details, parent),
+    theFormattedTextFlag(false),
+    theDisplayTexts(cachedDisplayTexts),
+    theFormatter((details ? details->get_glom_type()
+        : Glom::Field::TYPE_INVALID), formatting.m_numeric_format)
 {}
 
 QlomLayoutItemFieldDelegate::~QlomLayoutItemFieldDelegate()
 {}
 
+QlomLayoutItemFieldDelegate * QlomLayoutItemFieldDelegate::create(
+    const Glom::Formatting &formatting, const GlomSharedField details,
+    QObject *parent)
+{
+    switch(details ? details->get_glom_type() : Glom::Field::TYPE_INVALID) {
+    case Glom::Field::TYPE_NUMERIC:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_NUMERIC>(
+            formatting, details, parent);
+        break;
+    case Glom::Field::TYPE_TEXT:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_TEXT>(
+            formatting, details, parent);
+        break;
+    case Glom::Field::TYPE_DATE:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_DATE>(
+            formatting, details, parent);
+        break;
+    case Glom::Field::TYPE_TIME:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_TIME>(
+            formatting, details, parent);
+        break;
+    case Glom::Field::TYPE_BOOLEAN:
+        return new QlomBooleanFieldDelegate(formatting, details, parent);
+        break;
+    case Glom::Field::TYPE_IMAGE:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_IMAGE>(
+            formatting, details, parent);
+        break;
+    default:
+        return new QlomTypedFieldDelegate<Glom::Field::TYPE_INVALID>(
+            formatting, details, parent);
+        break;
+    }
+}
+
 QString QlomLayoutItemFieldDelegate::displayText(const QVariant &value,
     const QLocale &locale) const
 {
-    switch(theFieldDetails->get_glom_type()) {
-    case Glom::Field::TYPE_NUMERIC: {
-        /* Check whether the display text was a double in its previous
-         * life. If true, remove trailing zeroes and add thousand
-         * separators (if requested). The Glom numeric type is treated as
-         * doubles by the Sqlite backend. */
-        bool conversionSucceeded = false;
-        double numeric = value.toString().toDouble(&conversionSucceeded);
-
-        if (conversionSucceeded) {
-            return applyNumericFormatting(numeric, locale);
-        }
-    } break;
-
-    case Glom::Field::TYPE_TEXT:
-        return value.toString();
+    QLOM_TRACE_SCOPE("QlomLayoutItemFieldDelegate::displayText", "paint");
+    if (theFormattedTextFlag) {
+        return theFormattedText;
+    }
 
-    // TODO: handle other display roles correctly.
-    case Glom::Field::TYPE_INVALID:
+    switch(theFieldDetails ? theFieldDetails->get_glom_type()
+        : Glom::Field::TYPE_INVALID) {
+    case Glom::Field::TYPE_NUMERIC:
+        return typedDisplayText<Glom::Field::TYPE_NUMERIC>(value, locale);
+        break;
     case Glom::Field::TYPE_DATE:
+        return typedDisplayText<Glom::Field::TYPE_DATE>(value, locale);
+        break;
     case Glom::Field::TYPE_TIME:
+        return typedDisplayText<Glom::Field::TYPE_TIME>(value, locale);
+        break;
     case Glom::Field::TYPE_BOOLEAN:
+        return typedDisplayText<Glom::Field::TYPE_BOOLEAN>(value, locale);
+        break;
     case Glom::Field::TYPE_IMAGE:
-        return value.toString();
-
+        return typedDisplayText<Glom::Field::TYPE_IMAGE>(value, locale);
+        break;
     default:
+        return typedDisplayText<Glom::Field::TYPE_TEXT>(value, locale);
         break;
     }
+}
 
-    return QString("(not implemented)");
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_NUMERIC>(
+    const QVariant &value, const QLocale &locale) const
+{
+    /* The Glom numeric type is treated as doubles by the Sqlite backend.
+     * Values that are not numbers are shown as they are. */
+    bool conversionSucceeded = false;
+    const double numeric = value.toDouble(&conversionSucceeded);
+    return (conversionSucceeded ? cachedText(numeric, value, locale)
+        : value.toString());
 }
 
-QString QlomLayoutItemFieldDelegate::applyNumericFormatting(double numeric,
-    const QLocale &locale) const
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_DATE>(
+    const QVariant &value, const QLocale &locale) const
 {
-    Glom::NumericFormat numFormat = theFormattingUsed.m_numeric_format;
+    // The model stores dates natively, so toDate() does not parse.
+    const QDate date = value.toDate();
+    return (date.isValid()
+        ? cachedText(date.toJulianDay(), QVariant(date), locale)
+        : value.toString());
+}
+
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_TIME>(
+    const QVariant &value, const QLocale &locale) const
+{
+    const QTime time = value.toTime();
+    return (time.isValid()
+        ? cachedText(time.msecsSinceStartOfDay(), QVariant(time), locale)
+        : value.toString());
+}
+
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_BOOLEAN>(
+    const QVariant &value, const QLocale &) const
+{
+    return (value.toBool() ? tr("Yes") : tr("No"));
+}
+
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_IMAGE>(
+    const QVariant &value, const QLocale &locale) const
+{
+    // The image data is not text, so only its size is shown.
+    const qint64 bytes = value.toByteArray().size();
+    return tr("Image (%1 KiB)").arg(
+        locale.toString((bytes + 1023) / 1024));
+}
 
-    QString currencyPrefix = QString();
-    if (!numFormat.m_currency_symbol.empty()) {
-        // Add a whitespace for the currency prefix.
-        currencyPrefix =
-            QString("%1 ").arg(ustringToQstring(numFormat.m_currency_symbol));
+QString QlomLayoutItemFieldDelegate::cachedText(double key,
+    const QVariant &value, const QLocale &locale) const
+{
+    // NaN never equals itself, so it would never be found.
+    if (qIsNaN(key)) {
+        return theFormatter.format(value, locale);
+    }
+
+    if (locale != theCacheLocale) {
+        theDisplayTexts.clear();
+        theCacheLocale = locale;
+    }
+
+    const QString *cached = theDisplayTexts.object(key);
+    QlomPaintStatistics::instance().recordCacheLookup("display text",
+        0 != cached);
+    if (cached) {
+        return *cached;
     }
 
-    QLocale myLocale = QLocale(locale);
+    const QString text = theFormatter.format(value, locale);
+    theDisplayTexts.insert(key, new QString(text));
+    return text;
+}
 
-    if(!numFormat.m_use_thousands_separator) {
-        myLocale.setNumberOptions(QLocale::OmitGroupSeparator);
-    } else {
-        myLocale.setNumberOptions(0); // Do not rely on defaults here.
+void QlomLayoutItemFieldDelegate::initStyleOption(
+    QStyleOptionViewItem *option, const QModelIndex &index) const
+{
+    /* The base class calls displayText() for the value of the display role,
+     * which returns the text of the model while theFormattedTextFlag is set.
+     * The text is formatted for the default locale. */
+    const QVariant text = index.data(Qlom::DisplayTextRole);
+    theFormattedTextFlag = (text.isValid() && option->locale == QLocale());
+    if (theFormattedTextFlag) {
+        theFormattedText = text.toString();
     }
 
-    // TODO: check max precision in Glom source.
-    int precision = (numFormat.m_decimal_places_restricted
-        ? numFormat.m_decimal_places : numFormat.get_default_precision());
-    /* 'g' trims trailing zeroes, although not documented in [1], whereas 'f'
-       prints the decimal places instead of using mantisse + exponent.
-       [1] http://doc.trolltech.com/4.6/qstring.html#argument-formats */
-    char format = (numFormat.m_decimal_places_restricted ? 'f' : 'g');
+    QlomFieldFormattingDelegate::initStyleOption(option, index);
+    theFormattedTextFlag = false;
+}
+
+QlomBooleanFieldDelegate::QlomBooleanFieldDelegate(
+    const Glom::Formatting &formatting, const GlomSharedField details,
+    QObject *parent) :
+    QlomTypedFieldDelegate<Glom::Field::TYPE_BOOLEAN>(formatting, details,
+        parent)
+{}
+
+void QlomBooleanFieldDelegate::paint(QPainter *painter,
+    const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    QLOM_TRACE_SCOPE("QlomBooleanFieldDelegate::paint", "paint");
+    // The class shares the QMetaObject of its base, so name it explicitly.
+    QlomPaintTimer paintTimer("QlomBooleanFieldDelegate");
+
+    const QWidget *widget = option.widget;
+    QStyle *style = (widget ? widget->style() : QApplication::style());
+
+    // The selection and the hover highlight, without a text.
+    paintBackground(painter, option.rect);
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter,
+        widget);
+
+    const QVariant value = index.data(Qt::DisplayRole);
+    if (value.isNull()) {
+        return;
+    }
 
-    // This already removes trailing zeroes and also adds thousand separators.
-    return QString("%1%2").arg(currencyPrefix)
-        .arg(myLocale.toString(numeric, format, precision));
+    QStyleOptionButton check;
+    check.palette = option.palette;
+    check.direction = option.direction;
+    check.fontMetrics = option.fontMetrics;
+    check.state = option.state & QStyle::State_Enabled;
+    check.state |= (value.toBool() ? QStyle::State_On : QStyle::State_Off);
+    const QSize size(
+        style->pixelMetric(QStyle::PM_IndicatorWidth, &check, widget),
+        style->pixelMetric(QStyle::PM_IndicatorHeight, &check, widget));
+    check.rect = QStyle::alignedRect(option.direction, Qt::AlignCenter, size,
+        option.rect);
+    style->drawPrimitive(QStyle::PE_IndicatorCheckBox, &check, painter,
+        widget);
 }
 
 QlomLayoutItemTextDelegate::QlomLayoutItemTextDelegate(
@@ -210,6 +365,7 @@ QString QlomButtonDelegate::displayTest(const QVariant &, const QLocale&) const
 
 void QlomButtonDelegate::paint(QPainter * /*painter*/, const QStyleOptionViewItem &, const QModelIndex &index) const
 {
+    QlomPaintTimer paintTimer(metaObject()->className());
     QAbstractItemView *view = qobject_cast<QAbstractItemView *>(parent());
     if(view && !view->indexWidget(index)) {
         QPushButton *button = new QPushButton(theLabel, view);
@@ -19,6 +19,11 @@
 #ifndef QLOM_LAYOUT_DELEGATE_H_
 #define QLOM_LAYOUT_DELEGATE_H_
 
+#include "display_formatter.h"
+#include "trace.h"
+
+#include <QCache>
+#include <QLocale>
 #include <QStyledItemDelegate>
 #include <QPainter>
 #include <QStyleOptionViewItem>
@@ -54,11 +59,26 @@ public:
         const QModelIndex &index) const;
 
 protected:
+    /** Fill a cell with the background colour of the formatting, if it has
+     *  one.
+     *  @param[in] painter the painter of the view
+     *  @param[in] rect the rectangle of the cell */
+    void paintBackground(QPainter *painter, const QRect &rect) const;
+
     const Glom::Formatting theFormattingUsed;
     const GlomSharedField theFieldDetails;
 };
 
 
+/** The delegate of a field. Text that QlomListLayoutModel formatted in the
+ *  background is drawn as is. Otherwise, formatted numbers, dates and times
+ *  are cached per value, so that repainting cells that were seen before
+ *  costs a hash lookup instead of a QLocale::toString(). The delegate of a
+ *  column is its formatter, so the cache only depends on the locale, and is
+ *  cleared when that changes.
+ *  The views use a QlomTypedFieldDelegate, from create(), whose
+ *  displayText() is resolved for the type of the field at compile time.
+ *  This class itself checks the type for each value. */
 class QlomLayoutItemFieldDelegate : public QlomFieldFormattingDelegate
 {
     Q_OBJECT
@@ -69,11 +89,129 @@ public:
         QObject *parent = 0);
     virtual ~QlomLayoutItemFieldDelegate();
 
+    /** Create the delegate for the type of a field.
+     *  @param[in] formatting the formatting of the layout item
+     *  @param[in] details the field
+     *  @param[in] parent a parent QObject
+     *  @returns a QlomTypedFieldDelegate for the type of the field */
+    static QlomLayoutItemFieldDelegate * create(
+        const Glom::Formatting &formatting, const GlomSharedField details,
+        QObject *parent = 0);
+
     virtual QString displayText(const QVariant &value, const QLocale &locale)
         const;
 
+protected:
+    /** Overridden to use the text of Qlom::DisplayTextRole, if the model
+     *  formatted it for the locale of the view.
+     *  @param[in,out] option the option to initialise
+     *  @param[in] index the index of the cell */
+    virtual void initStyleOption(QStyleOptionViewItem *option,
+        const QModelIndex &index) const;
+
+    /** Get the display text of a value of a field type. The type-specific
+     *  versions are specialisations, defined in layout_delegates.cc; the
+     *  others show QVariant::toString().
+     *  @param[in] value the value
+     *  @param[in] locale the locale of the view
+     *  @returns the display text */
+    template <Glom::Field::glom_field_type FieldType>
+    QString typedDisplayText(const QVariant &value, const QLocale &locale)
+        const
+    {
+        Q_UNUSED(locale);
+        return value.toString();
+    }
+
+    mutable QString theFormattedText; /**< the text of the cell being
+                                           initialised, see
+                                           initStyleOption() */
+    mutable bool theFormattedTextFlag; /**< whether to use
+                                            theFormattedText */
+
 private:
-    QString applyNumericFormatting(double numeric, const QLocale &locale) const;
+    /** Format a value, or get it from theDisplayTexts. The delegate shows
+     *  values of one field type, so the keys of different types do not
+     *  clash.
+     *  @param[in] key the number, the Julian day of a date, or the
+     *  milliseconds since midnight of a time
+     *  @param[in] value the value
+     *  @param[in] locale the locale of the view
+     *  @returns the display text */
+    QString cachedText(double key, const QVariant &value,
+        const QLocale &locale) const;
+
+    mutable QCache<double, QString> theDisplayTexts; /**< formatted values,
+                                                          by key */
+    mutable QLocale theCacheLocale; /**< the locale of theDisplayTexts */
+    const QlomDisplayFormatter theFormatter; /**< formats the values */
+};
+
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_NUMERIC>(
+    const QVariant &value, const QLocale &locale) const;
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_DATE>(
+    const QVariant &value, const QLocale &locale) const;
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_TIME>(
+    const QVariant &value, const QLocale &locale) const;
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_BOOLEAN>(
+    const QVariant &value, const QLocale &locale) const;
+template <> QString
+QlomLayoutItemFieldDelegate::typedDisplayText<Glom::Field::TYPE_IMAGE>(
+    const QVariant &value, const QLocale &locale) const;
+
+/** The delegate of a field of one Glom type, chosen once per column by
+ *  QlomLayoutItemFieldDelegate::create(). Formatting a cell calls the
+ *  specialisation of typedDisplayText() directly, without checking the type
+ *  of the field. The delegates share the QMetaObject of their base class,
+ *  since moc does not support templates. */
+template <Glom::Field::glom_field_type FieldType>
+class QlomTypedFieldDelegate : public QlomLayoutItemFieldDelegate
+{
+public:
+    /** Create a delegate.
+     *  @param[in] formatting the formatting of the layout item
+     *  @param[in] details the field, which must be of FieldType
+     *  @param[in] parent a parent QObject */
+    QlomTypedFieldDelegate(const Glom::Formatting &formatting,
+        const GlomSharedField details, QObject *parent = 0) :
+        QlomLayoutItemFieldDelegate(formatting, details, parent)
+    {}
+
+    virtual QString displayText(const QVariant &value, const QLocale &locale)
+        const
+    {
+        QLOM_TRACE_SCOPE("QlomTypedFieldDelegate::displayText", "paint");
+        if (theFormattedTextFlag) {
+            return theFormattedText;
+        }
+
+        return typedDisplayText<FieldType>(value, locale);
+    }
+};
+
+/** The delegate of a boolean field, which paints a check box with the
+ *  style, centred in the cell, instead of a text. The model returns the
+ *  bit-packed values of QlomRowPage as plain bools, so painting neither
+ *  creates a widget per cell nor converts the value to a string. Null values
+ *  are left empty. displayText() still gives the Yes or No for copying and
+ *  the size hint. */
+class QlomBooleanFieldDelegate :
+    public QlomTypedFieldDelegate<Glom::Field::TYPE_BOOLEAN>
+{
+public:
+    /** Create a delegate.
+     *  @param[in] formatting the formatting of the layout item
+     *  @param[in] details the boolean field
+     *  @param[in] parent a parent QObject */
+    QlomBooleanFieldDelegate(const Glom::Formatting &formatting,
+        const GlomSharedField details, QObject *parent = 0);
+
+    virtual void paint(QPainter *painter, const QStyleOptionViewItem &option,
+        const QModelIndex &index) const;
 };
 
 class QlomLayoutItemTextDelegate : public QlomFieldFormattingDelegate
@@ -17,8 +17,10 @@
  */
 
 #include "list_layout_model.h"
+#include "sort_index.h"
 #include "utils.h"
 #include "error.h"
+#include "trace.h"
 
 #include <libglom/utils.h>
 #include <QSqlQuery>
@@ -28,23 +30,34 @@
 #include <QStringList>
 #include <QRegExp>
 
+/** The number of rows whose related records are resolved together. */
+static const int relatedPageSize = 256;
+
 /**  This class creates a model from Glom layout groups and layout items,
   *  suitable for list and detail views.
   */
-// We don't check for nullptr in document and error?
-QlomListLayoutModel::QlomListLayoutModel(const Glom::Document *document,
-    const QlomTable &table, bool &error,
-    QObject *parent, QSqlDatabase db) :
+// We don't check for nullptr in error?
+QlomListLayoutModel::QlomListLayoutModel(const QlomTable &table, bool &error,
+    QObject *parent, QSqlDatabase db, QlomQueryStatistics *statistics,
+    const std::shared_ptr<QlomMemoryBudget> &budget) :
     QSqlTableModel(parent, db),
-    theTable(table)
+    theTable(table),
+    theRelationshipLookup(table.relationships(), database()),
+    theQueryStatistics(statistics),
+    theRowCache(QString("list %1").arg(table.tableName()), database(),
+        budget, statistics),
+    theRowCount(0),
+    theSortAscendingFlag(true),
+    theRowOrderAscendingFlag(true)
 {
     error = false;
+    theRelationshipLookup.setQueryStatistics(theQueryStatistics);
     setTable(table.tableName());
 
     // The first item in a list layout group is always a main layout group.
     const Glib::ustring tableNameU(qstringToUstring(table.tableName()));
     const Glom::Document::type_list_layout_groups listLayout(
-        document->get_data_layout_groups("list", tableNameU));
+        table.listLayoutGroups());
 
     /* TODO: wrap in a get_list_model, so that the checks are kept together in
      * one place. */
@@ -53,11 +66,20 @@ QlomListLayoutModel::QlomListLayoutModel(const Glom::Document *document,
         std::shared_ptr<const Glom::LayoutGroup> group =
             std::dynamic_pointer_cast<const Glom::LayoutGroup>(theLayoutGroup);
         if (group) {
-            const QString strQuery = buildQuery(tableNameU, group);;
-            QSqlQuery query(strQuery);
-            setQuery(query);
+            findRelatedColumns(group);
+            const QString strQuery = buildQuery(tableNameU, group);
+
+            // Only the record and the column headers are kept by the base.
+            setQuery(QSqlQuery(strQuery + " LIMIT 0", database()));
+
+            // Runs the query and fetches the first batch of rows.
+            theRowCache.setFormatters(queryFormatters());
+            theRowCache.setQuery(strQuery);
+            theRowCount = theRowCache.rowCount();
+
             addStaticTextColumns(group);
             adjustColumnHeaders(group);
+            mapQueryColumns(group);
         }
     } else {
         error = true;
@@ -83,6 +105,9 @@ void QlomListLayoutModel::addStaticTextColumns(
              // Inserts before, and it is allowed to fail!
              insertColumn(columnsIndex);
              flag = true;
+         } else if (theRelatedColumns.contains(columnsIndex)) {
+             // The contents are provided by relatedData().
+             insertColumn(columnsIndex);
          }
 
          theStaticTextColumnIndices.push_back(flag);
@@ -90,6 +115,105 @@ void QlomListLayoutModel::addStaticTextColumns(
     }
 }
 
+void QlomListLayoutModel::findRelatedColumns(
+    const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup)
+{
+    const Glom::LayoutGroup::type_list_const_items items =
+        layoutGroup->get_items();
+
+    // Find the columns of the fields of this table, by field name.
+    QHash<QString, int> fieldColumns;
+    int columnsIndex = 0;
+    for (Glom::LayoutGroup::type_list_const_items::const_iterator iter =
+         items.begin();
+         iter != items.end();
+         ++iter) {
+         const std::shared_ptr<const Glom::LayoutItem_Field> field =
+             std::dynamic_pointer_cast<const Glom::LayoutItem_Field>(*iter);
+         if (field && !field->get_has_relationship_name()) {
+             fieldColumns.insert(ustringToQstring(field->get_name()),
+                 columnsIndex);
+         }
+         ++columnsIndex;
+    }
+
+    /* Fields of doubly-related tables, and fields whose from-field is not
+     * shown, are still joined by the SQL query. */
+    columnsIndex = 0;
+    for (Glom::LayoutGroup::type_list_const_items::const_iterator iter =
+         items.begin();
+         iter != items.end();
+         ++iter) {
+         const std::shared_ptr<const Glom::LayoutItem_Field> field =
+             std::dynamic_pointer_cast<const Glom::LayoutItem_Field>(*iter);
+         if (field && field->get_has_relationship_name()
+             && !field->get_has_related_relationship_name()) {
+             const int relationshipIndex = theRelationshipLookup.indexOf(
+                 ustringToQstring(field->get_relationship_name()));
+             const QString fromColumn = (-1 == relationshipIndex
+                 ? QString()
+                 : theTable.relationships().at(relationshipIndex).fromColumn());
+
+             if (fieldColumns.contains(fromColumn)) {
+                 RelatedColumn related;
+                 related.relationshipIndex = relationshipIndex;
+                 related.fromColumn = fieldColumns.value(fromColumn);
+                 related.toColumn = ustringToQstring(field->get_name());
+                 theRelatedColumns.insert(columnsIndex, related);
+                 theRelationshipLookup.addColumn(relationshipIndex,
+                     related.toColumn);
+             }
+         }
+         ++columnsIndex;
+    }
+}
+
+QVector<QlomDisplayFormatter> QlomListLayoutModel::queryFormatters() const
+{
+    QVector<QlomDisplayFormatter> formatters;
+    for (Glom::Utils::type_vecConstLayoutFields::const_iterator iter =
+         theQueryFields.begin();
+         iter != theQueryFields.end();
+         ++iter) {
+         const std::shared_ptr<const Glom::Field> details =
+             (*iter)->get_full_field_details();
+         formatters.push_back(QlomDisplayFormatter(
+             (details ? details->get_glom_type() : Glom::Field::TYPE_INVALID),
+             (*iter)->get_formatting_used().m_numeric_format));
+    }
+
+    return formatters;
+}
+
+void QlomListLayoutModel::mapQueryColumns(
+    const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup)
+{
+    const Glom::LayoutGroup::type_list_const_items items =
+        layoutGroup->get_items();
+
+    int queryColumn = 0;
+    int columnsIndex = 0;
+    for (Glom::LayoutGroup::type_list_const_items::const_iterator iter =
+         items.begin();
+         iter != items.end();
+         ++iter) {
+         const std::shared_ptr<const Glom::LayoutItem_Field> field =
+             std::dynamic_pointer_cast<const Glom::LayoutItem_Field>(*iter);
+         if (std::dynamic_pointer_cast<const Glom::LayoutItem_Text>(*iter)
+             || (field && theRelatedColumns.contains(columnsIndex))) {
+             // Inserted by addStaticTextColumns().
+             theQueryColumns.push_back(-1);
+         } else if (field) {
+             theQueryColumns.push_back(queryColumn);
+             ++queryColumn;
+         }
+         ++columnsIndex;
+    }
+
+    // The place holder of the actions column, see buildQuery().
+    theQueryColumns.push_back(queryColumn);
+}
+
 void QlomListLayoutModel::adjustColumnHeaders(
     const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup)
 {
@@ -112,6 +236,11 @@ QString QlomListLayoutModel::tableDisplayName() const
     return theTable.displayName();
 }
 
+const QlomTable & QlomListLayoutModel::table() const
+{
+    return theTable;
+}
+
 const QlomListLayoutModel::GlomSharedLayoutItems QlomListLayoutModel::getLayoutItems() const
 {
     return theLayoutGroup->get_items();
@@ -120,10 +249,7 @@ const QlomListLayoutModel::GlomSharedLayoutItems QlomListLayoutModel::getLayoutI
 QString QlomListLayoutModel::buildQuery(const Glib::ustring& table,
                                         const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup)
 {
-    //TODO: The where_clause and extra_join types must be in ifdefed if we 
-    //really want to support the libglom-1-12 too:
-    const Gnome::Gda::SqlExpr where_clause; //Ignored.
-    const std::shared_ptr<const Glom::Relationship> extra_join; //Ignored.
+    QLOM_TRACE_SCOPE("buildQuery", "query");
     Glom::type_sort_clause sort_clause;
     Glom::Utils::type_vecConstLayoutFields fields;
     const Glom::LayoutGroup::type_list_const_items items = layoutGroup->get_items();
@@ -149,7 +275,12 @@ QString QlomListLayoutModel::buildQuery(const Glib::ustring& table,
          ++iter) {
          const std::shared_ptr<const Glom::LayoutItem_Field> field =
              std::dynamic_pointer_cast<const Glom::LayoutItem_Field>(*iter);
-         if (field) {
+         if (field
+             && theRelatedColumns.contains(std::distance(items.begin(), iter))) {
+             /* Not part of the query. The column is inserted by
+              * addStaticTextColumns() and filled by relatedData(). */
+             ++index;
+         } else if (field) {
 
              // Copy the first field we find into the place holder
              if (!placeHolder) {
@@ -184,9 +315,33 @@ QString QlomListLayoutModel::buildQuery(const Glib::ustring& table,
     // Pad the static text column lookup list accordingly.
     theStaticTextColumnIndices.push_back(false);
 
+    theTableName = table;
+    theQueryFields = fields;
+    thePrimaryKeySort = sort_clause;
+    return selectQuery();
+}
+
+QString QlomListLayoutModel::selectQuery() const
+{
+    //TODO: The where_clause and extra_join types must be in ifdefed if we 
+    //really want to support the libglom-1-12 too:
+    const Gnome::Gda::SqlExpr where_clause; //Ignored.
+    const std::shared_ptr<const Glom::Relationship> extra_join; //Ignored.
+
+    /* The primary key comes last, so that the order is total, which
+     * QlomRowCache relies on to reload evicted pages. */
+    Glom::type_sort_clause sort_clause;
+    if (theSortField) {
+        sort_clause.push_back(
+            Glom::type_pair_sort_field(theSortField, theSortAscendingFlag));
+    }
+    sort_clause.insert(sort_clause.end(), thePrimaryKeySort.begin(),
+        thePrimaryKeySort.end());
+
     const Glib::RefPtr<Gnome::Gda::SqlBuilder> builder 
         = Glom::Utils::build_sql_select_with_where_clause(
-            table, fields, where_clause, extra_join, sort_clause);
+            theTableName, theQueryFields, where_clause, extra_join,
+            sort_clause);
     const Glib::ustring query = Glom::Utils::sqlbuilder_get_full_query(builder);
     return ustringToQstring(query);
 }
@@ -199,19 +354,237 @@ bool QlomListLayoutModel::insertColumnAt(int columnIndex)
 
 
 
-bool QlomListLayoutModel::canFetchMore()
+int QlomListLayoutModel::rowCount(const QModelIndex &parent) const
+{
+    return (parent.isValid() ? 0 : theRowCount);
+}
+
+bool QlomListLayoutModel::canFetchMore(const QModelIndex &parent) const
+{
+    return (!parent.isValid() && theRowCache.canFetchMore());
+}
+
+void QlomListLayoutModel::fetchMore(const QModelIndex &parent)
+{
+    QLOM_TRACE_SCOPE("fetchMore", "fetch");
+    if (parent.isValid()) {
+        return;
+    }
+
+    if (0 < theRowCache.fetchMore()) {
+        beginInsertRows(QModelIndex(), theRowCount,
+            theRowCache.rowCount() - 1);
+        theRowCount = theRowCache.rowCount();
+        endInsertRows();
+    }
+}
+
+void QlomListLayoutModel::sort(int column, Qt::SortOrder order)
+{
+    // The place holder of the actions column is not sorted by.
+    const int queryColumn = theQueryColumns.value(column, -1);
+    if (-1 == queryColumn || column == theQueryColumns.size() - 1) {
+        return;
+    }
+
+    QHash<int, QVector<int> >::const_iterator index =
+        theSortIndexes.constFind(queryColumn);
+    if (!theRowCache.canFetchMore()
+        && (index != theSortIndexes.constEnd() || theRowCache.isResident())) {
+        // All rows are cached, so they are sorted without a query.
+        if (index == theSortIndexes.constEnd()) {
+            index = theSortIndexes.insert(queryColumn,
+                QlomSortIndex::build(theRowCache, queryColumn,
+                    queryColumnType(queryColumn)));
+        }
+
+        beginResetModel();
+        theRowOrder = *index;
+        theRowOrderAscendingFlag = (Qt::AscendingOrder == order);
+        updateVisibleRows();
+        endResetModel();
+        return;
+    }
+
+    theSortField = theQueryFields.at(queryColumn);
+    theSortAscendingFlag = (Qt::AscendingOrder == order);
+
+    beginResetModel();
+    theSortIndexes.clear();
+    theRowOrder.clear();
+    theFilterColumns.clear();
+    theRowFilters.clear();
+    theVisibleRows.clear();
+    theRowCache.setQuery(selectQuery());
+    theRowCount = theRowCache.rowCount();
+    endResetModel();
+}
+
+bool QlomListLayoutModel::setRowFilter(int column,
+    const QlomRowFilter &filter)
+{
+    // The place holder of the actions column is not filtered by.
+    const int queryColumn = theQueryColumns.value(column, -1);
+    if (-1 == queryColumn || column == theQueryColumns.size() - 1
+        || theRowCache.canFetchMore()) {
+        return false;
+    }
+
+    // Extracting a column would reload the evicted pages one by one.
+    if (!theFilterColumns.contains(queryColumn)
+        && !theRowCache.isResident()) {
+        return false;
+    }
+
+    // Extracts the column, unless it is up to date.
+    filterColumn(queryColumn);
+
+    beginResetModel();
+    theRowFilters.insert(queryColumn, filter);
+    updateVisibleRows();
+    endResetModel();
+    return true;
+}
+
+void QlomListLayoutModel::removeRowFilter(int column)
+{
+    const int queryColumn = theQueryColumns.value(column, -1);
+    if (!theRowFilters.contains(queryColumn)) {
+        return;
+    }
+
+    beginResetModel();
+    theRowFilters.remove(queryColumn);
+    updateVisibleRows();
+    endResetModel();
+}
+
+bool QlomListLayoutModel::hasRowFilter(int column) const
+{
+    return theRowFilters.contains(theQueryColumns.value(column, -1));
+}
+
+Glom::Field::glom_field_type QlomListLayoutModel::columnType(int column)
+    const
+{
+    // The place holder of the actions column has no type of its own.
+    const int queryColumn = theQueryColumns.value(column, -1);
+    if (-1 == queryColumn || column == theQueryColumns.size() - 1) {
+        return Glom::Field::TYPE_INVALID;
+    }
+
+    return queryColumnType(queryColumn);
+}
+
+bool QlomListLayoutModel::searchColumns(QVector<QlomFilterColumn> &columns)
+{
+    // The place holder of the actions column repeats a column.
+    bool complete = true;
+    columns.clear();
+    for (int queryColumn = 0; queryColumn < theQueryFields.size() - 1;
+         ++queryColumn) {
+        if (Glom::Field::TYPE_TEXT != queryColumnType(queryColumn)) {
+            continue;
+        }
+
+        // Only the rows that the column does not have yet are read.
+        const QHash<int, QlomFilterColumn>::const_iterator extracted =
+            theFilterColumns.constFind(queryColumn);
+        int firstRow = 0;
+        if (extracted != theFilterColumns.constEnd()
+            && (*extracted).rowCount() <= theRowCache.rowCount()) {
+            firstRow = (*extracted).rowCount();
+        }
+
+        if (!theRowCache.areRowsResident(firstRow,
+                theRowCache.rowCount() - 1)) {
+            complete = false;
+            continue;
+        }
+
+        columns.push_back(filterColumn(queryColumn));
+    }
+
+    return complete;
+}
+
+QVector<int> QlomListLayoutModel::cacheRows() const
+{
+    if (!theRowFilters.isEmpty())
+        return theVisibleRows;
+
+    if (theRowOrder.isEmpty() || theRowOrderAscendingFlag)
+        return theRowOrder;
+
+    QVector<int> rows;
+    rows.reserve(theRowOrder.size());
+    for (int row = 0; row < theRowOrder.size(); ++row) {
+        rows.push_back(sortedRow(row));
+    }
+
+    return rows;
+}
+
+const QlomFilterColumn & QlomListLayoutModel::filterColumn(int queryColumn)
+{
+    QHash<int, QlomFilterColumn>::iterator column =
+        theFilterColumns.find(queryColumn);
+    if (column == theFilterColumns.end()
+        || (*column).rowCount() > theRowCache.rowCount()) {
+        column = theFilterColumns.insert(queryColumn,
+            QlomFilterColumn(theRowCache, queryColumn,
+                queryColumnType(queryColumn)));
+    } else if ((*column).rowCount() < theRowCache.rowCount()) {
+        // Only the rows fetched since are extracted.
+        (*column).append(theRowCache, queryColumn);
+    }
+
+    return *column;
+}
+
+void QlomListLayoutModel::updateVisibleRows()
 {
-    const bool canFetchMore = QSqlTableModel::canFetchMore();
+    QLOM_TRACE_SCOPE("updateVisibleRows", "filter");
+    theVisibleRows.clear();
+    const int rows = theRowCache.rowCount();
+    if (theRowFilters.isEmpty()) {
+        theRowCount = rows;
+        return;
+    }
+
+    QVector<quint64> selection;
+    for (QHash<int, QlomRowFilter>::const_iterator iter =
+             theRowFilters.begin();
+         iter != theRowFilters.end();
+         ++iter) {
+        const QVector<quint64> bits =
+            (*iter).select(theFilterColumns.value(iter.key()));
+        if (selection.isEmpty()) {
+            selection = bits;
+            continue;
+        }
 
-    /* Drop the shared lock by *finishing* the transaction.
-     * Otherwise, other db connections cannot write to the opened table.
-     * Once we fetched all data, there is also no need to keep a lock, since we
-     * don't intend to write to the table (even if so, that'd be another
-     * transaction). */
-    if(!canFetchMore)
-        database().commit();
+        for (int word = 0; word < selection.size(); ++word) {
+            selection[word] &= bits.at(word);
+        }
+    }
 
-    return canFetchMore;
+    for (int row = 0; row < rows; ++row) {
+        const int sorted = sortedRow(row);
+        if (selection.at(sorted / 64) & (quint64(1) << (sorted % 64))) {
+            theVisibleRows.push_back(sorted);
+        }
+    }
+
+    theRowCount = theVisibleRows.size();
+}
+
+Glom::Field::glom_field_type QlomListLayoutModel::queryColumnType(
+    int queryColumn) const
+{
+    const std::shared_ptr<const Glom::Field> details =
+        theQueryFields.at(queryColumn)->get_full_field_details();
+    return (details ? details->get_glom_type() : Glom::Field::TYPE_INVALID);
 }
 
 QVariant QlomListLayoutModel::data(const QModelIndex &index, int role) const
@@ -228,6 +601,72 @@ QVariant QlomListLayoutModel::data(const QModelIndex &index, int role) const
     if (theStaticTextColumnIndices[columnsIndex] && Qt::DisplayRole == role)
         return QVariant(QString(""));
 
+    if (Qlom::DisplayTextRole == role) {
+        const int queryColumn = theQueryColumns.value(index.column(), -1);
+        if (-1 == queryColumn)
+            return QVariant();
+
+        const QString text = theRowCache.displayText(cacheRow(index.row()),
+            queryColumn);
+        return (text.isNull() ? QVariant() : QVariant(text));
+    }
+
+    if (Qt::DisplayRole == role || Qt::EditRole == role) {
+        const QHash<int, RelatedColumn>::const_iterator related =
+            theRelatedColumns.constFind(index.column());
+        if (related != theRelatedColumns.constEnd())
+            return relatedData(index.row(), *related);
+
+        return queryData(index.row(), index.column());
+    }
+
    return QSqlTableModel::data(index, role);
 }
 
+int QlomListLayoutModel::cacheRow(int row) const
+{
+    return (theRowFilters.isEmpty() ? sortedRow(row)
+        : theVisibleRows.at(row));
+}
+
+int QlomListLayoutModel::sortedRow(int row) const
+{
+    if (theRowOrder.isEmpty())
+        return row;
+
+    // Descending is ascending backwards, so that toggling does not sort.
+    return theRowOrder.at(theRowOrderAscendingFlag ? row
+        : theRowOrder.size() - 1 - row);
+}
+
+QVariant QlomListLayoutModel::queryData(int row, int column) const
+{
+    const int queryColumn = theQueryColumns.value(column, -1);
+    if (-1 == queryColumn)
+        return QVariant();
+
+    return theRowCache.value(cacheRow(row), queryColumn);
+}
+
+QVariant QlomListLayoutModel::relatedData(int row,
+    const RelatedColumn &related) const
+{
+    const QVariant key = queryData(row, related.fromColumn);
+    if (key.isNull())
+        return QVariant();
+
+    if (!theRelationshipLookup.contains(related.relationshipIndex, key)) {
+        // Resolve the keys of the whole page, rather than one row at a time.
+        const int firstRow = row - row % relatedPageSize;
+        const int lastRow = qMin(firstRow + relatedPageSize, rowCount());
+        QList<QVariant> keys;
+        for (int pageRow = firstRow; pageRow < lastRow; ++pageRow) {
+            keys.push_back(queryData(pageRow, related.fromColumn));
+        }
+        theRelationshipLookup.prefetch(related.relationshipIndex, keys);
+    }
+
+    return theRelationshipLookup.value(related.relationshipIndex, key,
+        related.toColumn);
+}
+
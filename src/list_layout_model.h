@@ -21,19 +21,42 @@
 
 #include "table.h"
 #include "layout_delegates.h"
+#include "query_statistics.h"
+#include "relationship_lookup.h"
+#include "row_cache.h"
+#include "row_filter.h"
 
+#include <memory>
+
+#include <QHash>
 #include <QSqlDatabase>
 #include <QSqlTableModel>
 #include <QString>
+#include <QVector>
 
 #include <libglom/document/document.h>
 #include <libglom/data_structure/layout/layoutgroup.h>
+#include <libglom/utils.h>
+
+namespace Qlom
+{
+
+/** Data display roles for QlomListLayoutModel. */
+enum ListLayoutModelRoles {
+    DisplayTextRole = 33 /**< retrieves the text formatted in the
+                              background, if any */
+};
+
+} // namespace Qlom
 
 /** A model to show a list layout from a Glom document.
  *  The list layout model obtains all the information that is required at
  *  construction time, and is then treated as read-only.
  *  A class-wide assumption is that the n-th layout item in a layout group is
- *  displayed as the n-th column in the table model (and view). */
+ *  displayed as the n-th column in the table model (and view).
+ *  The rows are kept by a QlomRowCache rather than by QSqlTableModel, whose
+ *  query only provides the record and the column headers, so that the rows
+ *  count against the memory budget of the document. */
 class QlomListLayoutModel : public QSqlTableModel
 {
     Q_OBJECT
@@ -46,29 +69,104 @@ public:
        class makes the same mistake.
        TODO: File a bug when there is a public Qt bug tracker. */
 
-    /** Create a model of a list layout from a Glom document and a table.
+    /** Create a model of a list layout from a table of a Glom document.
      *  The parameters are construct-time only, and thereafter the object is
      *  read-only.
-     *  @param[in]  document a Glom document
      *  @param[in]  table the Glom table containing a list layout
      *  @param[out] error true, if an error occure, because no list model has
      *                    been found
      *  @param[in]  parent a parent QObject
-     *  @param[in]  db a database connection, or the default connection */
-    explicit QlomListLayoutModel(const Glom::Document *document,
-        const QlomTable &table, bool &error, QObject *parent = 0,
-        QSqlDatabase db = QSqlDatabase());
+     *  @param[in]  db a database connection, or the default connection
+     *  @param[in]  statistics a collector for the latency and throughput of
+     *              the queries of the model, or 0 for none
+     *  @param[in]  budget the memory budget that the rows count against, or
+     *              0 for none */
+    explicit QlomListLayoutModel(const QlomTable &table, bool &error,
+        QObject *parent = 0,
+        QSqlDatabase db = QSqlDatabase(),
+        QlomQueryStatistics *statistics = 0,
+        const std::shared_ptr<QlomMemoryBudget> &budget =
+            std::shared_ptr<QlomMemoryBudget>());
 
     /** Get the table name used in the model, for display to the user.
      *  @returns the table name */
     QString tableDisplayName() const;
 
+    /** Get the table shown by the model.
+     *  @returns the table */
+    const QlomTable & table() const;
+
     /** Since insertColumn is not virtual, it must be wrapped in a forwarding
       * method. This method will update theStaticTextColumnIndices too. */
     bool insertColumnAt(int columnIndex);
 
-    /** Overriden so that we can drop the shared lock. */
-    virtual bool canFetchMore();
+    /** Overridden to count the rows of theRowCache.
+     *  @param[in] parent the parent index, which is invalid for tables */
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /** Overridden to ask theRowCache.
+     *  @param[in] parent the parent index, which is invalid for tables */
+    virtual bool canFetchMore(const QModelIndex &parent = QModelIndex())
+        const;
+
+    /** Overridden to fetch the next page of theRowCache.
+     *  @param[in] parent the parent index, which is invalid for tables */
+    virtual void fetchMore(const QModelIndex &parent = QModelIndex());
+
+    /** Overridden to sort in the query. QSqlTableModel::sort() would select
+     *  the whole table, without the layout and bypassing theRowCache.
+     *  Once all rows are cached, they are sorted in memory instead, by a
+     *  QlomSortIndex that is kept per column, so that toggling the order or
+     *  returning to a column does not sort again. An index is only built
+     *  while no page is evicted, since reloading the pages one by one would
+     *  be slower than sorting in the query.
+     *  Columns that are not part of the query are not sorted by.
+     *  @param[in] column the model column to sort by
+     *  @param[in] order the sort order */
+    virtual void sort(int column, Qt::SortOrder order);
+
+    /** Show only the rows whose value in a column matches a filter. The
+     *  filters of all columns must match. They are evaluated in memory, so
+     *  all rows must be cached. The column is extracted into a
+     *  QlomFilterColumn the first time it is filtered, and kept, so that
+     *  changing the filter only scans the column again.
+     *  @param[in] column the model column
+     *  @param[in] filter the filter, which replaces that of the column
+     *  @returns true on success, false if the column is not part of the
+     *  query, if there are rows left to fetch, or if the column is not
+     *  extracted yet and pages were evicted */
+    bool setRowFilter(int column, const QlomRowFilter &filter);
+
+    /** Remove the filter of a column, see setRowFilter().
+     *  @param[in] column the model column */
+    void removeRowFilter(int column);
+
+    /** Whether a column has a filter, see setRowFilter().
+     *  @param[in] column the model column
+     *  @returns true if the column is filtered, false otherwise */
+    bool hasRowFilter(int column) const;
+
+    /** Get the Glom type of a column, which decides how the values of its
+     *  filter are read, see QlomRowFilter::parse().
+     *  @param[in] column the model column
+     *  @returns the type, or Glom::Field::TYPE_INVALID if the column is not
+     *  part of the query */
+    Glom::Field::glom_field_type columnType(int column) const;
+
+    /** Get the text columns of the query, over the rows fetched so far, for
+     *  QlomQuickSearch. The columns are kept with those of setRowFilter(),
+     *  and only the rows fetched since the last call are extracted. A column
+     *  is left out if the rows to extract have evicted pages, since
+     *  reloading them one by one would block the caller.
+     *  @param[out] columns the dictionary-encoded columns
+     *  @returns true if all text columns are included, false otherwise */
+    bool searchColumns(QVector<QlomFilterColumn> &columns);
+
+    /** Get the row of the columns of searchColumns() shown in each row of
+     *  the model.
+     *  @returns the rows, or an empty vector if each model row shows the
+     *  row of the same number */
+    QVector<int> cacheRows() const;
 
     /** Returns the layout items used for the current table. */
     const GlomSharedLayoutItems getLayoutItems() const;
@@ -78,14 +176,83 @@ protected:
       * static text items leaves them without actual content. For those columns
       * we want to return an empty QString (rather than a "isNull" QString). The
       * reason is that for valid QVariants containing null values, the style
-      * delegate's displayText() method is not called. */
+      * delegate's displayText() method is not called. The values of the
+      * query are read from theRowCache. */
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole)
         const;
 
 private:
-    /** A wrapper for Glom::Utils::build_sql_select_with_where_clause() which
-      * also handles column headers and static text (TODO: need to rename this
-      * method).
+    /** A column showing a field from a related table. */
+    struct RelatedColumn {
+        int relationshipIndex; /**< index in theRelationshipLookup */
+        int fromColumn; /**< model column holding the from-field */
+        QString toColumn; /**< field name in the related table */
+    };
+
+    /** Finds the related fields of the layout group that can be resolved by
+      * theRelationshipLookup, instead of by joins in the SQL query. That is
+      * the case when the from-field of the relationship is shown as well, so
+      * that the keys can be read from the model. Must be called before
+      * buildQuery(). */
+    void findRelatedColumns(
+        const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup);
+
+    /** Get the value of a related column. All keys of the page containing the
+      * row are resolved in one go, so that the first row of a page costs one
+      * query per relationship and the other rows cost none.
+      * @param[in] row the model row
+      * @param[in] related the related column
+      * @returns the value from the related record */
+    QVariant relatedData(int row, const RelatedColumn &related) const;
+
+    /** Get the row of theRowCache shown in a row of the model.
+      * @param[in] row the model row
+      * @returns the cache row */
+    int cacheRow(int row) const;
+
+    /** Get the row of theRowCache at a position of theRowOrder, regardless
+      * of the filters.
+      * @param[in] row the position
+      * @returns the cache row */
+    int sortedRow(int row) const;
+
+    /** Find the rows that match theRowFilters, in the order of theRowOrder,
+      * and count them. Must be called between beginResetModel() and
+      * endResetModel(). */
+    void updateVisibleRows();
+
+    /** Get the column of a query column that setRowFilter() and
+      * searchColumns() scan, extracting it if it is missing, and appending
+      * the rows that were fetched since otherwise.
+      * @param[in] queryColumn the column of the query
+      * @returns the column */
+    const QlomFilterColumn & filterColumn(int queryColumn);
+
+    /** Get the Glom type of a column of the query.
+      * @param[in] queryColumn the column of the query
+      * @returns the type */
+    Glom::Field::glom_field_type queryColumnType(int queryColumn) const;
+
+    /** Get a value of a column of the query.
+      * @param[in] row the model row
+      * @param[in] column the model column
+      * @returns the value, or an invalid QVariant if the column is not part
+      * of the query */
+    QVariant queryData(int row, int column) const;
+
+    /** Create the formatters of the fields of the query, for the formatting
+      * stage of theRowCache. Must be called after buildQuery().
+      * @returns a formatter per query column */
+    QVector<QlomDisplayFormatter> queryFormatters() const;
+
+    /** Finds the fields of the layout group that are part of the query, for
+      * theQueryColumns. Must be called after buildQuery(). */
+    void mapQueryColumns(
+        const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup);
+
+    /** Collects the fields of the query and the primary key to sort by, and
+      * also handles column headers and static text (TODO: need to rename
+      * this method).
       * @param[in] table the name of the table
       * @param[in] layoutGroup a shared pointer to a Glom LayoutGroup that is
       *            suitable for a list view (i.e., contains LayoutItem_Fields).
@@ -94,6 +261,12 @@ private:
     QString buildQuery(const Glib::ustring &table,
         const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup);
 
+    /** A wrapper for Glom::Utils::build_sql_select_with_where_clause(), for
+      * the fields found by buildQuery(), sorted by theSortField if set and
+      * then by the primary key.
+      * @returns the SQL query as a string */
+    QString selectQuery() const;
+
     /** Iterates over the layout group to find static text items so that it can
       * insert columns into the table. */
     void addStaticTextColumns(const std::shared_ptr<const Glom::LayoutGroup> &layoutGroup);
@@ -109,6 +282,41 @@ private:
                                                    because we display their
                                                    column-static contents with a
                                                    delegate. */
+    QHash<int, RelatedColumn> theRelatedColumns; /**< related columns, keyed
+                                                      by model column */
+    mutable QlomRelationshipLookup theRelationshipLookup; /**< cache of the
+                                                               related
+                                                               records */
+    QlomQueryStatistics *theQueryStatistics; /**< collects the latency and
+                                                  throughput of the queries,
+                                                  or 0 */
+    mutable QlomRowCache theRowCache; /**< the rows of the query */
+    int theRowCount; /**< the rows of theRowCache that were inserted */
+    QVector<int> theQueryColumns; /**< the query column of each model column,
+                                       or -1 */
+    Glib::ustring theTableName; /**< the table of the query */
+    Glom::Utils::type_vecConstLayoutFields theQueryFields; /**< the fields
+                                                                of the
+                                                                query */
+    Glom::type_sort_clause thePrimaryKeySort; /**< sorts by the primary
+                                                   key */
+    std::shared_ptr<const Glom::LayoutItem_Field> theSortField; /**< see
+                                                                     sort() */
+    bool theSortAscendingFlag; /**< see sort() */
+    QHash<int, QVector<int> > theSortIndexes; /**< the rows of theRowCache in
+                                                   ascending order, by query
+                                                   column */
+    QVector<int> theRowOrder; /**< the rows of theRowCache in the order of
+                                   the sort in memory, or empty */
+    bool theRowOrderAscendingFlag; /**< whether theRowOrder is shown in
+                                        ascending order */
+    QHash<int, QlomFilterColumn> theFilterColumns; /**< the columns that were
+                                                        filtered, by query
+                                                        column */
+    QHash<int, QlomRowFilter> theRowFilters; /**< see setRowFilter(), by
+                                                  query column */
+    QVector<int> theVisibleRows; /**< the rows of theRowCache that match
+                                      theRowFilters, in the order shown */
 };
 
 #endif /* QLOM_LIST_LAYOUT_MODEL_H_ */
@@ -0,0 +1,147 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory_budget.h"
+#include "row_cache.h"
+
+#include <algorithm>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/** The pages of the active cache that are never evicted, so that the rows
+ *  around the ones being shown stay in memory even over budget. */
+static const int activeResidentPages = 8;
+
+/** The memory to evict before free memory is returned to the system. */
+static const qint64 trimBytes = Q_INT64_C(16) * 1024 * 1024;
+
+const qint64 QlomMemoryBudget::defaultLimit = Q_INT64_C(256) * 1024 * 1024;
+
+/** Order caches by the time they were last used, oldest first.
+ *  @param[in] first a cache
+ *  @param[in] second another cache
+ *  @returns whether first was used before second */
+static bool usedEarlier(const QlomRowCache *first, const QlomRowCache *second)
+{
+    return first->lastUsed() < second->lastUsed();
+}
+
+/** Return the free memory of the heap to the system. The pages are small
+ *  enough to be allocated from the heap, and glibc keeps freed heap memory
+ *  for reuse otherwise. */
+static void trimHeap()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+QlomMemoryBudget::QlomMemoryBudget(qint64 limit) :
+    theLimit(limit),
+    theUntrimmedBytes(0)
+{}
+
+void QlomMemoryBudget::setLimit(qint64 limit)
+{
+    theLimit = limit;
+    enforce();
+}
+
+qint64 QlomMemoryBudget::limit() const
+{
+    return theLimit;
+}
+
+qint64 QlomMemoryBudget::usage() const
+{
+    qint64 bytes = 0;
+    for (QList<QlomRowCache *>::const_iterator iter = theCaches.begin();
+         iter != theCaches.end();
+         ++iter) {
+        bytes += (*iter)->bytes();
+    }
+
+    return bytes;
+}
+
+QList<QlomMemoryBudget::Usage> QlomMemoryBudget::usages() const
+{
+    QList<Usage> result;
+    for (QList<QlomRowCache *>::const_iterator iter = theCaches.begin();
+         iter != theCaches.end();
+         ++iter) {
+        Usage usage;
+        usage.name = (*iter)->name();
+        usage.rows = (*iter)->rowCount();
+        usage.pages = (*iter)->pageCount();
+        usage.residentPages = (*iter)->residentPageCount();
+        usage.evictedPages = (*iter)->evictedPageCount();
+        usage.bytes = (*iter)->bytes();
+        result.push_back(usage);
+    }
+
+    return result;
+}
+
+void QlomMemoryBudget::addCache(QlomRowCache *cache)
+{
+    Q_ASSERT(!theCaches.contains(cache));
+    theCaches.push_back(cache);
+}
+
+void QlomMemoryBudget::removeCache(QlomRowCache *cache)
+{
+    theCaches.removeOne(cache);
+}
+
+void QlomMemoryBudget::enforce(QlomRowCache *active)
+{
+    if (theLimit <= 0) {
+        return;
+    }
+
+    qint64 excess = usage() - theLimit;
+    if (excess <= 0) {
+        return;
+    }
+
+    // Background tables first, by how long ago they were used.
+    QList<QlomRowCache *> caches(theCaches);
+    caches.removeOne(active);
+    std::sort(caches.begin(), caches.end(), usedEarlier);
+    if (active) {
+        caches.push_back(active);
+    }
+
+    for (QList<QlomRowCache *>::const_iterator iter = caches.begin();
+         iter != caches.end() && excess > 0;
+         ++iter) {
+        const int keepPages = (*iter == caches.last()
+            ? activeResidentPages : 0);
+        const qint64 freed = (*iter)->evict(excess, keepPages);
+        excess -= freed;
+        theUntrimmedBytes += freed;
+    }
+
+    if (theUntrimmedBytes >= trimBytes) {
+        trimHeap();
+        theUntrimmedBytes = 0;
+    }
+}
@@ -0,0 +1,93 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_MEMORY_BUDGET_H_
+#define QLOM_MEMORY_BUDGET_H_
+
+#include <QList>
+#include <QString>
+
+class QlomRowCache;
+
+/** A limit on the memory used by the row caches of all list models.
+ *  Each QlomRowCache registers itself, and calls enforce() whenever it has
+ *  grown. If the caches use more than the limit together, pages are evicted
+ *  until they fit again: first from the caches that were used least
+ *  recently, which belong to tables in the background, and last from the
+ *  cache that grew, which keeps the pages it used most recently. Evicted
+ *  pages are queried again when they are needed, and the memory they used
+ *  is returned to the system every few megabytes. The budget is only used
+ *  on the GUI thread. */
+class QlomMemoryBudget
+{
+public:
+    /** The memory used by one row cache, for the diagnostics. */
+    struct Usage
+    {
+        QString name; /**< the name of the cache */
+        int rows; /**< the rows fetched so far */
+        int pages; /**< the pages fetched so far */
+        int residentPages; /**< the pages in memory */
+        qint64 evictedPages; /**< the evictions so far */
+        qint64 bytes; /**< the memory used by the pages in memory */
+    };
+
+    /** Create a budget.
+     *  @param[in] limit the limit in bytes, or 0 for no limit */
+    explicit QlomMemoryBudget(qint64 limit = defaultLimit);
+
+    /** Change the limit, evicting pages if needed.
+     *  @param[in] limit the limit in bytes, or 0 for no limit */
+    void setLimit(qint64 limit);
+
+    /** Get the limit.
+     *  @returns the limit in bytes, or 0 for no limit */
+    qint64 limit() const;
+
+    /** Get the memory used by all caches.
+     *  @returns the memory in bytes */
+    qint64 usage() const;
+
+    /** Get the memory used by each cache.
+     *  @returns the usage per cache, in the order they were added */
+    QList<Usage> usages() const;
+
+    /** Register a cache. Called by the constructor of QlomRowCache.
+     *  @param[in] cache the cache */
+    void addCache(QlomRowCache *cache);
+
+    /** Unregister a cache. Called by the destructor of QlomRowCache.
+     *  @param[in] cache the cache */
+    void removeCache(QlomRowCache *cache);
+
+    /** Evict pages until the caches fit into the limit.
+     *  @param[in] active the cache that grew, which is evicted from last, or
+     *  0 to evict from all caches by how recently they were used */
+    void enforce(QlomRowCache *active = 0);
+
+    /** The default limit, in bytes. */
+    static const qint64 defaultLimit;
+
+private:
+    qint64 theLimit; /**< see limit() */
+    QList<QlomRowCache *> theCaches; /**< the registered caches */
+    qint64 theUntrimmedBytes; /**< the memory evicted since the heap was
+                                   last trimmed */
+};
+
+#endif /* QLOM_MEMORY_BUDGET_H_ */
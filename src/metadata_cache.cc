@@ -0,0 +1,259 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metadata_cache.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+/** Identifies a Qlom sidecar file ("QLMC"). */
+static const quint32 sidecarMagic = 0x514c4d43;
+
+/** Increment whenever the layout of the sidecar changes. */
+static const quint32 sidecarVersion = 2;
+
+QlomMetadataCache::Stamp::Stamp() :
+    modifiedMsecs(0),
+    size(0)
+{}
+
+bool QlomMetadataCache::Stamp::isValid() const
+{
+    return !hash.isEmpty();
+}
+
+bool QlomMetadataCache::load(const QString &filepath, QList<QlomTable> &tables,
+    Stamp &stamp)
+{
+    QLOM_TRACE_SCOPE("read metadata cache", "load");
+    QFile sidecar(sidecarPath(filepath));
+    if (!sidecar.open(QIODevice::ReadOnly)) {
+        return false; // Not cached yet.
+    }
+
+    const qint64 size = sidecar.size();
+    const uchar *mapped = sidecar.map(0, size);
+    if (!mapped) {
+        qWarning("The metadata cache %s could not be mapped",
+            qPrintable(sidecar.fileName()));
+        return false;
+    }
+
+    // Read straight from the mapping, without copying the file.
+    const QByteArray data(QByteArray::fromRawData(
+        reinterpret_cast<const char *>(mapped), size));
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != sidecarMagic || version != sidecarVersion) {
+        return false;
+    }
+
+    QString path;
+    QString localeId;
+    qint64 modified = 0;
+    qint64 fileSize = 0;
+    QByteArray hash;
+    stream >> path >> localeId >> modified >> fileSize >> hash;
+
+    const QFileInfo info(filepath);
+    if (path != info.absoluteFilePath()
+        || localeId != QString::fromStdString(getCurrentLocaleId())) {
+        return false;
+    }
+
+    // The document might have been touched or copied without changes.
+    if (modified != info.lastModified().toMSecsSinceEpoch()
+        || fileSize != info.size()) {
+        if (hash != contentHash(filepath)) {
+            return false;
+        }
+    }
+
+    quint32 tableCount = 0;
+    stream >> tableCount;
+    QList<QlomTable> cachedTables;
+    for (quint32 tableIndex = 0;
+         tableIndex < tableCount && QDataStream::Ok == stream.status();
+         ++tableIndex) {
+        QString tableName;
+        QString displayName;
+        qint32 flags = 0;
+        bool relationshipsLoaded = false;
+        quint32 relationshipCount = 0;
+        stream >> tableName >> displayName >> flags >> relationshipsLoaded
+            >> relationshipCount;
+
+        QList<QlomRelationship> relationships;
+        for (quint32 relationshipIndex = 0;
+             relationshipIndex < relationshipCount
+             && QDataStream::Ok == stream.status();
+             ++relationshipIndex) {
+            QString name;
+            QString fromColumn;
+            QString toTable;
+            QString toPrimaryKey;
+            stream >> name >> fromColumn >> toTable >> toPrimaryKey;
+            relationships.push_back(
+                QlomRelationship(name, fromColumn, toTable, toPrimaryKey));
+        }
+
+        // Relationships that were never read stay lazy.
+        const QFlags<QlomTable::QlomTableFlags> tableFlags((QFlag(flags)));
+        if (relationshipsLoaded) {
+            cachedTables.push_back(QlomTable(tableName, displayName,
+                relationships, tableFlags));
+        } else {
+            cachedTables.push_back(
+                QlomTable(tableName, displayName, tableFlags));
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning("The metadata cache %s is corrupt",
+            qPrintable(sidecar.fileName()));
+        return false;
+    }
+
+    tables = cachedTables;
+    /* The stamp of a touched document is that of the file now, so that
+     * save() updates the sidecar and the next load() need not hash. */
+    stamp.modifiedMsecs = info.lastModified().toMSecsSinceEpoch();
+    stamp.size = info.size();
+    stamp.hash = hash;
+    return true;
+}
+
+QlomMetadataCache::Stamp QlomMetadataCache::stamp(const QString &filepath)
+{
+    QLOM_TRACE_SCOPE("hash document", "load");
+    // Read before hashing, so that a change while hashing fails the check.
+    const QFileInfo info(filepath);
+    Stamp result;
+    result.modifiedMsecs = info.lastModified().toMSecsSinceEpoch();
+    result.size = info.size();
+    result.hash = contentHash(filepath);
+    return result;
+}
+
+bool QlomMetadataCache::save(const QString &filepath,
+    const QList<QlomTable> &tables, const Stamp &stamp)
+{
+    QLOM_TRACE_SCOPE("write metadata cache", "load");
+    if (!stamp.isValid()) {
+        return false;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << sidecarMagic << sidecarVersion
+        << QFileInfo(filepath).absoluteFilePath()
+        << QString::fromStdString(getCurrentLocaleId())
+        << stamp.modifiedMsecs
+        << stamp.size
+        << stamp.hash;
+
+    stream << quint32(tables.size());
+    for (QList<QlomTable>::const_iterator iter = tables.begin();
+         iter != tables.end();
+         ++iter) {
+        qint32 flags = QlomTable::INVALID_TABLE;
+        if ((*iter).isHidden())
+            flags |= QlomTable::HIDDEN_TABLE;
+        if ((*iter).isDefault())
+            flags |= QlomTable::DEFAULT_TABLE;
+
+        // Reading the relationships of all tables here would defeat their lazy
+        // loading, so only the ones that were needed are cached.
+        const bool relationshipsLoaded = (*iter).relationshipsLoaded();
+        const QList<QlomRelationship> relationships(relationshipsLoaded
+            ? (*iter).relationships() : QList<QlomRelationship>());
+        stream << (*iter).tableName() << (*iter).displayName() << flags
+            << relationshipsLoaded << quint32(relationships.size());
+        for (QList<QlomRelationship>::const_iterator relationship =
+             relationships.begin();
+             relationship != relationships.end();
+             ++relationship) {
+            stream << (*relationship).name() << (*relationship).fromColumn()
+                << (*relationship).toTable() << (*relationship).toPrimaryKey();
+        }
+    }
+
+    const QString path(sidecarPath(filepath));
+    QFile current(path);
+    if (current.open(QIODevice::ReadOnly)
+        && current.size() == data.size() && current.readAll() == data) {
+        return true; // Nothing was read since the sidecar was written.
+    }
+    current.close();
+
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        qWarning("The metadata cache directory could not be created for %s",
+            qPrintable(path));
+        return false;
+    }
+
+    // Readers never see a partially written sidecar.
+    QSaveFile sidecar(path);
+    if (!sidecar.open(QIODevice::WriteOnly)) {
+        qWarning("The metadata cache %s could not be written",
+            qPrintable(path));
+        return false;
+    }
+
+    return sidecar.write(data) == data.size() && sidecar.commit();
+}
+
+QString QlomMetadataCache::sidecarPath(const QString &filepath)
+{
+    const QByteArray key(QCryptographicHash::hash(
+        QFileInfo(filepath).absoluteFilePath().toUtf8(),
+        QCryptographicHash::Sha1).toHex());
+
+    return QString("%1/metadata/%2.qlomcache")
+        .arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation),
+            QString::fromLatin1(key));
+}
+
+QByteArray QlomMetadataCache::contentHash(const QString &filepath)
+{
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    return hash.result();
+}
@@ -0,0 +1,92 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_METADATA_CACHE_H_
+#define QLOM_METADATA_CACHE_H_
+
+#include "table.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/** A binary sidecar cache for the metadata of a Glom document.
+ *  The table list only needs a small part of a .glom file, but libglom has to
+ *  parse all of it. When a document is closed, save() writes the tables,
+ *  with their titles and flags and the relationships that have been read, to
+ *  a compact binary file in the user's cache directory. On the next start,
+ *  load() maps that file into memory and reads the tables back, as long as
+ *  the document has not changed: a matching modification time and size are
+ *  trusted, otherwise the hash of the document's contents decides. The
+ *  titles are only valid for the locale they were saved with, so the locale
+ *  is part of the key too.
+ *  The document is only hashed once per load: the Stamp that load() or
+ *  stamp() returns is passed to save(), which also leaves the sidecar alone
+ *  if its contents would not change. */
+class QlomMetadataCache
+{
+public:
+    /** Identifies the version of a document that a sidecar describes. */
+    struct Stamp
+    {
+        qint64 modifiedMsecs; /**< the modification time of the document */
+        qint64 size; /**< the size of the document, in bytes */
+        QByteArray hash; /**< the hash of the contents of the document */
+
+        Stamp();
+
+        /** Whether the stamp was read from a document or a sidecar. */
+        bool isValid() const;
+    };
+
+    /** Read the tables of a document from its sidecar.
+     *  @param[in] filepath the absolute filepath of the Glom document
+     *  @param[out] tables the tables, if the sidecar is valid
+     *  @param[out] stamp the stamp of the document, if the sidecar is valid
+     *  @returns true if the sidecar exists and matches the document */
+    static bool load(const QString &filepath, QList<QlomTable> &tables,
+        Stamp &stamp);
+
+    /** Get the stamp of a document, hashing its contents.
+     *  @param[in] filepath the absolute filepath of the Glom document
+     *  @returns the stamp, which is invalid if the file cannot be read */
+    static Stamp stamp(const QString &filepath);
+
+    /** Write the tables of a document to its sidecar, replacing any previous
+     *  sidecar, unless it already has the same contents.
+     *  @param[in] filepath the absolute filepath of the Glom document
+     *  @param[in] tables the tables read from the document
+     *  @param[in] stamp the stamp of the document the tables were read from,
+     *  from load() or stamp()
+     *  @returns true on success, false on failure */
+    static bool save(const QString &filepath, const QList<QlomTable> &tables,
+        const Stamp &stamp);
+
+    /** Get the location of the sidecar of a document.
+     *  @param[in] filepath the absolute filepath of the Glom document
+     *  @returns the filepath of the sidecar */
+    static QString sidecarPath(const QString &filepath);
+
+private:
+    /** Hash the contents of a document.
+     *  @param[in] filepath the absolute filepath of the Glom document
+     *  @returns the hash, or an empty QByteArray if the file cannot be read */
+    static QByteArray contentHash(const QString &filepath);
+};
+
+#endif /* QLOM_METADATA_CACHE_H_ */
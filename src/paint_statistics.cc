@@ -0,0 +1,204 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "paint_statistics.h"
+
+#include <cstring>
+
+#include <QCoreApplication>
+
+/** The number of recent frames that the average frame time covers. */
+static const int averagedFrames = 60;
+
+QlomPaintStatistics & QlomPaintStatistics::instance()
+{
+    static QlomPaintStatistics statistics;
+    return statistics;
+}
+
+QlomPaintStatistics::QlomPaintStatistics() :
+    theEnabledFlag(false)
+{
+    reset();
+}
+
+void QlomPaintStatistics::setEnabled(bool enabled)
+{
+    if (enabled && !theEnabledFlag) {
+        reset();
+    }
+
+    theEnabledFlag = enabled;
+}
+
+bool QlomPaintStatistics::isEnabled() const
+{
+    return theEnabledFlag;
+}
+
+void QlomPaintStatistics::reset()
+{
+    theFrameTimer.invalidate();
+    theFrameTimes.clear();
+    theFrameTimes.reserve(averagedFrames);
+    theNextFrame = 0;
+    theLastFrameNsecs = 0;
+    theMaxFrameNsecs = 0;
+    theCurrentFrameCells = 0;
+    theLastFrameCells = 0;
+    theDelegates.clear();
+    theCaches.clear();
+}
+
+void QlomPaintStatistics::beginFrame()
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    theCurrentFrameCells = 0;
+    theFrameTimer.start();
+}
+
+void QlomPaintStatistics::endFrame()
+{
+    if (!theEnabledFlag || !theFrameTimer.isValid()) {
+        return;
+    }
+
+    theLastFrameNsecs = theFrameTimer.nsecsElapsed();
+    theFrameTimer.invalidate();
+    theMaxFrameNsecs = qMax(theMaxFrameNsecs, theLastFrameNsecs);
+    theLastFrameCells = theCurrentFrameCells;
+
+    if (theFrameTimes.size() < averagedFrames) {
+        theFrameTimes.push_back(theLastFrameNsecs);
+    } else {
+        theFrameTimes[theNextFrame] = theLastFrameNsecs;
+        theNextFrame = (theNextFrame + 1) % averagedFrames;
+    }
+}
+
+void QlomPaintStatistics::recordPaint(const char *delegateClass, qint64 nsecs)
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    Counter &delegate = counter(theDelegates, delegateClass);
+    ++delegate.count;
+    delegate.value += nsecs;
+    ++theCurrentFrameCells;
+}
+
+void QlomPaintStatistics::recordCacheLookup(const char *cache, bool hit)
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    Counter &lookups = counter(theCaches, cache);
+    ++lookups.count;
+    if (hit) {
+        ++lookups.value;
+    }
+}
+
+QStringList QlomPaintStatistics::describe() const
+{
+    QStringList lines;
+
+    qint64 totalNsecs = 0;
+    for (QVector<qint64>::const_iterator iter = theFrameTimes.begin();
+         iter != theFrameTimes.end();
+         ++iter) {
+        totalNsecs += *iter;
+    }
+    const double averageMsecs = (theFrameTimes.isEmpty() ? 0.0
+        : totalNsecs / 1.0e6 / theFrameTimes.size());
+
+    lines.push_back(QCoreApplication::translate("QlomPaintStatistics",
+        "Frame: %1 ms (average %2 ms, max %3 ms)")
+        .arg(theLastFrameNsecs / 1.0e6, 0, 'f', 1)
+        .arg(averageMsecs, 0, 'f', 1)
+        .arg(theMaxFrameNsecs / 1.0e6, 0, 'f', 1));
+    lines.push_back(QCoreApplication::translate("QlomPaintStatistics",
+        "Cells painted: %1").arg(theLastFrameCells));
+
+    for (QVector<Counter>::const_iterator iter = theDelegates.begin();
+         iter != theDelegates.end();
+         ++iter) {
+        const double perCellUsecs = (0 == (*iter).count ? 0.0
+            : (*iter).value / 1.0e3 / (*iter).count);
+        lines.push_back(QCoreApplication::translate("QlomPaintStatistics",
+            "%1: %2 ms, %3 µs per cell")
+            .arg(QString::fromLatin1((*iter).name))
+            .arg((*iter).value / 1.0e6, 0, 'f', 1)
+            .arg(perCellUsecs, 0, 'f', 1));
+    }
+
+    for (QVector<Counter>::const_iterator iter = theCaches.begin();
+         iter != theCaches.end();
+         ++iter) {
+        const double hitRate = (0 == (*iter).count ? 0.0
+            : 100.0 * (*iter).value / (*iter).count);
+        lines.push_back(QCoreApplication::translate("QlomPaintStatistics",
+            "%1 cache: %2% hits of %3 lookups")
+            .arg(QString::fromLatin1((*iter).name))
+            .arg(hitRate, 0, 'f', 1)
+            .arg((*iter).count));
+    }
+
+    return lines;
+}
+
+QlomPaintStatistics::Counter & QlomPaintStatistics::counter(
+    QVector<Counter> &counters, const char *name)
+{
+    // There are only a handful of delegate classes and caches.
+    for (QVector<Counter>::iterator iter = counters.begin();
+         iter != counters.end();
+         ++iter) {
+        if ((*iter).name == name || 0 == std::strcmp((*iter).name, name)) {
+            return *iter;
+        }
+    }
+
+    Counter added;
+    added.name = name;
+    added.count = 0;
+    added.value = 0;
+    counters.push_back(added);
+    return counters.last();
+}
+
+QlomPaintTimer::QlomPaintTimer(const char *delegateClass) :
+    theDelegateClass(delegateClass)
+{
+    if (QlomPaintStatistics::instance().isEnabled()) {
+        theTimer.start();
+    }
+}
+
+QlomPaintTimer::~QlomPaintTimer()
+{
+    if (theTimer.isValid()) {
+        QlomPaintStatistics::instance().recordPaint(theDelegateClass,
+            theTimer.nsecsElapsed());
+    }
+}
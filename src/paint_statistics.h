@@ -0,0 +1,117 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_PAINT_STATISTICS_H_
+#define QLOM_PAINT_STATISTICS_H_
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+
+/** Statistics of the painting of list views, for the overlay of QlomListView.
+ *  The view brackets each frame with beginFrame() and endFrame(). In between,
+ *  the delegates report the time they spent per cell with recordPaint(), and
+ *  the display text caches report their lookups with recordCacheLookup().
+ *  Recording only checks a flag while the statistics are disabled. Painting
+ *  happens on the GUI thread, so the statistics are not thread-safe. */
+class QlomPaintStatistics
+{
+public:
+    /** Get the statistics of the application. */
+    static QlomPaintStatistics & instance();
+
+    /** Enable or disable recording. Enabling resets the statistics.
+     *  @param[in] enabled whether to record */
+    void setEnabled(bool enabled);
+
+    /** Whether recording is enabled. */
+    bool isEnabled() const;
+
+    /** Forget all statistics. */
+    void reset();
+
+    /** Record the start of a frame of the view. */
+    void beginFrame();
+
+    /** Record the end of a frame of the view. */
+    void endFrame();
+
+    /** Record the painting of a cell by a delegate.
+     *  @param[in] delegateClass the class name of the delegate, from its
+     *  QMetaObject
+     *  @param[in] nsecs the time spent painting */
+    void recordPaint(const char *delegateClass, qint64 nsecs);
+
+    /** Record a lookup in a cache.
+     *  @param[in] cache the name of the cache, which must be a string literal
+     *  @param[in] hit whether the lookup found an entry */
+    void recordCacheLookup(const char *cache, bool hit);
+
+    /** Describe the statistics, as lines of text for the overlay.
+     *  @returns the lines */
+    QStringList describe() const;
+
+private:
+    /** Statistics of one delegate class or cache. */
+    struct Counter
+    {
+        const char *name; /**< the delegate class or the cache */
+        qint64 count; /**< cells painted, or lookups */
+        qint64 value; /**< nanoseconds spent, or hits */
+    };
+
+    QlomPaintStatistics();
+
+    /** Find the counter of a name, adding one if needed.
+     *  @param[in] counters the counters to search
+     *  @param[in] name the name
+     *  @returns the counter */
+    static Counter & counter(QVector<Counter> &counters, const char *name);
+
+    bool theEnabledFlag; /**< see isEnabled() */
+    QElapsedTimer theFrameTimer; /**< measures the current frame */
+    QVector<qint64> theFrameTimes; /**< recent frame times, in nanoseconds,
+                                        as a ring buffer */
+    int theNextFrame; /**< the position of the next frame time */
+    qint64 theLastFrameNsecs; /**< the time of the last frame */
+    qint64 theMaxFrameNsecs; /**< the time of the slowest frame */
+    int theCurrentFrameCells; /**< the cells painted in the current frame */
+    int theLastFrameCells; /**< the cells painted in the last frame */
+    QVector<Counter> theDelegates; /**< per delegate class */
+    QVector<Counter> theCaches; /**< per cache */
+};
+
+/** Reports the time a delegate spends painting a cell, for the lifetime of
+ *  the object. */
+class QlomPaintTimer
+{
+public:
+    /** Start timing, if the statistics are enabled.
+     *  @param[in] delegateClass the class name of the delegate, from its
+     *  QMetaObject */
+    explicit QlomPaintTimer(const char *delegateClass);
+
+    /** Report the time. */
+    ~QlomPaintTimer();
+
+private:
+    const char *theDelegateClass; /**< the class name of the delegate */
+    QElapsedTimer theTimer; /**< invalid if the statistics are disabled */
+};
+
+#endif /* QLOM_PAINT_STATISTICS_H_ */
@@ -17,64 +17,121 @@
  */
 
 #include "gui/main_window.h"
+#include "startup_profiler.h"
+#include "trace.h"
 
 #include <iostream>
 
 #include <QApplication>
-#include <QSqlDatabase>
 #include <QDebug>
-#include <QMessageBox>
-
-#include <libglom/init.h>
 
 #include "config.h"
 
+/** The option that enables the startup profiler. */
+static const QString profileStartupOption("--profile-startup");
+
+/** The option that enables tracing. */
+static const QString traceOption("--trace");
+
+/** The file written by --trace, if it is given without a value. */
+static const QString defaultTraceFilepath("trace.json");
+
+/** The option that writes the query statistics on exit. */
+static const QString statsJsonOption("--stats-json");
+
+/** The file written by --stats-json, if it is given without a value. */
+static const QString defaultStatsFilepath("stats.json");
+
+/** The option that sets the memory budget of the rows, in MiB. */
+static const QString memoryBudgetOption("--memory-budget");
+
 void printUsage()
 {
-    std::cout << "Usage: qlom [absolute_file_path]" << std::endl;
+    std::cout << "Usage: qlom [--profile-startup[=trace.json]] "
+                 "[--trace[=trace.json]] [--stats-json[=stats.json]] "
+                 "[--memory-budget=MiB] [absolute_file_path]" << std::endl;
 }
 
-/** Check that the necessary database drivers are installed,
- * and warn the user if they are not.
- * @result Whether the installation is OK to continue.
+/** Check whether an argument is an option, given as --option or
+ * --option=value.
+ * @param[in] argument a command line argument
+ * @param[in] option the option, such as --trace
+ * @param[out] value the value given to the option, if any
+ * @result Whether the argument is the option.
  */
-bool checkInstallation()
+bool isOption(const QString &argument, const QString &option, QString &value)
 {
-    /* Check that the PostgreSQL or the SQLite QSQL driver is installed,
-     * because qlom will not be useful without it. */
-    QStringList drivers = QSqlDatabase::drivers();
-    QStringList::const_iterator end = drivers.end();
-    for(QStringList::const_iterator iter = drivers.begin(); iter != end;
-        ++iter) {
-        const QString name = *iter;
-        if(name == QLatin1String("QPSQL") || name == QLatin1String("QSQLITE"))
-            return true;
+    if(argument == option) {
+        value.clear();
+        return true;
     }
 
-    QMessageBox::critical(0, QObject::tr("Incomplete Qlom Installation"),
-        QObject::tr("Your installation of Glom is not complete, because the "
-                    "QtSQL database driver (QPSQL or SQLite) is not "
-                    "available on your system.\n\nPlease report this bug to "
-                    "your vendor or your system administrator so it can be "
-                    "corrected."));
+    if(argument.startsWith(option + QLatin1Char('='))) {
+        value = argument.mid(option.size() + 1);
+        return true;
+    }
 
     return false;
 }
 
 int main(int argc, char **argv)
 {
+    /* Tracing and the profiler are enabled before anything else, so that the
+     * clock of the trace starts with main(). The profiler records into the
+     * trace, so --trace must be known before it is enabled. */
+    QlomStartupProfiler &profiler = QlomStartupProfiler::instance();
+    QString traceFilepath;
+    QString profileFilepath;
+    bool profileStartup = false;
+    for(int index = 1; index < argc; ++index) {
+        const QString argument(QString::fromLocal8Bit(argv[index]));
+        QString value;
+        if(isOption(argument, profileStartupOption, value)) {
+            profileStartup = true;
+            profileFilepath = value;
+        } else if(isOption(argument, traceOption, value)) {
+            traceFilepath = value.isEmpty() ? defaultTraceFilepath : value;
+        }
+    }
+
+    if(!traceFilepath.isEmpty())
+        QlomTrace::setEnabled(true);
+
+    if(profileStartup)
+        profiler.enable(profileFilepath);
+
+    profiler.begin("QApplication");
     QApplication app(argc, argv);
+    profiler.end("QApplication");
 
     QCoreApplication::setOrganizationName("openismus");
     QCoreApplication::setOrganizationDomain("openismus.com");
     QCoreApplication::setApplicationName(PACKAGE_NAME);
 
-    Glom::libglom_init();
-
-    if(!checkInstallation())
-      return EXIT_FAILURE;
-
-    const QStringList options = app.arguments();
+    /* libglom is initialised by the loader of the first document, on its
+     * worker thread, and the QtSql driver that the document needs is only
+     * checked once it connects, so that the window is shown right away. */
+    QStringList options;
+    QString statsFilepath;
+    qint64 memoryBudget = -1;
+    const QStringList arguments = app.arguments();
+    for(QStringList::const_iterator iter = arguments.begin();
+        iter != arguments.end(); ++iter) {
+        QString value;
+        if(isOption(*iter, statsJsonOption, value))
+            statsFilepath = value.isEmpty() ? defaultStatsFilepath : value;
+        else if(isOption(*iter, memoryBudgetOption, value)) {
+            bool ok = false;
+            memoryBudget = value.toLongLong(&ok);
+            if(!ok || memoryBudget < 0) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if(!isOption(*iter, profileStartupOption, value)
+            && !isOption(*iter, traceOption, value))
+            options.push_back(*iter);
+    }
     QlomMainWindow *mainWindow = 0;
     switch (options.size()) {
     case 1:
@@ -90,6 +147,8 @@ int main(int argc, char **argv)
     }
 
     if (mainWindow && mainWindow->isValid()) {
+        if(memoryBudget >= 0)
+            mainWindow->setMemoryBudget(memoryBudget * 1024 * 1024);
         mainWindow->show();
     }
     else {
@@ -98,8 +157,16 @@ int main(int argc, char **argv)
     }
 
     const int result = app.exec();
+    if(!statsFilepath.isEmpty())
+        mainWindow->saveQueryStatistics(statsFilepath);
     delete mainWindow;
 
+    // In case the application quit before the first table was shown.
+    profiler.finish();
+
+    if(!traceFilepath.isEmpty())
+        QlomTrace::save(traceFilepath);
+
     if(result != EXIT_SUCCESS)
       printUsage();
 
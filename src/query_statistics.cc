@@ -0,0 +1,236 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "query_statistics.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStringList>
+
+/** The number of latency samples kept per query, for the percentiles. */
+static const int latencySamplesPerQuery = 1024;
+
+/** The size assumed for values that are not strings or byte arrays. */
+static const qint64 fixedValueBytes = 8;
+
+/** Get a percentile of sorted samples, by the nearest-rank method.
+ *  @param[in] sorted the samples, in ascending order
+ *  @param[in] percentile the percentile, from 0 to 100
+ *  @returns the sample, or 0 if there are none */
+static qint64 nearestRank(const QVector<qint64> &sorted, int percentile)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    // The smallest rank at which percentile% of the samples are covered.
+    const int rank = (percentile * sorted.size() + 99) / 100;
+    return sorted.at(qBound(1, rank, sorted.size()) - 1);
+}
+
+double QlomQueryStatistics::Summary::rowsPerSecond() const
+{
+    return (seconds > 0.0 ? rows / seconds : 0.0);
+}
+
+double QlomQueryStatistics::Summary::bytesPerSecond() const
+{
+    return (seconds > 0.0 ? bytes / seconds : 0.0);
+}
+
+QlomQueryStatistics::QlomQueryStatistics(QObject *parent) :
+    QObject(parent)
+{}
+
+void QlomQueryStatistics::recordExecution(const QString &query, qint64 nsecs,
+    qint64 rows, qint64 bytes)
+{
+    {
+        QMutexLocker locker(&theMutex);
+        QueryRecord &record = queryRecord(query);
+
+        if (record.latencies.size() < latencySamplesPerQuery) {
+            record.latencies.push_back(nsecs);
+        } else {
+            record.latencies[record.nextLatency] = nsecs;
+            record.nextLatency =
+                (record.nextLatency + 1) % latencySamplesPerQuery;
+        }
+
+        ++record.executions;
+        record.maxNsecs = qMax(record.maxNsecs, nsecs);
+        record.rows += rows;
+        record.bytes += bytes;
+        record.nsecs += nsecs;
+    }
+
+    Q_EMIT updated();
+}
+
+void QlomQueryStatistics::recordFetch(const QString &query, qint64 nsecs,
+    qint64 rows, qint64 bytes)
+{
+    {
+        QMutexLocker locker(&theMutex);
+        QueryRecord &record = queryRecord(query);
+
+        ++record.fetches;
+        record.rows += rows;
+        record.bytes += bytes;
+        record.nsecs += nsecs;
+    }
+
+    Q_EMIT updated();
+}
+
+QList<QlomQueryStatistics::Summary> QlomQueryStatistics::summaries() const
+{
+    QMutexLocker locker(&theMutex);
+
+    QStringList queries = theQueries.keys();
+    queries.sort();
+
+    QList<Summary> result;
+    for (QStringList::const_iterator iter = queries.begin();
+         iter != queries.end();
+         ++iter) {
+        const QueryRecord &record = theQueries[*iter];
+
+        QVector<qint64> sorted(record.latencies);
+        std::sort(sorted.begin(), sorted.end());
+
+        Summary summary;
+        summary.query = *iter;
+        summary.executions = record.executions;
+        summary.fetches = record.fetches;
+        summary.p50Msecs = nearestRank(sorted, 50) / 1.0e6;
+        summary.p95Msecs = nearestRank(sorted, 95) / 1.0e6;
+        summary.p99Msecs = nearestRank(sorted, 99) / 1.0e6;
+        summary.maxMsecs = record.maxNsecs / 1.0e6;
+        summary.rows = record.rows;
+        summary.bytes = record.bytes;
+        summary.seconds = record.nsecs / 1.0e9;
+        result.push_back(summary);
+    }
+
+    return result;
+}
+
+QJsonDocument QlomQueryStatistics::toJson() const
+{
+    const QList<Summary> all = summaries();
+
+    QJsonArray queries;
+    for (QList<Summary>::const_iterator iter = all.begin();
+         iter != all.end();
+         ++iter) {
+        QJsonObject query;
+        query.insert("query", (*iter).query);
+        query.insert("executions", (*iter).executions);
+        query.insert("fetches", (*iter).fetches);
+        query.insert("p50_ms", (*iter).p50Msecs);
+        query.insert("p95_ms", (*iter).p95Msecs);
+        query.insert("p99_ms", (*iter).p99Msecs);
+        query.insert("max_ms", (*iter).maxMsecs);
+        query.insert("rows", static_cast<double>((*iter).rows));
+        query.insert("bytes", static_cast<double>((*iter).bytes));
+        query.insert("rows_per_second", (*iter).rowsPerSecond());
+        query.insert("bytes_per_second", (*iter).bytesPerSecond());
+        queries.append(query);
+    }
+
+    QJsonObject snapshot;
+    snapshot.insert("timestamp",
+        QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    snapshot.insert("queries", queries);
+    return QJsonDocument(snapshot);
+}
+
+bool QlomQueryStatistics::saveJson(const QString &filepath) const
+{
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to open the statistics file %s",
+            qPrintable(filepath));
+        return false;
+    }
+
+    file.write(toJson().toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        qWarning("Failed to write the statistics file %s",
+            qPrintable(filepath));
+        return false;
+    }
+
+    return true;
+}
+
+void QlomQueryStatistics::clear()
+{
+    {
+        QMutexLocker locker(&theMutex);
+        theQueries.clear();
+    }
+
+    Q_EMIT updated();
+}
+
+qint64 QlomQueryStatistics::estimateBytes(const QVariant &value)
+{
+    if (value.isNull()) {
+        return 0;
+    }
+
+    switch (value.type()) {
+    case QVariant::String:
+        // Most text is ASCII, which takes a byte per character on the wire.
+        return value.toString().size();
+        break;
+    case QVariant::ByteArray:
+        return value.toByteArray().size();
+        break;
+    default:
+        return fixedValueBytes;
+        break;
+    }
+}
+
+QlomQueryStatistics::QueryRecord & QlomQueryStatistics::queryRecord(
+    const QString &query)
+{
+    QHash<QString, QueryRecord>::iterator iter = theQueries.find(query);
+    if (iter == theQueries.end()) {
+        QueryRecord record;
+        record.latencies.reserve(latencySamplesPerQuery);
+        record.nextLatency = 0;
+        record.executions = 0;
+        record.fetches = 0;
+        record.maxNsecs = 0;
+        record.rows = 0;
+        record.bytes = 0;
+        record.nsecs = 0;
+        iter = theQueries.insert(query, record);
+    }
+
+    return *iter;
+}
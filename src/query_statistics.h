@@ -0,0 +1,133 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_QUERY_STATISTICS_H_
+#define QLOM_QUERY_STATISTICS_H_
+
+#include <QHash>
+#include <QJsonDocument>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+/** Collects latency and throughput statistics of the queries of a document.
+ *  Queries are identified by a name, such as the list query of a table. For
+ *  each query, the latency of its executions is kept as a histogram of the
+ *  most recent samples, from which percentiles are computed, and the rows and
+ *  bytes that were returned are counted, both by the execution and by the
+ *  later fetches of further rows. The statistics can be recorded from any
+ *  thread, and updated() is emitted on the thread of the collector. */
+class QlomQueryStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    /** The statistics of one query. */
+    struct Summary
+    {
+        QString query; /**< the name of the query */
+        int executions; /**< the number of executions */
+        int fetches; /**< the number of fetches of further rows */
+        double p50Msecs; /**< the median execution latency */
+        double p95Msecs; /**< the 95th percentile execution latency */
+        double p99Msecs; /**< the 99th percentile execution latency */
+        double maxMsecs; /**< the largest execution latency */
+        qint64 rows; /**< the rows returned by executions and fetches */
+        qint64 bytes; /**< the estimated bytes of those rows */
+        double seconds; /**< the time spent executing and fetching */
+
+        /** Get the rows returned per second spent executing and fetching. */
+        double rowsPerSecond() const;
+
+        /** Get the bytes returned per second spent executing and fetching. */
+        double bytesPerSecond() const;
+    };
+
+    /** Create an empty collector.
+     *  @param[in] parent a parent object */
+    explicit QlomQueryStatistics(QObject *parent = 0);
+
+    /** Record an execution of a query, including the first rows it fetched.
+     *  @param[in] query the name of the query
+     *  @param[in] nsecs the time the execution took
+     *  @param[in] rows the number of rows that were fetched
+     *  @param[in] bytes the estimated size of those rows */
+    void recordExecution(const QString &query, qint64 nsecs, qint64 rows,
+        qint64 bytes);
+
+    /** Record a fetch of further rows of a query.
+     *  @param[in] query the name of the query
+     *  @param[in] nsecs the time the fetch took
+     *  @param[in] rows the number of rows that were fetched
+     *  @param[in] bytes the estimated size of those rows */
+    void recordFetch(const QString &query, qint64 nsecs, qint64 rows,
+        qint64 bytes);
+
+    /** Get the statistics of all queries, ordered by name. */
+    QList<Summary> summaries() const;
+
+    /** Get a snapshot of the statistics, for comparisons between runs.
+     *  @returns the statistics as a JSON document */
+    QJsonDocument toJson() const;
+
+    /** Write a snapshot of the statistics to a file.
+     *  @param[in] filepath the file to write
+     *  @returns true on success, false on failure */
+    bool saveJson(const QString &filepath) const;
+
+    /** Forget all statistics. */
+    void clear();
+
+    /** Estimate the size of a value, as returned by the database.
+     *  @param[in] value a value from a query
+     *  @returns the estimated size in bytes */
+    static qint64 estimateBytes(const QVariant &value);
+
+Q_SIGNALS:
+    /** Emitted when statistics have been recorded or cleared. */
+    void updated();
+
+private:
+    /** The statistics of one query, as recorded. */
+    struct QueryRecord
+    {
+        QVector<qint64> latencies; /**< the most recent execution latencies,
+                                        in nanoseconds, as a ring buffer */
+        int nextLatency; /**< the position of the next latency */
+        int executions; /**< see Summary */
+        int fetches; /**< see Summary */
+        qint64 maxNsecs; /**< the largest execution latency */
+        qint64 rows; /**< see Summary */
+        qint64 bytes; /**< see Summary */
+        qint64 nsecs; /**< the time spent executing and fetching */
+    };
+
+    /** Get the record of a query, creating it if needed. theMutex must be
+     *  locked.
+     *  @param[in] query the name of the query
+     *  @returns the record */
+    QueryRecord & queryRecord(const QString &query);
+
+    mutable QMutex theMutex; /**< protects theQueries */
+    QHash<QString, QueryRecord> theQueries; /**< the queries, by name */
+};
+
+#endif /* QLOM_QUERY_STATISTICS_H_ */
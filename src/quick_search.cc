@@ -0,0 +1,380 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quick_search.h"
+#include "list_layout_model.h"
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QMetaType>
+
+/** The rows scanned between checks for a cancellation. */
+static const int rowsPerCheck = 4096;
+
+/** The minimum time between two batches of matches, in milliseconds, so
+ *  that the view is not flooded with small batches. */
+static const int batchInterval = 50;
+
+QlomSearchWorker::QlomSearchWorker(const QVector<QlomFilterColumn> &columns,
+    const QVector<int> &cacheRows, int rowCount,
+    const QVector<int> &candidates, const QString &query,
+    const std::shared_ptr<const QlomTrigramIndex> &index, QObject *parent) :
+    QThread(parent),
+    theColumns(columns),
+    theCacheRows(cacheRows),
+    theRowCount(rowCount),
+    theCandidates(candidates),
+    theQuery(query),
+    theIndex(index),
+    theCancelledFlag(0)
+{}
+
+QlomSearchWorker::~QlomSearchWorker()
+{}
+
+void QlomSearchWorker::cancel()
+{
+    theCancelledFlag.storeRelease(1);
+}
+
+bool QlomSearchWorker::isCancelled() const
+{
+    return (0 != theCancelledFlag.loadAcquire());
+}
+
+QString QlomSearchWorker::query() const
+{
+    return theQuery;
+}
+
+QVector<int> QlomSearchWorker::matches() const
+{
+    return theMatches;
+}
+
+void QlomSearchWorker::run()
+{
+    QLOM_TRACE_SCOPE("quick search", "search");
+
+    // Whether each text contains the query: -1 until it is first compared.
+    QVector<QVector<qint8> > matchedTexts;
+    for (QVector<QlomFilterColumn>::const_iterator iter = theColumns.begin();
+         iter != theColumns.end();
+         ++iter) {
+        QVector<qint8> matched((*iter).texts().size(), -1);
+        // Null values never match.
+        if (!matched.isEmpty()) {
+            matched[0] = 0;
+        }
+        matchedTexts.push_back(matched);
+    }
+
+    // Only the texts with all trigrams of the query can contain it.
+    if (theIndex && QlomTrigramIndex::canLookUp(theQuery)) {
+        const QVector<QVector<qint32> > candidates =
+            theIndex->lookup(theQuery);
+        for (int column = 0; column < theColumns.size(); ++column) {
+            const QVector<QString> &texts = theColumns.at(column).texts();
+            QVector<qint8> &matched = matchedTexts[column];
+            matched.fill(0);
+            for (QVector<qint32>::const_iterator iter =
+                     candidates.at(column).begin();
+                 iter != candidates.at(column).end();
+                 ++iter) {
+                if (texts.at(*iter).contains(theQuery, Qt::CaseInsensitive)) {
+                    matched[*iter] = 1;
+                }
+            }
+        }
+    }
+
+    const bool allRows = theCandidates.isEmpty();
+    const int count = (allRows ? theRowCount : theCandidates.size());
+    QVector<int> batch;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    for (int index = 0; index < count; ++index) {
+        if (0 == index % rowsPerCheck) {
+            if (isCancelled()) {
+                return;
+            }
+
+            if (!batch.isEmpty() && batchTimer.elapsed() >= batchInterval) {
+                Q_EMIT matchesFound(batch);
+                batch.clear();
+                batchTimer.restart();
+            }
+        }
+
+        const int row = (allRows ? index : theCandidates.at(index));
+        const int cacheRow = (theCacheRows.isEmpty() ? row
+            : theCacheRows.at(row));
+        for (int column = 0; column < theColumns.size(); ++column) {
+            const QlomFilterColumn &texts = theColumns.at(column);
+            const qint32 code = texts.codes().at(cacheRow);
+            qint8 &matched = matchedTexts[column][code];
+            if (-1 == matched) {
+                matched = (texts.texts().at(code).contains(theQuery,
+                    Qt::CaseInsensitive) ? 1 : 0);
+            }
+
+            if (matched) {
+                batch.push_back(row);
+                theMatches.push_back(row);
+                break;
+            }
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        Q_EMIT matchesFound(batch);
+    }
+}
+
+QlomQuickSearch::QlomQuickSearch(QObject *parent) :
+    QObject(parent),
+    theModel(0),
+    theWorker(0),
+    theRowCount(0),
+    theColumnsFlag(false),
+    theAllColumnsFlag(true),
+    theMatchesFlag(false),
+    theBuilder(0)
+{
+    // The matches are queued from the worker threads.
+    qRegisterMetaType<QVector<int> >("QVector<int>");
+}
+
+QlomQuickSearch::~QlomQuickSearch()
+{
+    // Workers of earlier queries might still be running, too.
+    const QList<QlomSearchWorker *> workers =
+        findChildren<QlomSearchWorker *>();
+    for (QList<QlomSearchWorker *>::const_iterator iter = workers.begin();
+         iter != workers.end();
+         ++iter) {
+        (*iter)->disconnect(this);
+        (*iter)->cancel();
+        (*iter)->wait();
+    }
+
+    const QList<QlomTrigramIndexBuilder *> builders =
+        findChildren<QlomTrigramIndexBuilder *>();
+    for (QList<QlomTrigramIndexBuilder *>::const_iterator iter =
+             builders.begin();
+         iter != builders.end();
+         ++iter) {
+        (*iter)->disconnect(this);
+        (*iter)->cancel();
+        (*iter)->wait();
+    }
+}
+
+void QlomQuickSearch::setModel(QlomListLayoutModel *model)
+{
+    if (theModel) {
+        theModel->disconnect(this);
+    }
+
+    cancelWorker();
+    cancelBuilder();
+    theModel = model;
+    theColumns.clear();
+    theCacheRows.clear();
+    theColumnsFlag = false;
+    theMatches.clear();
+    theMatchesFlag = false;
+    theIndex.reset();
+
+    if (theModel) {
+        connect(theModel, SIGNAL(modelReset()),
+            this, SLOT(onModelReset()));
+        connect(theModel, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            this, SLOT(onModelRowsInserted()));
+        connect(theModel, SIGNAL(destroyed()),
+            this, SLOT(onModelDestroyed()));
+    }
+
+    search(theQuery);
+}
+
+QString QlomQuickSearch::query() const
+{
+    return theQuery;
+}
+
+void QlomQuickSearch::search(const QString &query)
+{
+    cancelWorker();
+    theQuery = query;
+    Q_EMIT searchStarted();
+
+    if (theQuery.isEmpty() || !theModel) {
+        Q_EMIT searchFinished(0, true);
+        return;
+    }
+
+    updateColumns();
+
+    // A longer query can only match the rows of a query that it contains.
+    const bool refining = (theMatchesFlag
+        && theQuery.contains(theMatchedQuery, Qt::CaseInsensitive));
+    if (refining && theMatches.isEmpty()) {
+        Q_EMIT searchFinished(0, theAllColumnsFlag);
+        return;
+    }
+
+    theWorker = new QlomSearchWorker(theColumns, theCacheRows, theRowCount,
+        (refining ? theMatches : QVector<int>()), theQuery, theIndex, this);
+    connect(theWorker, SIGNAL(matchesFound(QVector<int>)),
+        this, SLOT(onWorkerMatchesFound(QVector<int>)));
+    connect(theWorker, SIGNAL(finished()),
+        this, SLOT(onWorkerFinished()));
+    // The worker deletes itself, even if it was cancelled.
+    connect(theWorker, SIGNAL(finished()),
+        theWorker, SLOT(deleteLater()));
+    theWorker->start();
+}
+
+void QlomQuickSearch::buildIndex()
+{
+    cancelBuilder();
+    if (!theModel) {
+        return;
+    }
+
+    updateColumns();
+    theBuilder = new QlomTrigramIndexBuilder(theColumns, this);
+    connect(theBuilder, SIGNAL(progressChanged(int)),
+        this, SIGNAL(indexProgressChanged(int)));
+    connect(theBuilder, SIGNAL(finished()),
+        this, SLOT(onBuilderFinished()));
+    // The builder deletes itself, even if it was cancelled.
+    connect(theBuilder, SIGNAL(finished()),
+        theBuilder, SLOT(deleteLater()));
+    theBuilder->start(QThread::LowPriority);
+}
+
+void QlomQuickSearch::onWorkerMatchesFound(const QVector<int> &rows)
+{
+    if (sender() != theWorker) {
+        return; // A cancelled worker, whose signals arrived late.
+    }
+
+    Q_EMIT matchesFound(rows);
+}
+
+void QlomQuickSearch::onWorkerFinished()
+{
+    QlomSearchWorker *worker = qobject_cast<QlomSearchWorker *>(sender());
+    if (!worker || worker != theWorker) {
+        return;
+    }
+
+    theWorker = 0;
+    if (worker->isCancelled()) {
+        return;
+    }
+
+    theMatchedQuery = worker->query();
+    theMatches = worker->matches();
+    theMatchesFlag = true;
+    Q_EMIT searchFinished(theMatches.size(), theAllColumnsFlag);
+}
+
+void QlomQuickSearch::onBuilderFinished()
+{
+    QlomTrigramIndexBuilder *builder =
+        qobject_cast<QlomTrigramIndexBuilder *>(sender());
+    if (!builder || builder != theBuilder) {
+        return;
+    }
+
+    theBuilder = 0;
+    const std::shared_ptr<const QlomTrigramIndex> index =
+        builder->takeIndex();
+    if (!index || !index->isBuiltFrom(theColumns)) {
+        return;
+    }
+
+    theIndex = index;
+    Q_EMIT indexBuilt(theIndex->bytes());
+}
+
+void QlomQuickSearch::onModelReset()
+{
+    // Sorting and filtering move the rows, so the matches are found again.
+    theColumnsFlag = false;
+    theMatchesFlag = false;
+    search(theQuery);
+}
+
+void QlomQuickSearch::onModelRowsInserted()
+{
+    theColumnsFlag = false;
+    theMatchesFlag = false;
+}
+
+void QlomQuickSearch::onModelDestroyed()
+{
+    theModel = 0;
+    cancelWorker();
+    cancelBuilder();
+    theIndex.reset();
+    theColumns.clear();
+    theCacheRows.clear();
+    theColumnsFlag = false;
+    theMatches.clear();
+    theMatchesFlag = false;
+}
+
+void QlomQuickSearch::cancelWorker()
+{
+    if (theWorker) {
+        theWorker->disconnect(this);
+        theWorker->cancel();
+        theWorker = 0;
+    }
+}
+
+void QlomQuickSearch::cancelBuilder()
+{
+    if (theBuilder) {
+        theBuilder->disconnect(this);
+        theBuilder->cancel();
+        theBuilder = 0;
+    }
+}
+
+void QlomQuickSearch::updateColumns()
+{
+    if (theColumnsFlag) {
+        return;
+    }
+
+    theAllColumnsFlag = theModel->searchColumns(theColumns);
+    theCacheRows = theModel->cacheRows();
+    theRowCount = theModel->rowCount();
+    theColumnsFlag = true;
+
+    // More rows were fetched since the index was built.
+    if (theIndex && !theIndex->isBuiltFrom(theColumns)) {
+        theIndex.reset();
+    }
+}
@@ -0,0 +1,213 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_QUICK_SEARCH_H_
+#define QLOM_QUICK_SEARCH_H_
+
+#include "row_filter.h"
+#include "trigram_index.h"
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+class QlomListLayoutModel;
+
+/** Scans the text columns of a list layout for a quick search, on a worker
+ *  thread. The columns are a copy of QlomListLayoutModel::searchColumns(),
+ *  whose data is implicitly shared, and detached when the model appends
+ *  rows, so that the scan does not touch the model. Each distinct text is
+ *  compared with the query once, when a row first shows it. With a
+ *  QlomTrigramIndex, only the texts that it finds are compared, up front.
+ *  The matches are reported in batches while the scan runs. */
+class QlomSearchWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    /** Create a worker.
+     *  @param[in] columns the text columns to scan
+     *  @param[in] cacheRows the row of the columns of each model row, or
+     *  empty if they are the same
+     *  @param[in] rowCount the number of model rows
+     *  @param[in] candidates the model rows to scan, in ascending order, or
+     *  empty to scan all rows
+     *  @param[in] query the text to find, which is compared case-insensitively
+     *  @param[in] index an index built from the columns, or 0
+     *  @param[in] parent a parent object */
+    QlomSearchWorker(const QVector<QlomFilterColumn> &columns,
+        const QVector<int> &cacheRows, int rowCount,
+        const QVector<int> &candidates, const QString &query,
+        const std::shared_ptr<const QlomTrigramIndex> &index,
+        QObject *parent = 0);
+    virtual ~QlomSearchWorker();
+
+    /** Ask the worker to stop. This method can be called from any thread. */
+    void cancel();
+
+    /** Whether cancel() has been called. */
+    bool isCancelled() const;
+
+    /** Get the query given to the constructor. */
+    QString query() const;
+
+    /** Get the model rows that match, in ascending order. Only complete once
+     *  finished() has been emitted, and unless the worker was cancelled. */
+    QVector<int> matches() const;
+
+Q_SIGNALS:
+    /** Emitted from the worker thread with the rows found since the last
+     *  emission.
+     *  @param[in] rows the model rows, in ascending order */
+    void matchesFound(const QVector<int> &rows);
+
+protected:
+    /** Reimplemented from QThread to scan the rows. */
+    virtual void run();
+
+private:
+    const QVector<QlomFilterColumn> theColumns; /**< the columns to scan */
+    const QVector<int> theCacheRows; /**< see the constructor */
+    const int theRowCount; /**< the number of model rows */
+    const QVector<int> theCandidates; /**< the rows to scan, or empty */
+    const QString theQuery; /**< see query() */
+    /** The index of theColumns, or 0. */
+    const std::shared_ptr<const QlomTrigramIndex> theIndex;
+    QVector<int> theMatches; /**< see matches() */
+    QAtomicInt theCancelledFlag; /**< set by cancel(), from any thread */
+};
+
+/** A find-as-you-type search over the text columns of a list layout model.
+ *  Each search() cancels the scan of the previous query. If the new query
+ *  contains the last query whose scan completed, only the rows that matched
+ *  it are scanned again, since no other row can match. Otherwise, all rows
+ *  are scanned. The scans run on a QlomSearchWorker, and the matches are
+ *  reported with matchesFound() as they are found.
+ *  The rows that the model fetches while a query is shown are searched by
+ *  the next query. Fields of related tables are not searched.
+ *  buildIndex() builds a QlomTrigramIndex of the texts in the background,
+ *  which the searches use as long as no more rows are fetched. */
+class QlomQuickSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    /** Create a quick search without a model.
+     *  @param[in] parent a parent object */
+    explicit QlomQuickSearch(QObject *parent = 0);
+
+    /** Cancels and waits for running workers, because a QThread must not be
+     *  destroyed while it runs. */
+    virtual ~QlomQuickSearch();
+
+    /** Set the model to search, which cancels the current search.
+     *  @param[in] model the model, or 0 */
+    void setModel(QlomListLayoutModel *model);
+
+    /** Get the current query. */
+    QString query() const;
+
+    /** Build a trigram index of the text columns of the rows fetched so far,
+     *  on a worker thread, replacing any index that is being built. */
+    void buildIndex();
+
+Q_SIGNALS:
+    /** Emitted when a search starts, so that the matches of the previous one
+     *  can be forgotten. */
+    void searchStarted();
+
+    /** Emitted with the matches of the current search, as they are found.
+     *  @param[in] rows the model rows, in ascending order */
+    void matchesFound(const QVector<int> &rows);
+
+    /** Emitted when the current search has scanned all its rows.
+     *  @param[in] matchCount the number of rows that match
+     *  @param[in] allColumns whether all text columns were searched, rather
+     *  than only those whose rows are in memory, see
+     *  QlomListLayoutModel::searchColumns() */
+    void searchFinished(int matchCount, bool allColumns);
+
+    /** Emitted while an index is built.
+     *  @param[in] percent the share of the texts indexed so far */
+    void indexProgressChanged(int percent);
+
+    /** Emitted when an index has been built and is used by the searches.
+     *  @param[in] bytes the memory used by the index */
+    void indexBuilt(qint64 bytes);
+
+public Q_SLOTS:
+    /** Slot to search for a text, cancelling the previous search.
+     *  @param[in] query the text, or an empty string to stop searching */
+    void search(const QString &query);
+
+private Q_SLOTS:
+    /** Slot to forward the matches of the current worker. */
+    void onWorkerMatchesFound(const QVector<int> &rows);
+
+    /** Slot to keep the matches of a worker that completed, for refining. */
+    void onWorkerFinished();
+
+    /** Slot to use the index of a builder that completed. */
+    void onBuilderFinished();
+
+    /** Slot to search the reset model again. */
+    void onModelReset();
+
+    /** Slot to notice that the model has new rows. */
+    void onModelRowsInserted();
+
+    /** Slot to forget a model that is being destroyed. */
+    void onModelDestroyed();
+
+private:
+    /** Cancel the current worker, if any. It deletes itself once it has
+     *  stopped. */
+    void cancelWorker();
+
+    /** Cancel the current index builder, if any. It deletes itself once it
+     *  has stopped. */
+    void cancelBuilder();
+
+    /** Take the text columns of theModel again, unless theColumnsFlag is
+     *  set, and drop theIndex if it was built from other columns. Columns
+     *  whose rows are not in memory are left out, and theAllColumnsFlag is
+     *  cleared. */
+    void updateColumns();
+
+    QlomListLayoutModel *theModel; /**< see setModel() */
+    QlomSearchWorker *theWorker; /**< the scan of the current query, or 0 */
+    QString theQuery; /**< see query() */
+    QVector<QlomFilterColumn> theColumns; /**< the text columns of theModel */
+    QVector<int> theCacheRows; /**< see QlomListLayoutModel::cacheRows() */
+    int theRowCount; /**< the rows of theModel when theColumns were taken */
+    bool theColumnsFlag; /**< whether theColumns are up to date */
+    bool theAllColumnsFlag; /**< whether theColumns are all text columns */
+    QString theMatchedQuery; /**< the last query whose scan completed */
+    QVector<int> theMatches; /**< the matches of theMatchedQuery */
+    bool theMatchesFlag; /**< whether theMatches can be refined */
+    QlomTrigramIndexBuilder *theBuilder; /**< builds the next index, or 0 */
+    std::shared_ptr<const QlomTrigramIndex> theIndex; /**< the index of
+                                                           theColumns, or
+                                                           0 */
+};
+
+#endif /* QLOM_QUICK_SEARCH_H_ */
@@ -18,14 +18,21 @@
 
 #include "relationship.h"
 
-QlomRelationship::QlomRelationship(const QString &fromColumn,
-    const QString &toTable, const QString &toPrimaryKey) :
+QlomRelationship::QlomRelationship(const QString &name,
+    const QString &fromColumn, const QString &toTable,
+    const QString &toPrimaryKey) :
+    theName(name),
     theFromColumn(fromColumn),
     theToTable(toTable),
     theToPrimaryKey(toPrimaryKey)
 {
 }
 
+QString QlomRelationship::name() const
+{
+    return theName;
+}
+
 QString QlomRelationship::fromColumn() const
 {
     return theFromColumn;
@@ -22,21 +22,26 @@
 #include <QString>
 
 /** A relationship from one column in a database table to another.
- *  Designed for use in a QlomTable, QlomRelationship has three construct-time
- *  only properties: the source column, the destination table and the
- *  destination primary key. The properties cannot be changed once a
- *  relationship has been constructed, but can be accessed with the
+ *  Designed for use in a QlomTable, QlomRelationship has four construct-time
+ *  only properties: the name, the source column, the destination table and
+ *  the destination primary key. The properties cannot be changed once a
+ *  relationship has been constructed, but can be accessed with the name(),
  *  fromColumn(), toTable() and toPrimaryKey() methods. The source table is
  *  implied by including the relationship in a QlomTable. */
 class QlomRelationship
 {
 public:
     /** Create a relationship to a column in another table.
+     *  @param[in] name the name of the relationship in the Glom document
      *  @param[in] fromColumn source column for the relationship
      *  @param[in] toTable destination table for the reationship
      *  @param[in] toPrimaryKey destination primary key of the relationship */
-    QlomRelationship(const QString &fromColumn, const QString &toTable,
-        const QString &toPrimaryKey);
+    QlomRelationship(const QString &name, const QString &fromColumn,
+        const QString &toTable, const QString &toPrimaryKey);
+
+    /** Get the name of the relationship, as used by layout items.
+     *  @returns the relationship name. */
+    QString name() const;
 
     /** Get the source column of the relationship.
      *  @returns the source column. */
@@ -51,6 +56,7 @@ public:
     QString toPrimaryKey() const;
 
 private:
+    QString theName; /**< relationship name */
     QString theFromColumn; /**< source column */
     QString theToTable; /**< destination table */
     QString theToPrimaryKey; /**< primary key in destination table */
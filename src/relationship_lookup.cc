@@ -0,0 +1,219 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "relationship_lookup.h"
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+
+/** The maximum number of keys bound in one IN query. SQLite refuses
+ *  statements with more than 999 host parameters by default. */
+static const int maxKeysPerQuery = 500;
+
+QlomRelationshipLookup::QlomRelationshipLookup(
+    const QList<QlomRelationship> &relationships, QSqlDatabase db) :
+    theRelationships(relationships),
+    theDatabase(db.isValid() ? db : QSqlDatabase::database()),
+    theQueryStatistics(0)
+{
+    for (int index = 0; index < theRelationships.size(); ++index) {
+        theColumns.push_back(QStringList());
+    }
+}
+
+int QlomRelationshipLookup::indexOf(const QString &relationshipName) const
+{
+    for (int index = 0; index < theRelationships.size(); ++index) {
+        if (theRelationships.at(index).name() == relationshipName)
+            return index;
+    }
+
+    return -1;
+}
+
+void QlomRelationshipLookup::addColumn(int relationshipIndex,
+    const QString &column)
+{
+    Q_ASSERT(relationshipIndex >= 0
+        && relationshipIndex < theRelationships.size());
+
+    if (!theColumns[relationshipIndex].contains(column)) {
+        theColumns[relationshipIndex].push_back(column);
+
+        // Records fetched so far lack the new column.
+        clear();
+    }
+}
+
+bool QlomRelationshipLookup::prefetch(int relationshipIndex,
+    const QList<QVariant> &keys)
+{
+    if (relationshipIndex < 0 || relationshipIndex >= theRelationships.size())
+        return false;
+
+    // Only query each key once, and only if it is not cached yet.
+    QSet<QString> seen;
+    QList<QVariant> pending;
+    for (QList<QVariant>::const_iterator iter = keys.begin();
+         iter != keys.end();
+         ++iter) {
+        if ((*iter).isNull())
+            continue;
+
+        const QString key = (*iter).toString();
+        if (seen.contains(key)
+            || theRecords.contains(LookupKey(relationshipIndex, key)))
+            continue;
+
+        seen.insert(key);
+        pending.push_back(*iter);
+    }
+
+    bool success = true;
+    for (int first = 0; first < pending.size(); first += maxKeysPerQuery) {
+        if (!prefetchChunk(relationshipIndex,
+            pending.mid(first, maxKeysPerQuery)))
+            success = false;
+    }
+
+    return success;
+}
+
+bool QlomRelationshipLookup::prefetchChunk(int relationshipIndex,
+    const QList<QVariant> &keys)
+{
+    QLOM_TRACE_SCOPE("prefetch related records", "query");
+    const QlomRelationship &relationship =
+        theRelationships.at(relationshipIndex);
+    const QSqlDriver *driver = theDatabase.driver();
+
+    /* The key is always the first column, so that the results can be matched
+     * to the keys without knowing how the driver names the columns. */
+    const QString toField = driver->escapeIdentifier(
+        relationship.toPrimaryKey(), QSqlDriver::FieldName);
+    QStringList projection(toField);
+    const QStringList &columns = theColumns.at(relationshipIndex);
+    for (QStringList::const_iterator iter = columns.begin();
+         iter != columns.end();
+         ++iter) {
+        projection.push_back(
+            driver->escapeIdentifier(*iter, QSqlDriver::FieldName));
+    }
+
+    QStringList placeholders;
+    for (int index = 0; index < keys.size(); ++index) {
+        placeholders.push_back(QString("?"));
+    }
+
+    // The multi-arg overload, so that identifiers cannot inject %-markers.
+    const QString strQuery = QString("SELECT %1 FROM %2 WHERE %3 IN (%4)")
+        .arg(projection.join(", "),
+            driver->escapeIdentifier(relationship.toTable(),
+                QSqlDriver::TableName),
+            toField, placeholders.join(", "));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query(theDatabase);
+    query.setForwardOnly(true);
+    bool success = query.prepare(strQuery);
+    if (success) {
+        for (QList<QVariant>::const_iterator iter = keys.begin();
+             iter != keys.end();
+             ++iter) {
+            query.addBindValue(*iter);
+        }
+
+        success = query.exec();
+    }
+
+    if (success) {
+        qint64 rows = 0;
+        qint64 bytes = 0;
+        while (query.next()) {
+            const QSqlRecord record = query.record();
+            theRecords.insert(
+                LookupKey(relationshipIndex, record.value(0).toString()),
+                record);
+
+            if (theQueryStatistics) {
+                ++rows;
+                for (int column = 0; column < record.count(); ++column) {
+                    bytes += QlomQueryStatistics::estimateBytes(
+                        record.value(column));
+                }
+            }
+        }
+
+        if (theQueryStatistics) {
+            theQueryStatistics->recordExecution(
+                QString("related %1").arg(relationship.name()),
+                timer.nsecsElapsed(), rows, bytes);
+        }
+    } else {
+        qWarning("Related records of relationship \"%s\" could not be "
+            "fetched\nError details: %s",
+            qPrintable(relationship.name()),
+            qPrintable(query.lastError().text()));
+    }
+
+    /* Remember the keys without a related record (or whose query failed),
+     * so that they do not cause a query for every repaint. */
+    for (QList<QVariant>::const_iterator iter = keys.begin();
+         iter != keys.end();
+         ++iter) {
+        const LookupKey lookupKey(relationshipIndex, (*iter).toString());
+        if (!theRecords.contains(lookupKey))
+            theRecords.insert(lookupKey, QSqlRecord());
+    }
+
+    return success;
+}
+
+bool QlomRelationshipLookup::contains(int relationshipIndex,
+    const QVariant &key) const
+{
+    return theRecords.contains(LookupKey(relationshipIndex, key.toString()));
+}
+
+QVariant QlomRelationshipLookup::value(int relationshipIndex,
+    const QVariant &key, const QString &column) const
+{
+    const LookupCache::const_iterator iter =
+        theRecords.constFind(LookupKey(relationshipIndex, key.toString()));
+    if (iter == theRecords.constEnd())
+        return QVariant();
+
+    return (*iter).value(column);
+}
+
+void QlomRelationshipLookup::clear()
+{
+    theRecords.clear();
+}
+
+void QlomRelationshipLookup::setQueryStatistics(
+    QlomQueryStatistics *statistics)
+{
+    theQueryStatistics = statistics;
+}
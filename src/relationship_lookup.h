@@ -0,0 +1,111 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_RELATIONSHIP_LOOKUP_H_
+#define QLOM_RELATIONSHIP_LOOKUP_H_
+
+#include "relationship.h"
+#include "query_statistics.h"
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QSqlRecord>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+/** Batched lookups of records in related tables.
+ *  Instead of querying the destination table of a relationship once per row,
+ *  the caller collects the from-field keys of a page of rows and passes them
+ *  to prefetch(), which resolves them with one "WHERE to_field IN (...)"
+ *  query. The related records are cached, keyed by the relationship and the
+ *  key, so that value() is a hash lookup afterwards. Keys without a related
+ *  record are cached as well, so that they are not queried again. */
+class QlomRelationshipLookup
+{
+public:
+    /** Create a lookup for the relationships of a table.
+     *  @param[in] relationships the relationships of the source table
+     *  @param[in] db a database connection, or the default connection */
+    explicit QlomRelationshipLookup(
+        const QList<QlomRelationship> &relationships =
+            QList<QlomRelationship>(),
+        QSqlDatabase db = QSqlDatabase());
+
+    /** Find a relationship by its name.
+     *  @param[in] relationshipName the name of the relationship
+     *  @returns the index of the relationship, or -1 if there is none */
+    int indexOf(const QString &relationshipName) const;
+
+    /** Request a column of the destination table of a relationship. Only the
+     *  requested columns are queried by prefetch().
+     *  @param[in] relationshipIndex the index of the relationship
+     *  @param[in] column the name of the column in the destination table */
+    void addColumn(int relationshipIndex, const QString &column);
+
+    /** Resolve a batch of keys. Keys that are already cached, and null keys,
+     *  are skipped, so that the remaining keys cost one query (or one query
+     *  per chunk of keys, for very large batches).
+     *  @param[in] relationshipIndex the index of the relationship
+     *  @param[in] keys values of the from-field of the relationship
+     *  @returns false if a query failed */
+    bool prefetch(int relationshipIndex, const QList<QVariant> &keys);
+
+    /** Check whether a key has already been resolved.
+     *  @param[in] relationshipIndex the index of the relationship
+     *  @param[in] key a value of the from-field of the relationship
+     *  @returns true if value() can answer without a query */
+    bool contains(int relationshipIndex, const QVariant &key) const;
+
+    /** Get a value from a related record. The key must have been resolved
+     *  with prefetch() first.
+     *  @param[in] relationshipIndex the index of the relationship
+     *  @param[in] key a value of the from-field of the relationship
+     *  @param[in] column a column requested with addColumn()
+     *  @returns the value, or an invalid QVariant if there is no related
+     *  record */
+    QVariant value(int relationshipIndex, const QVariant &key,
+        const QString &column) const;
+
+    /** Drop all cached records, for instance after the data changed. */
+    void clear();
+
+    /** Set a collector for the latency and throughput of the lookups.
+     *  @param[in] statistics the collector, or 0 for none */
+    void setQueryStatistics(QlomQueryStatistics *statistics);
+
+private:
+    typedef QPair<int, QString> LookupKey; /**< (relationship, key) */
+    typedef QHash<LookupKey, QSqlRecord> LookupCache;
+
+    /** Run one IN query for a chunk of keys, and cache the results.
+     *  @returns false if the query failed */
+    bool prefetchChunk(int relationshipIndex, const QList<QVariant> &keys);
+
+    QList<QlomRelationship> theRelationships; /**< the relationships of the
+                                                   source table */
+    QList<QStringList> theColumns; /**< requested columns, per relationship */
+    LookupCache theRecords; /**< related records, keyed by (relationship,
+                                 key). Empty for unmatched keys. */
+    QSqlDatabase theDatabase; /**< the connection used for the lookups */
+    QlomQueryStatistics *theQueryStatistics; /**< see setQueryStatistics() */
+};
+
+#endif /* QLOM_RELATIONSHIP_LOOKUP_H_ */
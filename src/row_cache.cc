@@ -0,0 +1,518 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "row_cache.h"
+#include "trace.h"
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QDate>
+#include <QPair>
+#include <QSqlRecord>
+#include <QTime>
+
+/** The clock of QlomRowCache::lastUsed(), which ticks on every use of a
+ *  page. Caches are only used on the GUI thread. */
+static quint64 usageClock = 0;
+
+/** Parse a run of decimal digits.
+ *  @param[in] chars the first digit
+ *  @param[in] count the number of digits
+ *  @returns the number, or -1 if a character is not a digit */
+static int parseDigits(const QChar *chars, int count)
+{
+    int number = 0;
+    for (int index = 0; index < count; ++index) {
+        const int digit = chars[index].unicode() - '0';
+        if (digit < 0 || digit > 9) {
+            return -1;
+        }
+        number = number * 10 + digit;
+    }
+
+    return number;
+}
+
+/** Parse a date in the ISO format that the SQLite and PostgreSQL drivers
+ *  return, without the overhead of QDate::fromString().
+ *  @param[in] text the date, as yyyy-MM-dd
+ *  @returns the date, or an invalid date if the text is not in the format */
+static QDate parseIsoDate(const QString &text)
+{
+    if (10 != text.size() || '-' != text.at(4) || '-' != text.at(7)) {
+        return QDate();
+    }
+
+    const QChar *chars = text.constData();
+    const int year = parseDigits(chars, 4);
+    const int month = parseDigits(chars + 5, 2);
+    const int day = parseDigits(chars + 8, 2);
+    if (year < 0 || month < 0 || day < 0) {
+        return QDate();
+    }
+
+    return QDate(year, month, day);
+}
+
+/** Parse a time in the ISO format that the SQLite and PostgreSQL drivers
+ *  return, ignoring fractions of milliseconds and time zones.
+ *  @param[in] text the time, as HH:mm:ss with optional fractions
+ *  @returns the time, or an invalid time if the text is not in the format */
+static QTime parseIsoTime(const QString &text)
+{
+    if (text.size() < 8 || ':' != text.at(2) || ':' != text.at(5)) {
+        return QTime();
+    }
+
+    const QChar *chars = text.constData();
+    const int hours = parseDigits(chars, 2);
+    const int minutes = parseDigits(chars + 3, 2);
+    const int seconds = parseDigits(chars + 6, 2);
+    if (hours < 0 || minutes < 0 || seconds < 0) {
+        return QTime();
+    }
+
+    int msecs = 0;
+    if (text.size() > 9 && '.' == text.at(8)) {
+        // Scale the first three digits of the fraction to milliseconds.
+        int scale = 100;
+        for (int index = 9; index < text.size() && index < 12; ++index) {
+            const int digit = parseDigits(chars + index, 1);
+            if (digit < 0) {
+                break;
+            }
+            msecs += digit * scale;
+            scale /= 10;
+        }
+    }
+
+    return QTime(hours, minutes, seconds, msecs);
+}
+
+/** Convert a value to the type it is stored as. The drivers return dates and
+ *  times as strings, which are parsed once here, so that the model and the
+ *  formatters get QDate and QTime values.
+ *  @param[in] type the Glom type of the column
+ *  @param[in] value the value from the driver
+ *  @returns the value to store */
+static QVariant nativeValue(Glom::Field::glom_field_type type,
+    const QVariant &value)
+{
+    if (QVariant::String != value.type() || value.isNull()) {
+        return value;
+    }
+
+    switch (type) {
+    case Glom::Field::TYPE_DATE: {
+        const QDate date = parseIsoDate(value.toString());
+        if (date.isValid()) {
+            return QVariant(date);
+        }
+    } break;
+
+    case Glom::Field::TYPE_TIME: {
+        const QTime time = parseIsoTime(value.toString());
+        if (time.isValid()) {
+            return QVariant(time);
+        }
+    } break;
+
+    default:
+        break;
+    }
+
+    return value;
+}
+
+QlomRowCache::QlomRowCache(const QString &name, QSqlDatabase db,
+    const std::shared_ptr<QlomMemoryBudget> &budget,
+    QlomQueryStatistics *statistics) :
+    theName(name),
+    theDatabase(db),
+    theBudget(budget),
+    theQueryStatistics(statistics),
+    theFormattingFlag(false),
+    theExhaustedFlag(true),
+    theColumnCount(0),
+    theRowCount(0),
+    theBytes(0),
+    theResidentPageCount(0),
+    theEvictedPageCount(0),
+    theLastUsed(0)
+{
+    if (theBudget) {
+        theBudget->addCache(this);
+    }
+}
+
+QlomRowCache::~QlomRowCache()
+{
+    if (theBudget) {
+        theBudget->removeCache(this);
+    }
+}
+
+bool QlomRowCache::setQuery(const QString &query)
+{
+    QLOM_TRACE_SCOPE("execute query", "query");
+    theQuery = query;
+    thePages.clear();
+    theRowCount = 0;
+    theColumnCount = 0;
+    theBytes = 0;
+    theResidentPageCount = 0;
+    theExhaustedFlag = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    theStream = QSqlQuery(theDatabase);
+    theStream.setForwardOnly(true);
+    if (!theStream.exec(query)) {
+        theLastError = theStream.lastError();
+        qWarning("The query of \"%s\" failed\nError details: %s",
+            qPrintable(theName), qPrintable(theLastError.text()));
+        return false;
+    }
+
+    theColumnCount = theStream.record().count();
+    theExhaustedFlag = false;
+
+    // The first page is part of the execution, as for QSqlQueryModel.
+    qint64 wireBytes = 0;
+    const int rows = appendPage(wireBytes);
+    if (theQueryStatistics) {
+        theQueryStatistics->recordExecution(theName, timer.nsecsElapsed(),
+            rows, wireBytes);
+    }
+
+    if (theBudget) {
+        theBudget->enforce(this);
+    }
+
+    return true;
+}
+
+void QlomRowCache::setFormatters(
+    const QVector<QlomDisplayFormatter> &formatters)
+{
+    theFormatters = formatters;
+    theFormattingFlag = false;
+    theBooleanColumns = QBitArray(theFormatters.size());
+    int column = 0;
+    for (QVector<QlomDisplayFormatter>::const_iterator iter =
+             theFormatters.begin();
+         iter != theFormatters.end();
+         ++iter, ++column) {
+        theFormattingFlag = theFormattingFlag || (*iter).isFormatting();
+        if (Glom::Field::TYPE_BOOLEAN == (*iter).type()) {
+            theBooleanColumns.setBit(column);
+        }
+    }
+}
+
+QSqlError QlomRowCache::lastError() const
+{
+    return theLastError;
+}
+
+QString QlomRowCache::name() const
+{
+    return theName;
+}
+
+int QlomRowCache::rowCount() const
+{
+    return theRowCount;
+}
+
+int QlomRowCache::columnCount() const
+{
+    return theColumnCount;
+}
+
+bool QlomRowCache::canFetchMore() const
+{
+    return !theExhaustedFlag;
+}
+
+int QlomRowCache::fetchMore()
+{
+    if (theExhaustedFlag) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 wireBytes = 0;
+    const int rows = appendPage(wireBytes);
+    if (theQueryStatistics) {
+        theQueryStatistics->recordFetch(theName, timer.nsecsElapsed(), rows,
+            wireBytes);
+    }
+
+    if (theBudget) {
+        theBudget->enforce(this);
+    }
+
+    return rows;
+}
+
+QVariant QlomRowCache::value(int row, int column)
+{
+    if (row < 0 || row >= theRowCount || column < 0
+        || column >= theColumnCount) {
+        return QVariant();
+    }
+
+    return usePage(row).values.value(row % rowsPerPage, column);
+}
+
+QString QlomRowCache::displayText(int row, int column)
+{
+    if (!theFormattingFlag || row < 0 || row >= theRowCount || column < 0
+        || column >= theColumnCount) {
+        return QString();
+    }
+
+    const Page &page = usePage(row);
+    if (page.texts.isEmpty()) {
+        return QString();
+    }
+
+    return page.texts.at(column * page.values.rowCount() + row % rowsPerPage);
+}
+
+qint64 QlomRowCache::bytes() const
+{
+    return theBytes;
+}
+
+int QlomRowCache::pageCount() const
+{
+    return thePages.size();
+}
+
+int QlomRowCache::residentPageCount() const
+{
+    return theResidentPageCount;
+}
+
+bool QlomRowCache::isResident() const
+{
+    return (theExhaustedFlag && theResidentPageCount == thePages.size());
+}
+
+bool QlomRowCache::areRowsResident(int firstRow, int lastRow) const
+{
+    const int first = qMax(firstRow, 0);
+    const int last = qMin(lastRow, theRowCount - 1);
+    if (first > last) {
+        return true;
+    }
+
+    for (int pageIndex = first / rowsPerPage;
+         pageIndex <= last / rowsPerPage;
+         ++pageIndex) {
+        if (thePages.at(pageIndex).values.isEmpty()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+qint64 QlomRowCache::evictedPageCount() const
+{
+    return theEvictedPageCount;
+}
+
+quint64 QlomRowCache::lastUsed() const
+{
+    return theLastUsed;
+}
+
+qint64 QlomRowCache::evict(qint64 bytes, int keepPages)
+{
+    // The resident pages, least recently used first.
+    QVector<QPair<quint64, int> > resident;
+    resident.reserve(theResidentPageCount);
+    for (int index = 0; index < thePages.size(); ++index) {
+        if (!thePages.at(index).values.isEmpty()) {
+            resident.push_back(qMakePair(thePages.at(index).lastUsed, index));
+        }
+    }
+    std::sort(resident.begin(), resident.end());
+
+    qint64 freed = 0;
+    const int evictable = resident.size() - keepPages;
+    for (int index = 0; index < evictable && freed < bytes; ++index) {
+        Page &page = thePages[resident.at(index).second];
+        freed += page.bytes;
+        theBytes -= page.bytes;
+        page.values.release();
+        page.texts = QVector<QString>();
+        page.bytes = 0;
+        --theResidentPageCount;
+        ++theEvictedPageCount;
+    }
+
+    return freed;
+}
+
+int QlomRowCache::appendPage(qint64 &wireBytes)
+{
+    Page page;
+    const int rows = readPage(theStream, page, wireBytes);
+
+    if (rows < rowsPerPage) {
+        theExhaustedFlag = true;
+        theStream.finish();
+
+        /* Drop the shared lock by *finishing* the transaction.
+         * Otherwise, other db connections cannot write to the opened table.
+         * Once we fetched all data, there is also no need to keep a lock,
+         * since we don't intend to write to the table (even if so, that'd be
+         * another transaction). */
+        theDatabase.commit();
+    }
+
+    if (rows > 0) {
+        formatPage(page);
+        touch(page);
+        thePages.push_back(page);
+        theRowCount += rows;
+        theBytes += page.bytes;
+        ++theResidentPageCount;
+    }
+
+    return rows;
+}
+
+int QlomRowCache::readPage(QSqlQuery &query, Page &page,
+    qint64 &wireBytes) const
+{
+    // The formatters know the Glom type of each column.
+    QVector<Glom::Field::glom_field_type> types(theColumnCount,
+        Glom::Field::TYPE_INVALID);
+    QBitArray booleanColumns;
+    if (theFormatters.size() == theColumnCount) {
+        for (int column = 0; column < theColumnCount; ++column) {
+            types[column] = theFormatters.at(column).type();
+        }
+        booleanColumns = theBooleanColumns;
+    }
+
+    page.values.reset(theColumnCount, rowsPerPage, booleanColumns);
+
+    int rows = 0;
+    while (rows < rowsPerPage && query.next()) {
+        for (int column = 0; column < theColumnCount; ++column) {
+            const QVariant value = query.value(column);
+            wireBytes += QlomQueryStatistics::estimateBytes(value);
+            page.values.setValue(rows, column,
+                nativeValue(types.at(column), value));
+        }
+        ++rows;
+    }
+
+    page.values.setRowCount(rows);
+    page.values.squeeze();
+    page.bytes = page.values.bytes();
+    return rows;
+}
+
+void QlomRowCache::reloadPage(int pageIndex)
+{
+    QLOM_TRACE_SCOPE("reload page", "fetch");
+    const int firstRow = pageIndex * rowsPerPage;
+    const int pageRows = qMin(rowsPerPage, theRowCount - firstRow);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The multi-arg overload, so that the query cannot inject %-markers.
+    const QString strQuery = QString("%1 LIMIT %2 OFFSET %3").arg(theQuery,
+        QString::number(pageRows), QString::number(firstRow));
+
+    Page &page = thePages[pageIndex];
+    qint64 wireBytes = 0;
+    int rows = 0;
+    QSqlQuery query(theDatabase);
+    query.setForwardOnly(true);
+    if (query.exec(strQuery)) {
+        rows = readPage(query, page, wireBytes);
+    } else {
+        theLastError = query.lastError();
+        qWarning("A page of \"%s\" could not be queried again\n"
+            "Error details: %s", qPrintable(theName),
+            qPrintable(theLastError.text()));
+        page.values.reset(theColumnCount, rowsPerPage);
+        page.bytes = page.values.bytes();
+    }
+
+    /* Rows that are gone, for instance because they were deleted meanwhile,
+     * are shown empty rather than queried again on every repaint. */
+    if (rows < pageRows) {
+        page.values.setRowCount(pageRows);
+    }
+    formatPage(page);
+
+    theBytes += page.bytes;
+    ++theResidentPageCount;
+    touch(page);
+
+    if (theQueryStatistics) {
+        theQueryStatistics->recordExecution(
+            QString("%1 (reload)").arg(theName), timer.nsecsElapsed(),
+            pageRows, wireBytes);
+    }
+
+    // The page was just used, so the budget evicts other pages first.
+    if (theBudget) {
+        theBudget->enforce(this);
+    }
+}
+
+QlomRowCache::Page & QlomRowCache::usePage(int row)
+{
+    const int pageIndex = row / rowsPerPage;
+    if (thePages.at(pageIndex).values.isEmpty()) {
+        reloadPage(pageIndex);
+    }
+
+    Page &page = thePages[pageIndex];
+    touch(page);
+    return page;
+}
+
+void QlomRowCache::formatPage(Page &page) const
+{
+    if (theFormattingFlag && theFormatters.size() == theColumnCount) {
+        page.bytes += QlomDisplayFormatter::formatPage(page.values,
+            theFormatters, page.texts, QLocale());
+    }
+}
+
+void QlomRowCache::touch(Page &page)
+{
+    page.lastUsed = ++usageClock;
+    theLastUsed = page.lastUsed;
+}
@@ -0,0 +1,213 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_ROW_CACHE_H_
+#define QLOM_ROW_CACHE_H_
+
+#include "display_formatter.h"
+#include "memory_budget.h"
+#include "query_statistics.h"
+#include "row_page.h"
+
+#include <memory>
+
+#include <QBitArray>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+/** The rows of a query, fetched in pages and kept within a memory budget.
+ *  The query is streamed with a forward-only QSqlQuery, so that the driver
+ *  does not keep a second copy of the rows. fetchMore() appends a page at a
+ *  time. When the QlomMemoryBudget evicts a page, its values are dropped and
+ *  value() queries them again with LIMIT and OFFSET, which relies on the
+ *  query being ordered, as the list layout queries are by the primary key.
+ *  The values of a page are kept in a QlomRowPage, whose memory is tracked
+ *  and freed together. If formatters are set, each page is formatted for
+ *  display as soon as it is read, before its rows are counted, so that the
+ *  view only draws the texts. */
+class QlomRowCache
+{
+public:
+    /** The rows per page, which are fetched, evicted and reloaded together. */
+    static const int rowsPerPage = 256;
+
+    /** Create an empty cache.
+     *  @param[in] name the name of the cache, for the statistics and the
+     *  diagnostics
+     *  @param[in] db the database connection
+     *  @param[in] budget the budget that the cache counts against, or 0
+     *  @param[in] statistics a collector for the latency and throughput of
+     *  the queries, or 0 */
+    QlomRowCache(const QString &name, QSqlDatabase db,
+        const std::shared_ptr<QlomMemoryBudget> &budget,
+        QlomQueryStatistics *statistics);
+
+    /** Unregister the cache from its budget. */
+    ~QlomRowCache();
+
+    /** Replace the rows with the result of a query, and fetch the first
+     *  page.
+     *  @param[in] query the SQL query, which must be ordered
+     *  @returns true on success, false otherwise */
+    bool setQuery(const QString &query);
+
+    /** Set the formatters of the columns, which apply to the pages read
+     *  from then on.
+     *  @param[in] formatters a formatter per column of the query, or none.
+     *  Their field types also make the pages store dates and times
+     *  natively, and bit-pack booleans. */
+    void setFormatters(const QVector<QlomDisplayFormatter> &formatters);
+
+    /** Get the error of the last query that failed. */
+    QSqlError lastError() const;
+
+    /** Get the name given to the constructor. */
+    QString name() const;
+
+    /** Get the number of rows fetched so far. */
+    int rowCount() const;
+
+    /** Get the number of columns of the query. */
+    int columnCount() const;
+
+    /** Whether the query has more rows. */
+    bool canFetchMore() const;
+
+    /** Fetch the next page of rows. Once all rows are fetched, the
+     *  transaction of the query is finished, so that other connections can
+     *  write to the table.
+     *  @returns the number of rows fetched */
+    int fetchMore();
+
+    /** Get a value, reloading its page if it was evicted.
+     *  @param[in] row the row, which must have been fetched
+     *  @param[in] column the column of the query
+     *  @returns the value */
+    QVariant value(int row, int column);
+
+    /** Get the display text of a value, reloading its page if it was
+     *  evicted.
+     *  @param[in] row the row, which must have been fetched
+     *  @param[in] column the column of the query
+     *  @returns the text formatted by the formatter of the column, or a null
+     *  QString if the value is not formatted */
+    QString displayText(int row, int column);
+
+    /** Get the memory used by the pages in memory.
+     *  @returns the memory in bytes */
+    qint64 bytes() const;
+
+    /** Get the number of pages fetched so far. */
+    int pageCount() const;
+
+    /** Get the number of pages in memory. */
+    int residentPageCount() const;
+
+    /** Whether all rows of the query are fetched and none of their pages
+     *  is evicted, so that reading every row does not query again. */
+    bool isResident() const;
+
+    /** Whether the pages of some rows are in memory, so that reading them
+     *  does not query again.
+     *  @param[in] firstRow the first row
+     *  @param[in] lastRow the last row, or less than firstRow for no rows
+     *  @returns true if no page of the rows was evicted */
+    bool areRowsResident(int firstRow, int lastRow) const;
+
+    /** Get the number of pages that were evicted so far. */
+    qint64 evictedPageCount() const;
+
+    /** Get the time of the last use of the cache, as a tick of a clock that
+     *  is shared by all caches. */
+    quint64 lastUsed() const;
+
+    /** Evict the pages that were used least recently. Called by the budget.
+     *  @param[in] bytes the memory to free
+     *  @param[in] keepPages the number of most recently used pages to keep
+     *  @returns the memory freed, in bytes */
+    qint64 evict(qint64 bytes, int keepPages);
+
+private:
+    /** A page of rows, whose values are empty while it is evicted. */
+    struct Page
+    {
+        QlomRowPage values; /**< the values */
+        QVector<QString> texts; /**< the display texts, by column, or
+                                     empty */
+        qint64 bytes; /**< the memory used by values and texts */
+        quint64 lastUsed; /**< see QlomRowCache::lastUsed() */
+    };
+
+    /** Append the next page of theStream, finishing its transaction once it
+     *  has no more rows.
+     *  @param[in,out] wireBytes the estimated size of the rows on the wire,
+     *  which is added to
+     *  @returns the number of rows appended */
+    int appendPage(qint64 &wireBytes);
+
+    /** Read up to a page of rows from a query.
+     *  @param[in,out] query the active query
+     *  @param[out] page the page to fill
+     *  @param[in,out] wireBytes the estimated size of the rows on the wire,
+     *  which is added to
+     *  @returns the number of rows read */
+    int readPage(QSqlQuery &query, Page &page, qint64 &wireBytes) const;
+
+    /** Get the page of a row that was fetched, reloading it if it was
+     *  evicted, and mark it as used.
+     *  @param[in] row the row
+     *  @returns the page */
+    Page & usePage(int row);
+
+    /** Format the values of a page, if there are formatters.
+     *  @param[in,out] page the page */
+    void formatPage(Page &page) const;
+
+    /** Query the rows of an evicted page again.
+     *  @param[in] pageIndex the index of the page */
+    void reloadPage(int pageIndex);
+
+    /** Mark a page as used.
+     *  @param[in] page the page */
+    void touch(Page &page);
+
+    QString theName; /**< see name() */
+    QSqlDatabase theDatabase; /**< the connection of the queries */
+    std::shared_ptr<QlomMemoryBudget> theBudget; /**< the budget, or 0 */
+    QlomQueryStatistics *theQueryStatistics; /**< the statistics, or 0 */
+    QVector<QlomDisplayFormatter> theFormatters; /**< see setFormatters() */
+    bool theFormattingFlag; /**< whether any of theFormatters formats */
+    QBitArray theBooleanColumns; /**< the boolean columns of theFormatters */
+    QString theQuery; /**< see setQuery() */
+    QSqlQuery theStream; /**< the forward-only query of fetchMore() */
+    QSqlError theLastError; /**< see lastError() */
+    bool theExhaustedFlag; /**< whether theStream has no more rows */
+    int theColumnCount; /**< see columnCount() */
+    int theRowCount; /**< see rowCount() */
+    QVector<Page> thePages; /**< the pages fetched so far */
+    qint64 theBytes; /**< see bytes() */
+    int theResidentPageCount; /**< see residentPageCount() */
+    qint64 theEvictedPageCount; /**< see evictedPageCount() */
+    quint64 theLastUsed; /**< see lastUsed() */
+};
+
+#endif /* QLOM_ROW_CACHE_H_ */
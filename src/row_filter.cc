@@ -0,0 +1,398 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "row_filter.h"
+#include "filter_kernels.h"
+#include "sort_index.h"
+#include "trace.h"
+
+#include <cmath>
+#include <limits>
+
+#include <QCollator>
+#include <QDate>
+#include <QHash>
+#include <QLocale>
+#include <QSet>
+#include <QStringList>
+#include <QTime>
+#include <QtNumeric>
+
+/** The rows of a word of the selection bitmap. */
+static const int rowsPerWord = QlomFilterKernels::rowsPerWord;
+
+/** Read a value of a filter expression, see QlomRowFilter::parse().
+ *  @param[in] text the value, which is trimmed
+ *  @param[in] type the Glom type of the filtered column
+ *  @returns the value, or a null QVariant if the text is not a value of the
+ *  type */
+static QVariant parseValue(const QString &text,
+    Glom::Field::glom_field_type type)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty()) {
+        return QVariant();
+    }
+
+    // The locale of the user is tried first, then the ISO formats.
+    const QLocale locale;
+    bool conversionSucceeded = false;
+    switch (type) {
+    case Glom::Field::TYPE_NUMERIC:
+    {
+        double number = locale.toDouble(trimmed, &conversionSucceeded);
+        if (!conversionSucceeded) {
+            number = trimmed.toDouble(&conversionSucceeded);
+        }
+        return (conversionSucceeded ? QVariant(number) : QVariant());
+        break;
+    }
+    case Glom::Field::TYPE_DATE:
+    {
+        QDate date = locale.toDate(trimmed, QLocale::ShortFormat);
+        if (!date.isValid()) {
+            date = QDate::fromString(trimmed, Qt::ISODate);
+        }
+        return (date.isValid() ? QVariant(date) : QVariant());
+        break;
+    }
+    case Glom::Field::TYPE_TIME:
+    {
+        QTime time = locale.toTime(trimmed, QLocale::ShortFormat);
+        if (!time.isValid()) {
+            time = QTime::fromString(trimmed, Qt::ISODate);
+        }
+        return (time.isValid() ? QVariant(time) : QVariant());
+        break;
+    }
+    case Glom::Field::TYPE_BOOLEAN:
+    {
+        const QString lower = trimmed.toLower();
+        if (QLatin1String("true") == lower || QLatin1String("yes") == lower
+            || QLatin1String("1") == lower) {
+            return QVariant(true);
+        } else if (QLatin1String("false") == lower
+            || QLatin1String("no") == lower || QLatin1String("0") == lower) {
+            return QVariant(false);
+        }
+        return QVariant();
+        break;
+    }
+    default:
+        return QVariant(trimmed);
+        break;
+    }
+}
+
+QlomFilterColumn::QlomFilterColumn() :
+    theTextFlag(false)
+{}
+
+QlomFilterColumn::QlomFilterColumn(QlomRowCache &cache, int column,
+    Glom::Field::glom_field_type type) :
+    theTextFlag(Glom::Field::TYPE_TEXT == type
+        || Glom::Field::TYPE_INVALID == type)
+{
+    if (theTextFlag) {
+        theTexts.push_back(QString());
+    }
+
+    append(cache, column);
+}
+
+void QlomFilterColumn::append(QlomRowCache &cache, int column)
+{
+    QLOM_TRACE_SCOPE("extract filter column", "filter");
+    const int rows = cache.rowCount();
+
+    if (!theTextFlag) {
+        if (theNumbers.isEmpty()) {
+            theNumbers.reserve(rows);
+        }
+
+        for (int row = theNumbers.size(); row < rows; ++row) {
+            theNumbers.push_back(
+                QlomSortIndex::numericKey(cache.value(row, column)));
+        }
+        return;
+    }
+
+    /* A copy that appended texts of its own left the shared dictionary
+     * ahead of theTexts, so it is rebuilt. */
+    if (!theDictionary || theDictionary->size() != theTexts.size() - 1) {
+        theDictionary = std::make_shared<QHash<QString, qint32> >();
+        for (int code = 1; code < theTexts.size(); ++code) {
+            theDictionary->insert(theTexts.at(code), code);
+        }
+    }
+
+    if (theCodes.isEmpty()) {
+        theCodes.reserve(rows);
+    }
+
+    for (int row = theCodes.size(); row < rows; ++row) {
+        const QVariant value = cache.value(row, column);
+        if (value.isNull()) {
+            theCodes.push_back(0);
+            continue;
+        }
+
+        const QString text = value.toString();
+        QHash<QString, qint32>::const_iterator code =
+            theDictionary->constFind(text);
+        if (code == theDictionary->constEnd()) {
+            code = theDictionary->insert(text, theTexts.size());
+            theTexts.push_back(text);
+        }
+        theCodes.push_back(*code);
+    }
+}
+
+bool QlomFilterColumn::isText() const
+{
+    return theTextFlag;
+}
+
+int QlomFilterColumn::rowCount() const
+{
+    return (theTextFlag ? theCodes.size() : theNumbers.size());
+}
+
+const QVector<qint32> & QlomFilterColumn::codes() const
+{
+    return theCodes;
+}
+
+const QVector<QString> & QlomFilterColumn::texts() const
+{
+    return theTexts;
+}
+
+qint64 QlomFilterColumn::bytes() const
+{
+    qint64 bytes = sizeof(QlomFilterColumn)
+        + theNumbers.capacity() * sizeof(double)
+        + theCodes.capacity() * sizeof(qint32)
+        + theTexts.capacity() * sizeof(QString)
+        + (theDictionary ? theDictionary->size() : 0)
+            * (sizeof(QString) + sizeof(qint32));
+    for (QVector<QString>::const_iterator iter = theTexts.begin();
+         iter != theTexts.end();
+         ++iter) {
+        bytes += (*iter).size() * sizeof(QChar);
+    }
+
+    return bytes;
+}
+
+QlomRowFilter::QlomRowFilter() :
+    theKind(RANGE),
+    theLowInclusiveFlag(true),
+    theHighInclusiveFlag(true)
+{}
+
+QlomRowFilter QlomRowFilter::range(const QVariant &low, const QVariant &high,
+    bool lowInclusive, bool highInclusive)
+{
+    QlomRowFilter filter;
+    filter.theLow = low;
+    filter.theHigh = high;
+    filter.theLowInclusiveFlag = lowInclusive;
+    filter.theHighInclusiveFlag = highInclusive;
+    return filter;
+}
+
+QlomRowFilter QlomRowFilter::oneOf(const QVariantList &values)
+{
+    QlomRowFilter filter;
+    filter.theKind = ONE_OF;
+    filter.theValues = values;
+    return filter;
+}
+
+bool QlomRowFilter::parse(const QString &expression,
+    Glom::Field::glom_field_type type, QlomRowFilter &filter)
+{
+    const QString trimmed = expression.trimmed();
+
+    // The longer operators are checked first, since they start alike.
+    static const char * const operators[] = { ">=", "<=", ">", "<", "=" };
+    for (int index = 0; index < 5; ++index) {
+        const QLatin1String op(operators[index]);
+        if (!trimmed.startsWith(op)) {
+            continue;
+        }
+
+        const QVariant value = parseValue(trimmed.mid(op.size()), type);
+        if (value.isNull()) {
+            return false;
+        }
+
+        switch (trimmed.at(0).toLatin1()) {
+        case '>':
+            filter = range(value, QVariant(), 2 == op.size());
+            break;
+        case '<':
+            filter = range(QVariant(), value, true, 2 == op.size());
+            break;
+        default:
+            filter = oneOf(QVariantList() << value);
+            break;
+        }
+        return true;
+    }
+
+    // A range, whose limits can be left out.
+    const int dots = trimmed.indexOf(QLatin1String(".."));
+    if (-1 != dots) {
+        const QString lowText = trimmed.left(dots).trimmed();
+        const QString highText = trimmed.mid(dots + 2).trimmed();
+        const QVariant low = parseValue(lowText, type);
+        const QVariant high = parseValue(highText, type);
+        if ((low.isNull() && !lowText.isEmpty())
+            || (high.isNull() && !highText.isEmpty())
+            || (lowText.isEmpty() && highText.isEmpty())) {
+            return false;
+        }
+
+        filter = range(low, high);
+        return true;
+    }
+
+    // Otherwise a list of values.
+    QVariantList values;
+    const QStringList texts = trimmed.split(QLatin1Char(','));
+    for (QStringList::const_iterator iter = texts.begin();
+         iter != texts.end();
+         ++iter) {
+        const QVariant value = parseValue(*iter, type);
+        if (value.isNull()) {
+            return false;
+        }
+        values.push_back(value);
+    }
+
+    filter = oneOf(values);
+    return true;
+}
+
+QVector<quint64> QlomRowFilter::select(const QlomFilterColumn &column) const
+{
+    QLOM_TRACE_SCOPE("filter rows", "filter");
+    QVector<quint64> bits((column.rowCount() + rowsPerWord - 1)
+        / rowsPerWord, 0);
+
+    if (column.isText()) {
+        selectTexts(column, bits);
+    } else {
+        selectNumbers(column, bits);
+    }
+
+    return bits;
+}
+
+void QlomRowFilter::selectNumbers(const QlomFilterColumn &column,
+    QVector<quint64> &bits) const
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    const int rows = column.theNumbers.size();
+    const QlomFilterKernels::Kernel kernel = QlomFilterKernels::fastest();
+
+    if (ONE_OF == theKind) {
+        // The sets of quick filters are small, so each value is a range.
+        for (QVariantList::const_iterator iter = theValues.begin();
+             iter != theValues.end();
+             ++iter) {
+            const double number = QlomSortIndex::numericKey(*iter);
+            if (!qIsNaN(number)) {
+                QlomFilterKernels::selectRange(kernel,
+                    column.theNumbers.constData(), rows, number, number,
+                    bits.data());
+            }
+        }
+        return;
+    }
+
+    /* Exclusive limits become the next number inside, so that the kernels
+     * only compare inclusively. */
+    double low = -infinity;
+    if (!theLow.isNull()) {
+        low = QlomSortIndex::numericKey(theLow);
+        if (!theLowInclusiveFlag) {
+            low = std::nextafter(low, infinity);
+        }
+    }
+
+    double high = infinity;
+    if (!theHigh.isNull()) {
+        high = QlomSortIndex::numericKey(theHigh);
+        if (!theHighInclusiveFlag) {
+            high = std::nextafter(high, -infinity);
+        }
+    }
+
+    // A limit that is not a number matches nothing.
+    if (!qIsNaN(low) && !qIsNaN(high)) {
+        QlomFilterKernels::selectRange(kernel, column.theNumbers.constData(),
+            rows, low, high, bits.data());
+    }
+}
+
+void QlomRowFilter::selectTexts(const QlomFilterColumn &column,
+    QVector<quint64> &bits) const
+{
+    // The filter is applied to each distinct text, rather than to each row.
+    const int codes = column.theTexts.size();
+    QVector<qint32> accepted(codes, 0);
+
+    if (ONE_OF == theKind) {
+        QSet<QString> texts;
+        for (QVariantList::const_iterator iter = theValues.begin();
+             iter != theValues.end();
+             ++iter) {
+            if (!(*iter).isNull()) {
+                texts.insert((*iter).toString());
+            }
+        }
+
+        for (int code = 1; code < codes; ++code) {
+            if (texts.contains(column.theTexts.at(code))) {
+                accepted[code] = -1;
+            }
+        }
+    } else {
+        const QCollator collator;
+        const QString low = theLow.toString();
+        const QString high = theHigh.toString();
+        for (int code = 1; code < codes; ++code) {
+            const QString &text = column.theTexts.at(code);
+            const int fromLow = (theLow.isNull() ? 1
+                : collator.compare(text, low));
+            const int toHigh = (theHigh.isNull() ? -1
+                : collator.compare(text, high));
+            if ((0 < fromLow || (0 == fromLow && theLowInclusiveFlag))
+                && (toHigh < 0 || (0 == toHigh && theHighInclusiveFlag))) {
+                accepted[code] = -1;
+            }
+        }
+    }
+
+    QlomFilterKernels::selectCodes(QlomFilterKernels::fastest(),
+        column.theCodes.constData(), column.theCodes.size(),
+        accepted.constData(), bits.data());
+}
@@ -0,0 +1,161 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_ROW_FILTER_H_
+#define QLOM_ROW_FILTER_H_
+
+#include "row_cache.h"
+
+#include <memory>
+
+#include <QHash>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <libglom/data_structure/field.h>
+
+/** A column of a fully cached query, in the typed form that QlomRowFilter
+ *  scans. Numbers, dates and times are kept as the doubles of
+ *  QlomSortIndex::numericKey(), with NaN for nulls, which costs eight bytes
+ *  per row. Texts are dictionary-encoded: each row keeps the 32-bit code of
+ *  its text, and each distinct text is kept once, with code 0 for null. The
+ *  column is extracted once and reused for every change of the filter, and
+ *  the rows fetched later are appended to it. */
+class QlomFilterColumn
+{
+public:
+    /** Create an empty column. */
+    QlomFilterColumn();
+
+    /** Extract a column of a cache.
+     *  @param[in,out] cache the cache, whose evicted pages are reloaded
+     *  @param[in] column the column of the query
+     *  @param[in] type the Glom type of the column, which decides whether it
+     *  is dictionary-encoded */
+    QlomFilterColumn(QlomRowCache &cache, int column,
+        Glom::Field::glom_field_type type);
+
+    /** Extract the rows that a cache fetched since this column was
+     *  extracted, keeping the codes of the texts seen so far. The cache must
+     *  still hold the rows of the column.
+     *  @param[in,out] cache the cache, whose evicted pages are reloaded
+     *  @param[in] column the column of the query */
+    void append(QlomRowCache &cache, int column);
+
+    /** Whether the column is dictionary-encoded. */
+    bool isText() const;
+
+    /** Get the number of rows. */
+    int rowCount() const;
+
+    /** Get the code of the text of each row, if the column is
+     *  dictionary-encoded. */
+    const QVector<qint32> & codes() const;
+
+    /** Get the text of each code, with a null QString for code 0. */
+    const QVector<QString> & texts() const;
+
+    /** Get the memory used by the column.
+     *  @returns the memory in bytes */
+    qint64 bytes() const;
+
+private:
+    friend class QlomRowFilter;
+
+    bool theTextFlag; /**< see isText() */
+    QVector<double> theNumbers; /**< the number of each row */
+    QVector<qint32> theCodes; /**< the code of each row */
+    QVector<QString> theTexts; /**< the text of each code */
+    /** The code of each text, which copies share, as only the copy kept by
+     *  the model appends. */
+    std::shared_ptr<QHash<QString, qint32> > theDictionary;
+};
+
+/** A quick filter of the rows of a cached query, such as a range of numbers
+ *  or dates, or a set of texts. select() evaluates the filter over a
+ *  QlomFilterColumn without any SQL, into a selection bitmap with a bit per
+ *  row, with the fastest QlomFilterKernels of the processor. Null values
+ *  never match. */
+class QlomRowFilter
+{
+public:
+    /** Create a filter that matches every value that is not null. */
+    QlomRowFilter();
+
+    /** Create a filter for a range. Texts are compared with the collation of
+     *  the default locale.
+     *  @param[in] low the lowest value, or a null QVariant for no limit
+     *  @param[in] high the highest value, or a null QVariant for no limit
+     *  @param[in] lowInclusive whether low itself matches
+     *  @param[in] highInclusive whether high itself matches
+     *  @returns the filter */
+    static QlomRowFilter range(const QVariant &low, const QVariant &high,
+        bool lowInclusive = true, bool highInclusive = true);
+
+    /** Create a filter for a set of values.
+     *  @param[in] values the values that match
+     *  @returns the filter */
+    static QlomRowFilter oneOf(const QVariantList &values);
+
+    /** Read a filter that a user typed for a column: "> 1000", ">= 1000",
+     *  "< 1000", "<= 1000" or "= 1000" for a comparison, "10 .. 20" for an
+     *  inclusive range, whose limits can be left out, or "a, b, c" for a set
+     *  of values. The values are read in the locale of the user, or in the
+     *  ISO formats.
+     *  @param[in] expression the text typed by the user
+     *  @param[in] type the Glom type of the column
+     *  @param[out] filter the filter, unless the expression is invalid
+     *  @returns true on success, false if the expression is invalid */
+    static bool parse(const QString &expression,
+        Glom::Field::glom_field_type type, QlomRowFilter &filter);
+
+    /** Select the rows of a column that match.
+     *  @param[in] column the column
+     *  @returns a bit per row, 64 rows per word, with the first row in the
+     *  lowest bit of the first word */
+    QVector<quint64> select(const QlomFilterColumn &column) const;
+
+private:
+    /** The kinds of filters. */
+    enum Kind {
+        RANGE,
+        ONE_OF
+    };
+
+    /** Select the numbers of a range.
+     *  @param[in] column the column, which is not dictionary-encoded
+     *  @param[in,out] bits the selection, which the matches are added to */
+    void selectNumbers(const QlomFilterColumn &column,
+        QVector<quint64> &bits) const;
+
+    /** Select the texts of a range or a set.
+     *  @param[in] column the dictionary-encoded column
+     *  @param[in,out] bits the selection, which the matches are added to */
+    void selectTexts(const QlomFilterColumn &column,
+        QVector<quint64> &bits) const;
+
+    Kind theKind; /**< the kind of the filter */
+    QVariant theLow; /**< see range() */
+    QVariant theHigh; /**< see range() */
+    bool theLowInclusiveFlag; /**< see range() */
+    bool theHighInclusiveFlag; /**< see range() */
+    QVariantList theValues; /**< see oneOf() */
+};
+
+#endif /* QLOM_ROW_FILTER_H_ */
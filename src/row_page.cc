@@ -0,0 +1,283 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "row_page.h"
+
+#include <cstring>
+
+#include <QDate>
+#include <QDateTime>
+#include <QString>
+#include <QTime>
+
+/** The alignment of data in the arena, which suits QChar and the sizes. */
+static const int arenaAlignment = sizeof(qint32);
+
+QlomRowPage::QlomRowPage() :
+    theColumnCount(0),
+    theCapacity(0),
+    theRowCount(0)
+{}
+
+void QlomRowPage::reset(int columns, int capacity,
+    const QBitArray &booleanColumns)
+{
+    theColumnCount = columns;
+    theCapacity = capacity;
+    theRowCount = 0;
+
+    theSlots = QVector<int>(columns);
+    int cellColumns = 0;
+    int bitColumns = 0;
+    for (int column = 0; column < columns; ++column) {
+        if (column < booleanColumns.size() && booleanColumns.testBit(column)) {
+            theSlots[column] = -1 - bitColumns;
+            ++bitColumns;
+        } else {
+            theSlots[column] = cellColumns;
+            ++cellColumns;
+        }
+    }
+
+    // The zero of both arrays is a null of QVariant::Invalid.
+    theTypes = QVector<quint8>(cellColumns * capacity, NULL_CELL);
+    theCells = QVector<qint64>(cellColumns * capacity, 0);
+    theArena = QByteArray();
+    theVariants = QVector<QVariant>();
+    // Cleared bits are nulls.
+    theBits = QBitArray(bitColumns * 2 * capacity);
+}
+
+void QlomRowPage::setValue(int row, int column, const QVariant &value)
+{
+    Q_ASSERT(row < theCapacity && column < theColumnCount);
+    const int slot = theSlots.at(column);
+    if (slot < 0) {
+        if (!value.isNull()) {
+            const int bit = bitIndex(row, slot);
+            theBits.setBit(bit, value.toBool());
+            theBits.setBit(bit + theCapacity);
+        }
+        return;
+    }
+
+    const int index = slot * theCapacity + row;
+    quint8 &type = theTypes[index];
+    qint64 &cell = theCells[index];
+
+    if (value.isNull()) {
+        type = NULL_CELL;
+        cell = value.type();
+        return;
+    }
+
+    switch (value.type()) {
+    case QVariant::Bool:
+        type = BOOL_CELL;
+        cell = value.toBool();
+        break;
+    case QVariant::Int:
+        type = INT_CELL;
+        cell = value.toInt();
+        break;
+    case QVariant::LongLong:
+        type = LONG_LONG_CELL;
+        cell = value.toLongLong();
+        break;
+    case QVariant::Double: {
+        type = DOUBLE_CELL;
+        const double real = value.toDouble();
+        std::memcpy(&cell, &real, sizeof(real));
+        break;
+    }
+    case QVariant::String: {
+        type = STRING_CELL;
+        // The variant owns the string, so constData() stays valid.
+        const QString &text = *static_cast<const QString *>(value.constData());
+        cell = allocate(text.constData(), text.size() * sizeof(QChar));
+        break;
+    }
+    case QVariant::ByteArray: {
+        type = BYTES_CELL;
+        const QByteArray &bytes =
+            *static_cast<const QByteArray *>(value.constData());
+        cell = allocate(bytes.constData(), bytes.size());
+        break;
+    }
+    case QVariant::Date:
+        type = DATE_CELL;
+        cell = value.toDate().toJulianDay();
+        break;
+    case QVariant::Time:
+        type = TIME_CELL;
+        cell = value.toTime().msecsSinceStartOfDay();
+        break;
+    case QVariant::DateTime:
+        type = DATE_TIME_CELL;
+        cell = value.toDateTime().toMSecsSinceEpoch();
+        break;
+    default:
+        type = VARIANT_CELL;
+        cell = theVariants.size();
+        theVariants.push_back(value);
+        break;
+    }
+}
+
+void QlomRowPage::setRowCount(int rows)
+{
+    Q_ASSERT(rows <= theCapacity);
+    theRowCount = rows;
+}
+
+void QlomRowPage::squeeze()
+{
+    theArena.squeeze();
+    theVariants.squeeze();
+}
+
+void QlomRowPage::release()
+{
+    theColumnCount = 0;
+    theCapacity = 0;
+    theRowCount = 0;
+
+    // Assigning frees the memory, unlike clear() for QByteArray.
+    theSlots = QVector<int>();
+    theBits = QBitArray();
+    theTypes = QVector<quint8>();
+    theCells = QVector<qint64>();
+    theArena = QByteArray();
+    theVariants = QVector<QVariant>();
+}
+
+QVariant QlomRowPage::value(int row, int column) const
+{
+    Q_ASSERT(row < theRowCount && column < theColumnCount);
+    const int slot = theSlots.at(column);
+    if (slot < 0) {
+        const int bit = bitIndex(row, slot);
+        return (theBits.testBit(bit + theCapacity)
+            ? QVariant(theBits.testBit(bit)) : QVariant(QVariant::Bool));
+    }
+
+    const int index = slot * theCapacity + row;
+    const qint64 cell = theCells.at(index);
+
+    switch (theTypes.at(index)) {
+    case NULL_CELL:
+        return QVariant(static_cast<QVariant::Type>(cell));
+        break;
+    case BOOL_CELL:
+        return QVariant(0 != cell);
+        break;
+    case INT_CELL:
+        return QVariant(static_cast<int>(cell));
+        break;
+    case LONG_LONG_CELL:
+        return QVariant(static_cast<qlonglong>(cell));
+        break;
+    case DOUBLE_CELL: {
+        double real;
+        std::memcpy(&real, &cell, sizeof(real));
+        return QVariant(real);
+        break;
+    }
+    case STRING_CELL:
+        return QVariant(QString(reinterpret_cast<const QChar *>(
+            theArena.constData() + cell + arenaAlignment),
+            allocatedSize(cell) / sizeof(QChar)));
+        break;
+    case BYTES_CELL:
+        return QVariant(QByteArray(
+            theArena.constData() + cell + arenaAlignment,
+            allocatedSize(cell)));
+        break;
+    case DATE_CELL:
+        return QVariant(QDate::fromJulianDay(cell));
+        break;
+    case TIME_CELL:
+        return QVariant(
+            QTime::fromMSecsSinceStartOfDay(static_cast<int>(cell)));
+        break;
+    case DATE_TIME_CELL:
+        return QVariant(QDateTime::fromMSecsSinceEpoch(cell));
+        break;
+    default:
+        return theVariants.at(static_cast<int>(cell));
+        break;
+    }
+}
+
+int QlomRowPage::rowCount() const
+{
+    return theRowCount;
+}
+
+bool QlomRowPage::isEmpty() const
+{
+    return (0 == theRowCount);
+}
+
+qint64 QlomRowPage::bytes() const
+{
+    qint64 bytes = sizeof(QlomRowPage)
+        + theSlots.capacity() * sizeof(int)
+        + (theBits.size() + 7) / 8
+        + theTypes.capacity() * sizeof(quint8)
+        + theCells.capacity() * sizeof(qint64)
+        + theArena.capacity()
+        + theVariants.capacity() * sizeof(QVariant);
+
+    // Only the rare values without a fast path own further memory.
+    for (QVector<QVariant>::const_iterator iter = theVariants.begin();
+         iter != theVariants.end();
+         ++iter) {
+        bytes += (*iter).toByteArray().size();
+    }
+
+    return bytes;
+}
+
+qint64 QlomRowPage::allocate(const void *data, int size)
+{
+    // Pad the previous data, so that the size and QChars are aligned.
+    const int padding = (arenaAlignment - theArena.size() % arenaAlignment)
+        % arenaAlignment;
+    const qint64 offset = theArena.size() + padding;
+
+    /* QByteArray grows geometrically, so that appending costs few
+     * allocations per page. The offsets stay valid when it moves. */
+    const qint32 size32 = size;
+    theArena.append(padding, '\0');
+    theArena.append(reinterpret_cast<const char *>(&size32), sizeof(size32));
+    theArena.append(static_cast<const char *>(data), size);
+    return offset;
+}
+
+int QlomRowPage::allocatedSize(qint64 offset) const
+{
+    qint32 size;
+    std::memcpy(&size, theArena.constData() + offset, sizeof(size));
+    return size;
+}
+
+int QlomRowPage::bitIndex(int row, int slot) const
+{
+    return (-1 - slot) * 2 * theCapacity + row;
+}
@@ -0,0 +1,132 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_ROW_PAGE_H_
+#define QLOM_ROW_PAGE_H_
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QVariant>
+#include <QVector>
+
+/** The values of a page of rows, stored by column in flat arrays instead of
+ *  as a QVariant per value. Each value takes a type tag and 8 bytes, which
+ *  hold numbers, dates and times directly. The characters of strings and the
+ *  bytes of byte arrays are bump-allocated in one arena per page. Filling a
+ *  page thus costs a few allocations, however many rows it has, and
+ *  release() frees all of its memory at once. value() creates the QVariant
+ *  again, which only happens for the rows being shown.
+ *  Boolean columns are bit-packed instead, with two bits per value: the
+ *  value, and whether it is not null. */
+class QlomRowPage
+{
+public:
+    /** Create an empty page. */
+    QlomRowPage();
+
+    /** Drop the values and make room for a page of null values.
+     *  @param[in] columns the number of columns
+     *  @param[in] capacity the maximum number of rows
+     *  @param[in] booleanColumns the columns to bit-pack, whose values are
+     *  converted with QVariant::toBool() */
+    void reset(int columns, int capacity,
+        const QBitArray &booleanColumns = QBitArray());
+
+    /** Store a value. Values of types without a fast path are kept as a
+     *  QVariant.
+     *  @param[in] row the row, less than the capacity
+     *  @param[in] column the column
+     *  @param[in] value the value */
+    void setValue(int row, int column, const QVariant &value);
+
+    /** Set the number of rows. Rows whose values were not set are null.
+     *  @param[in] rows the number of rows, at most the capacity */
+    void setRowCount(int rows);
+
+    /** Free the unused memory of the arena, once the page is filled. */
+    void squeeze();
+
+    /** Free all memory of the page. */
+    void release();
+
+    /** Get a value.
+     *  @param[in] row the row
+     *  @param[in] column the column
+     *  @returns the value */
+    QVariant value(int row, int column) const;
+
+    /** Get the number of rows. */
+    int rowCount() const;
+
+    /** Whether the page has no rows, for instance after release(). */
+    bool isEmpty() const;
+
+    /** Get the memory used by the page.
+     *  @returns the memory in bytes */
+    qint64 bytes() const;
+
+private:
+    /** The type tags of the values. */
+    enum CellType {
+        NULL_CELL, /**< the cell holds the QVariant::Type of the null */
+        BOOL_CELL,
+        INT_CELL,
+        LONG_LONG_CELL,
+        DOUBLE_CELL, /**< the cell holds the bits of the double */
+        STRING_CELL, /**< the cell holds the offset in theArena */
+        BYTES_CELL, /**< the cell holds the offset in theArena */
+        DATE_CELL, /**< the cell holds the Julian day */
+        TIME_CELL, /**< the cell holds the milliseconds since midnight */
+        DATE_TIME_CELL, /**< the cell holds the milliseconds since the
+                             epoch */
+        VARIANT_CELL /**< the cell holds the index in theVariants */
+    };
+
+    /** Copy data to the end of the arena, after its size.
+     *  @param[in] data the data
+     *  @param[in] size the size of the data in bytes
+     *  @returns the offset in the arena */
+    qint64 allocate(const void *data, int size);
+
+    /** Get the size of data in the arena.
+     *  @param[in] offset the offset returned by allocate()
+     *  @returns the size in bytes */
+    int allocatedSize(qint64 offset) const;
+
+    /** Get the position of the value bit of a boolean value in theBits.
+     *  The bit that tells whether the value is not null follows theCapacity
+     *  bits later.
+     *  @param[in] row the row
+     *  @param[in] slot the slot of the column in theSlots, which is negative
+     *  @returns the position */
+    int bitIndex(int row, int slot) const;
+
+    int theColumnCount; /**< the number of columns */
+    int theCapacity; /**< the rows per column in theTypes and theCells */
+    int theRowCount; /**< see rowCount() */
+    QVector<int> theSlots; /**< the slot of each column in theCells, or
+                                -1 - its column in theBits */
+    QVector<quint8> theTypes; /**< the CellType of each value, by column */
+    QVector<qint64> theCells; /**< the data of each value, by column */
+    QByteArray theArena; /**< the characters and bytes of the values, each
+                              after its size */
+    QVector<QVariant> theVariants; /**< the values without a fast path */
+    QBitArray theBits; /**< the values of the boolean columns */
+};
+
+#endif /* QLOM_ROW_PAGE_H_ */
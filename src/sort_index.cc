@@ -0,0 +1,226 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sort_index.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QDate>
+#include <QDateTime>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QTime>
+#include <QtNumeric>
+
+/** The fewest rows that are sorted by a task of their own. Smaller chunks
+ *  cost more in merging than they gain in parallelism. */
+static const int rowsPerSortTask = 32768;
+
+/** Compare two numeric keys. */
+static int compareKeys(double lhs, double rhs)
+{
+    return (lhs < rhs ? -1 : (rhs < lhs ? 1 : 0));
+}
+
+/** Compare two collation keys. */
+static int compareKeys(const QCollatorSortKey &lhs,
+    const QCollatorSortKey &rhs)
+{
+    return lhs.compare(rhs);
+}
+
+/** Orders row numbers by their keys, and equal keys by the row numbers, so
+ *  that the order is total and std::sort() gives the result of a stable
+ *  sort. */
+template <typename Key>
+class QlomRowLess
+{
+public:
+    /** Create a comparison.
+     *  @param[in] keys the key of each row */
+    explicit QlomRowLess(const std::vector<Key> &keys) :
+        theKeys(&keys)
+    {}
+
+    /** Whether a row comes before another. */
+    bool operator()(int lhs, int rhs) const
+    {
+        const int order = compareKeys((*theKeys)[lhs], (*theKeys)[rhs]);
+        return (order < 0 || (0 == order && lhs < rhs));
+    }
+
+private:
+    const std::vector<Key> *theKeys; /**< the key of each row */
+};
+
+/** Sorts a chunk of rows, or merges two sorted neighbouring chunks, for
+ *  QlomSortIndex::build(). The chunks of the tasks that run at the same time
+ *  do not overlap, so that no locking is needed. */
+template <typename Key>
+class QlomSortTask : public QRunnable
+{
+public:
+    /** Create a task.
+     *  @param[in] keys the key of each row
+     *  @param[in,out] first the first row of the chunk
+     *  @param[in,out] middle the end of the first sorted chunk to merge, or
+     *  last to sort the chunk
+     *  @param[in,out] last the end of the chunk
+     *  @param[in] done released once the chunk is sorted */
+    QlomSortTask(const std::vector<Key> &keys, int *first, int *middle,
+        int *last, QSemaphore *done) :
+        theKeys(keys),
+        theFirst(first),
+        theMiddle(middle),
+        theLast(last),
+        theDone(done)
+    {}
+
+    /** Sort or merge the chunk. */
+    virtual void run()
+    {
+        QLOM_TRACE_SCOPE("sort rows", "sort");
+        const QlomRowLess<Key> less(theKeys);
+        if (theMiddle == theLast) {
+            std::sort(theFirst, theLast, less);
+        } else {
+            std::inplace_merge(theFirst, theMiddle, theLast, less);
+        }
+
+        theDone->release();
+    }
+
+private:
+    const std::vector<Key> &theKeys; /**< the key of each row */
+    int *theFirst; /**< the first row */
+    int *theMiddle; /**< the end of the first chunk to merge */
+    int *theLast; /**< the end of the chunk */
+    QSemaphore *theDone; /**< released once the chunk is sorted */
+};
+
+/** Sort row numbers by their keys, in parallel.
+ *  @param[in] keys the key of each row
+ *  @returns the rows in ascending order */
+template <typename Key>
+static QVector<int> sortRows(const std::vector<Key> &keys)
+{
+    const int rows = int(keys.size());
+    QVector<int> order(rows);
+    for (int row = 0; row < rows; ++row) {
+        order[row] = row;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int chunks = qBound(1, rows / rowsPerSortTask,
+        pool->maxThreadCount());
+    int *data = order.data();
+    if (1 == chunks) {
+        std::sort(data, data + rows, QlomRowLess<Key>(keys));
+        return order;
+    }
+
+    QVector<int> bounds;
+    for (int chunk = 0; chunk <= chunks; ++chunk) {
+        bounds.push_back(qint64(rows) * chunk / chunks);
+    }
+
+    QSemaphore done;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        int *last = data + bounds.at(chunk + 1);
+        pool->start(new QlomSortTask<Key>(keys, data + bounds.at(chunk),
+            last, last, &done));
+    }
+    done.acquire(chunks);
+
+    // Each pass merges pairs of neighbouring chunks, twice as long as before.
+    for (int width = 1; width < chunks; width *= 2) {
+        int tasks = 0;
+        for (int chunk = 0; chunk + width < chunks; chunk += 2 * width) {
+            pool->start(new QlomSortTask<Key>(keys, data + bounds.at(chunk),
+                data + bounds.at(chunk + width),
+                data + bounds.at(qMin(chunk + 2 * width, chunks)), &done));
+            ++tasks;
+        }
+        done.acquire(tasks);
+    }
+
+    return order;
+}
+
+double QlomSortIndex::numericKey(const QVariant &value)
+{
+    const double notANumber = std::numeric_limits<double>::quiet_NaN();
+    if (value.isNull()) {
+        return notANumber;
+    }
+
+    switch(value.type()) {
+    case QVariant::Date:
+        return value.toDate().toJulianDay();
+        break;
+    case QVariant::Time:
+        return value.toTime().msecsSinceStartOfDay();
+        break;
+    case QVariant::DateTime:
+        return value.toDateTime().toMSecsSinceEpoch();
+        break;
+    default:
+        break;
+    }
+
+    bool conversionSucceeded = false;
+    const double key = value.toDouble(&conversionSucceeded);
+    return (conversionSucceeded ? key : notANumber);
+}
+
+QVector<int> QlomSortIndex::build(QlomRowCache &cache, int column,
+    Glom::Field::glom_field_type type)
+{
+    QLOM_TRACE_SCOPE("build sort index", "sort");
+    const int rows = cache.rowCount();
+
+    if (Glom::Field::TYPE_TEXT == type || Glom::Field::TYPE_INVALID == type) {
+        // Null values collate as empty texts, which come first.
+        const QCollator collator;
+        std::vector<QCollatorSortKey> keys;
+        keys.reserve(rows);
+        for (int row = 0; row < rows; ++row) {
+            keys.push_back(collator.sortKey(cache.value(row, column)
+                .toString()));
+        }
+
+        return sortRows(keys);
+    }
+
+    // NaN would break the order of the sort, so it comes first, as nulls.
+    const double lowest = -std::numeric_limits<double>::infinity();
+    std::vector<double> keys;
+    keys.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        const double key = numericKey(cache.value(row, column));
+        keys.push_back(qIsNaN(key) ? lowest : key);
+    }
+
+    return sortRows(keys);
+}
@@ -0,0 +1,65 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_SORT_INDEX_H_
+#define QLOM_SORT_INDEX_H_
+
+#include "row_cache.h"
+
+#include <QVariant>
+#include <QVector>
+
+#include <libglom/data_structure/field.h>
+
+/** Sorts the rows of a fully cached query in memory, for
+ *  QlomListLayoutModel::sort(), so that sorting a local table does not query
+ *  the database again.
+ *  The sort keys of a column are extracted once, on the calling thread, since
+ *  the row cache is not thread-safe: numbers, dates and times become doubles,
+ *  and texts become QCollatorSortKeys of the default locale, so that the
+ *  order is correct for the locale while each comparison only compares
+ *  bytes. The row numbers are then sorted in chunks on the global
+ *  QThreadPool, and the chunks are merged pairwise, also in parallel.
+ *  Equal keys keep the order of the cache, so the result is the same as a
+ *  stable sort. The keys are dropped afterwards; the index itself costs four
+ *  bytes per row. */
+class QlomSortIndex
+{
+public:
+    /** Sort the rows of a cache by a column. The pages of the cache should
+     *  all be resident, as evicted ones are reloaded one by one.
+     *  @param[in,out] cache the cache, see QlomRowCache::isResident()
+     *  @param[in] column the column of the query
+     *  @param[in] type the Glom type of the column, which decides whether it
+     *  is collated as text or compared as numbers
+     *  @returns the rows of the cache in ascending order, with null values
+     *  first */
+    static QVector<int> build(QlomRowCache &cache, int column,
+        Glom::Field::glom_field_type type);
+
+    /** Get the numeric key of a value, which is also what QlomRowFilter
+     *  compares.
+     *  @param[in] value the value, with dates as Julian days, times as
+     *  milliseconds since midnight and date-times as milliseconds since the
+     *  epoch
+     *  @returns the key, or NaN for null values and values that are not
+     *  numbers */
+    static double numericKey(const QVariant &value);
+};
+
+#endif /* QLOM_SORT_INDEX_H_ */
@@ -0,0 +1,192 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "startup_profiler.h"
+
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <QMutexLocker>
+
+/** The category of the trace events of the startup phases. */
+static const char *const startupCategory = "startup";
+
+QlomStartupProfiler & QlomStartupProfiler::instance()
+{
+    static QlomStartupProfiler profiler;
+    return profiler;
+}
+
+QlomStartupProfiler::QlomStartupProfiler() :
+    theEnabledFlag(false),
+    theFinishedFlag(false),
+    theTraceOwnedFlag(false)
+{}
+
+void QlomStartupProfiler::enable(const QString &traceFilepath)
+{
+    QMutexLocker locker(&theMutex);
+
+    theTraceFilepath = traceFilepath;
+    // Only stop tracing in finish() if --trace did not ask for it too.
+    theTraceOwnedFlag = !QlomTrace::isEnabled();
+    QlomTrace::setEnabled(true);
+    // Set before any other thread starts, so it can be read without locking.
+    theEnabledFlag = true;
+}
+
+bool QlomStartupProfiler::isEnabled() const
+{
+    return theEnabledFlag;
+}
+
+void QlomStartupProfiler::begin(const char *phase)
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    QMutexLocker locker(&theMutex);
+    if (theFinishedFlag) {
+        return;
+    }
+
+    OpenPhase record;
+    record.name = phase;
+    record.beginNsecs = QlomTrace::now();
+    theOpenPhases.push_back(record);
+}
+
+void QlomStartupProfiler::end(const char *phase)
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    QMutexLocker locker(&theMutex);
+    if (theFinishedFlag) {
+        return;
+    }
+
+    const qint64 now = QlomTrace::now();
+    for (int index = theOpenPhases.size() - 1; index >= 0; --index) {
+        const OpenPhase &record = theOpenPhases.at(index);
+        if (0 == std::strcmp(record.name, phase)) {
+            // Recorded on the thread that ends the phase.
+            QlomTrace::record(record.name, startupCategory,
+                record.beginNsecs, now);
+            theOpenPhases.remove(index);
+            return;
+        }
+    }
+
+    qWarning("Startup phase %s ended without being started", phase);
+}
+
+void QlomStartupProfiler::mark(const char *event)
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    QMutexLocker locker(&theMutex);
+    if (theFinishedFlag) {
+        return;
+    }
+
+    QlomTrace::recordInstant(event, startupCategory, QlomTrace::now());
+}
+
+void QlomStartupProfiler::finish()
+{
+    if (!theEnabledFlag) {
+        return;
+    }
+
+    QMutexLocker locker(&theMutex);
+    if (theFinishedFlag) {
+        return;
+    }
+    theFinishedFlag = true;
+
+    if (theTraceFilepath.isEmpty()) {
+        printBreakdown(theOpenPhases);
+    } else {
+        // Phases that are still running are written up to now.
+        const qint64 now = QlomTrace::now();
+        for (QVector<OpenPhase>::const_iterator iter = theOpenPhases.begin();
+             iter != theOpenPhases.end();
+             ++iter) {
+            QlomTrace::record(iter->name, startupCategory, iter->beginNsecs,
+                now);
+        }
+
+        if (!QlomTrace::save(theTraceFilepath)) {
+            qWarning("Failed to write the startup profile to %s",
+                qPrintable(theTraceFilepath));
+        }
+    }
+    theOpenPhases.clear();
+
+    if (theTraceOwnedFlag) {
+        QlomTrace::setEnabled(false);
+    }
+}
+
+void QlomStartupProfiler::printBreakdown(
+    const QVector<OpenPhase> &unfinished) const
+{
+    const qint64 now = QlomTrace::now();
+    const QVector<QlomTraceEvent> events = QlomTrace::events(startupCategory);
+
+    std::printf("Startup profile (milliseconds since main()):\n");
+    std::printf("%10s %10s  %s\n", "start", "duration", "phase");
+    for (QVector<QlomTraceEvent>::const_iterator iter = events.begin();
+         iter != events.end();
+         ++iter) {
+        const QlomTraceEvent &event = *iter;
+        if (-1 == event.endNsecs) {
+            std::printf("%10.1f %10s  %s\n", event.beginNsecs / 1.0e6,
+                "", event.name);
+        } else {
+            std::printf("%10.1f %10.1f  %s\n", event.beginNsecs / 1.0e6,
+                (event.endNsecs - event.beginNsecs) / 1.0e6, event.name);
+        }
+    }
+    for (QVector<OpenPhase>::const_iterator iter = unfinished.begin();
+         iter != unfinished.end();
+         ++iter) {
+        std::printf("%10.1f %10s  %s\n", iter->beginNsecs / 1.0e6,
+            "unfinished", iter->name);
+    }
+    std::printf("%10.1f %10s  %s\n", now / 1.0e6, "", "total");
+    std::fflush(stdout);
+}
+
+QlomStartupPhase::QlomStartupPhase(const char *phase) :
+    thePhase(phase)
+{
+    QlomStartupProfiler::instance().begin(thePhase);
+}
+
+QlomStartupPhase::~QlomStartupPhase()
+{
+    QlomStartupProfiler::instance().end(thePhase);
+}
@@ -0,0 +1,106 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_STARTUP_PROFILER_H_
+#define QLOM_STARTUP_PROFILER_H_
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/** Records how long each phase of the startup takes.
+ *  The profiler is enabled by the --profile-startup command line option.
+ *  Phases are recorded with begin() and end(), or with a QlomStartupPhase,
+ *  and points in time with mark(). They can be recorded from any thread.
+ *  The profiler is a view over QlomTrace: phases are recorded as trace events
+ *  of the "startup" category, on the clock of the trace, so they also appear
+ *  in the output of --trace. Once the first table has been painted, or
+ *  loading has failed, finish() prints a breakdown of the phases, or writes
+ *  the trace to a file. While the profiler is disabled, recording does
+ *  nothing. */
+class QlomStartupProfiler
+{
+public:
+    /** Get the profiler of the application. */
+    static QlomStartupProfiler & instance();
+
+    /** Enable the profiler, and QlomTrace if it is not enabled yet.
+     *  @param[in] traceFilepath a file to write a Chrome trace to, or an
+     *  empty string to print a breakdown to the standard output */
+    void enable(const QString &traceFilepath);
+
+    /** Whether enable() has been called. */
+    bool isEnabled() const;
+
+    /** Record the start of a phase.
+     *  @param[in] phase the name of the phase, which must be a string literal */
+    void begin(const char *phase);
+
+    /** Record the end of the last started phase of that name.
+     *  @param[in] phase the name of the phase */
+    void end(const char *phase);
+
+    /** Record a point in time, such as the first paint of a widget.
+     *  @param[in] event the name of the event, which must be a string
+     *  literal */
+    void mark(const char *event);
+
+    /** Print or write the phases recorded so far. Only the first call has an
+     *  effect, and phases recorded afterwards are ignored. If the profiler
+     *  enabled QlomTrace, it is disabled again. */
+    void finish();
+
+private:
+    /** A phase that has begun but not ended yet. */
+    struct OpenPhase
+    {
+        const char *name; /**< the name of the phase */
+        qint64 beginNsecs; /**< the start, from QlomTrace::now() */
+    };
+
+    QlomStartupProfiler();
+
+    /** Print a breakdown of the startup events of QlomTrace to the standard
+     *  output.
+     *  @param[in] unfinished the phases that had not ended by finish() */
+    void printBreakdown(const QVector<OpenPhase> &unfinished) const;
+
+    mutable QMutex theMutex; /**< protects the members below */
+    QVector<OpenPhase> theOpenPhases; /**< the phases that have not ended */
+    QString theTraceFilepath; /**< see enable() */
+    bool theEnabledFlag; /**< see isEnabled() */
+    bool theFinishedFlag; /**< whether finish() has been called */
+    bool theTraceOwnedFlag; /**< whether enable() enabled QlomTrace */
+};
+
+/** Records a startup phase for the lifetime of the object. */
+class QlomStartupPhase
+{
+public:
+    /** Begin a phase.
+     *  @param[in] phase the name of the phase, which must be a string literal */
+    explicit QlomStartupPhase(const char *phase);
+
+    /** End the phase. */
+    ~QlomStartupPhase();
+
+private:
+    const char *thePhase; /**< the name of the phase */
+};
+
+#endif /* QLOM_STARTUP_PROFILER_H_ */
@@ -17,37 +17,120 @@
  */
 
 #include "table.h"
+#include "utils.h"
 
 QlomTable::QlomTable(const QString &tableName, const QString &displayName,
     const QList<QlomRelationship> &relationships,
     const QFlags<QlomTableFlags> &flags) :
-    theDisplayName(displayName),
-    theTableName(tableName),
-    theRelationships(relationships),
-    theFlags(flags)
-{}
+    theData(std::make_shared<SharedData>())
+{
+    theData->theDisplayName = displayName;
+    theData->theTableName = tableName;
+    theData->theRelationships = relationships;
+    theData->theFlags = flags;
+    theData->theDocument = 0;
+    theData->theDisplayNameFlag = true;
+    theData->theRelationshipsFlag = true;
+    theData->theListLayoutFlag = false;
+}
+
+QlomTable::QlomTable(const QString &tableName, const QString &displayName,
+    const QFlags<QlomTableFlags> &flags) :
+    theData(std::make_shared<SharedData>())
+{
+    theData->theDisplayName = displayName;
+    theData->theTableName = tableName;
+    theData->theFlags = flags;
+    theData->theDocument = 0;
+    theData->theDisplayNameFlag = true;
+    theData->theRelationshipsFlag = false;
+    theData->theListLayoutFlag = false;
+}
+
+QlomTable::QlomTable(const QString &tableName,
+    const QFlags<QlomTableFlags> &flags, const Glom::Document *document) :
+    theData(std::make_shared<SharedData>())
+{
+    theData->theTableName = tableName;
+    theData->theFlags = flags;
+    theData->theDocument = document;
+    theData->theDisplayNameFlag = false;
+    theData->theRelationshipsFlag = false;
+    theData->theListLayoutFlag = false;
+}
 
 QString QlomTable::displayName() const
 {
-    return theDisplayName;
+    if (!theData->theDisplayNameFlag && theData->theDocument) {
+        theData->theDisplayName = ustringToQstring(
+            theData->theDocument->get_table_title(
+                qstringToUstring(theData->theTableName),
+                getCurrentLocaleId()));
+        theData->theDisplayNameFlag = true;
+    }
+
+    return theData->theDisplayName;
 }
 
 QString QlomTable::tableName() const
 {
-    return theTableName;
+    return theData->theTableName;
 }
 
 QList<QlomRelationship> QlomTable::relationships() const
 {
-    return theRelationships;
+    if (!theData->theRelationshipsFlag && theData->theDocument) {
+        const Glom::Document::type_vec_relationships documentRelationships(
+            theData->theDocument->get_relationships(
+                qstringToUstring(theData->theTableName)));
+
+        QList<QlomRelationship> relationships;
+        for (Glom::Document::type_vec_relationships::const_iterator iter(
+            documentRelationships.begin());
+            iter != documentRelationships.end(); ++iter) {
+            const std::shared_ptr<const Glom::Relationship>
+                documentRelationship(*iter);
+            relationships.push_back(QlomRelationship(
+                ustringToQstring(documentRelationship->get_name()),
+                ustringToQstring(documentRelationship->get_from_field()),
+                ustringToQstring(documentRelationship->get_to_table()),
+                ustringToQstring(documentRelationship->get_to_field())));
+        }
+
+        theData->theRelationships = relationships;
+        theData->theRelationshipsFlag = true;
+    }
+
+    return theData->theRelationships;
+}
+
+bool QlomTable::relationshipsLoaded() const
+{
+    return theData->theRelationshipsFlag;
+}
+
+Glom::Document::type_list_layout_groups QlomTable::listLayoutGroups() const
+{
+    if (!theData->theListLayoutFlag && theData->theDocument) {
+        theData->theListLayout = theData->theDocument->get_data_layout_groups(
+            "list", qstringToUstring(theData->theTableName));
+        theData->theListLayoutFlag = true;
+    }
+
+    return theData->theListLayout;
 }
 
 bool QlomTable::isHidden() const
 {
-    return (theFlags & HIDDEN_TABLE);
+    return (theData->theFlags & HIDDEN_TABLE);
 }
 
 bool QlomTable::isDefault() const
 {
-    return (theFlags & DEFAULT_TABLE);
+    return (theData->theFlags & DEFAULT_TABLE);
+}
+
+void QlomTable::setDocument(const Glom::Document *document)
+{
+    theData->theDocument = document;
 }
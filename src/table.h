@@ -21,16 +21,28 @@
 
 #include "relationship.h"
 
+#include <memory>
+
 #include <QList>
 #include <QString>
 
+#include <libglom/document/document.h>
+
 /** A table in a Glom document.
- *  Designed for use in a QlomDocument, QlomTable has four construct-time
- *  properties: the name, the display name, a list of relationships and the
- *  flags. The properties cannot be changed once a table has been constructed,
- *  but can be accessed with the displayName(), tableName() and relationships()
+ *  Designed for use in a QlomDocument, QlomTable has four properties: the
+ *  name, the display name, a list of relationships and the flags. The
+ *  properties cannot be changed once a table has been constructed, but can be
+ *  accessed with the displayName(), tableName() and relationships()
  *  methods, and the flags can be checked with the isHidden() and isDefault()
- *  methods. */
+ *  methods. The list layout of the table is available with
+ *  listLayoutGroups().
+ *  A table can be constructed as a lightweight index entry, with just the
+ *  name and flags and the Glom document. The display name, the relationships
+ *  and the list layout are then read from the document on first access, so
+ *  that opening a document with hundreds of tables only costs time for the
+ *  tables that are used. Copies of a QlomTable share that data, so anything
+ *  read through one copy is available to all of them. Because of that, a
+ *  QlomTable must only be used from the GUI thread. */
 class QlomTable
 {
 
@@ -42,7 +54,7 @@ public:
         DEFAULT_TABLE = 2 /**< default table */
     };
 
-    /** A table in a Glom document.
+    /** A table in a Glom document, with all properties known.
      *  @param[in] tableName the name of the table in the database
      *  @param[in] displayName the name of the table for display
      *  @param[in] relationships a list of relationships
@@ -51,6 +63,23 @@ public:
         const QList<QlomRelationship> &relationships,
         const QFlags<QlomTableFlags> &flags);
 
+    /** A table in a Glom document, whose relationships are read from the
+     *  document on first access. The document must be set with
+     *  setDocument() before that.
+     *  @param[in] tableName the name of the table in the database
+     *  @param[in] displayName the name of the table for display
+     *  @param[in] flags flags for the table */
+    QlomTable(const QString &tableName, const QString &displayName,
+        const QFlags<QlomTableFlags> &flags);
+
+    /** A table in a Glom document, whose display name and relationships are
+     *  read from the document on first access.
+     *  @param[in] tableName the name of the table in the database
+     *  @param[in] flags flags for the table
+     *  @param[in] document the document to read the table from */
+    QlomTable(const QString &tableName, const QFlags<QlomTableFlags> &flags,
+        const Glom::Document *document);
+
     /** Get the table name for display to the user.
      *  @returns the name of the table for display */
     QString displayName() const;
@@ -63,6 +92,15 @@ public:
      *  @returns the list of relationships */
     QList<QlomRelationship> relationships() const;
 
+    /** Whether the relationships have been read already, so that
+     *  relationships() does not need the document. */
+    bool relationshipsLoaded() const;
+
+    /** Get the list layout of the table.
+     *  @returns the layout groups of the list layout, or an empty list if no
+     *  document is set */
+    Glom::Document::type_list_layout_groups listLayoutGroups() const;
+
     /** Predicate to check for hidden flag.
      *  @returns whether the table is a hidden table */
     bool isHidden() const;
@@ -71,11 +109,29 @@ public:
      *  @returns whether the table is the default table */
     bool isDefault() const;
 
+    /** Set the document to read the table from, for all copies of the
+     *  table. Properties that have been read already are kept.
+     *  @param[in] document the document, or 0 once it is destroyed */
+    void setDocument(const Glom::Document *document);
+
 private:
-    QString theDisplayName; /**< the table name, for display to the user */
-    QString theTableName; /**< the table name, as in the database */
-    QList<QlomRelationship> theRelationships; /**< a list of relationships */
-    QFlags<QlomTableFlags> theFlags; /**< flags for default or hidden tables */
+    /** The properties of a table, shared by all copies of it. */
+    struct SharedData {
+        QString theDisplayName; /**< the table name, for display to the user */
+        QString theTableName; /**< the table name, as in the database */
+        QList<QlomRelationship> theRelationships; /**< a list of relationships */
+        Glom::Document::type_list_layout_groups theListLayout; /**< the list
+                                                                    layout */
+        QFlags<QlomTableFlags> theFlags; /**< flags for default or hidden
+                                              tables */
+        const Glom::Document *theDocument; /**< the document to read the
+                                                other properties from */
+        bool theDisplayNameFlag; /**< whether theDisplayName was read */
+        bool theRelationshipsFlag; /**< whether theRelationships were read */
+        bool theListLayoutFlag; /**< whether theListLayout was read */
+    };
+
+    std::shared_ptr<SharedData> theData; /**< the shared properties */
 };
 
-#endif /* QLOM_DOCUMENT_H_ */
+#endif /* QLOM_TABLE_H_ */
@@ -0,0 +1,85 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "table_registry.h"
+
+QlomTableRegistry::QlomTableRegistry() :
+    theDisplayNameIndexFlag(false)
+{}
+
+void QlomTableRegistry::addTable(const QlomTable &table)
+{
+    theNameIndex.insert(table.tableName(), theTables.size());
+    theTables.push_back(table);
+    theDisplayNameIndexFlag = false;
+}
+
+int QlomTableRegistry::count() const
+{
+    return theTables.size();
+}
+
+const QlomTable & QlomTableRegistry::at(int index) const
+{
+    return theTables.at(index);
+}
+
+int QlomTableRegistry::indexOfName(const QString &tableName) const
+{
+    return theNameIndex.value(tableName, -1);
+}
+
+int QlomTableRegistry::indexOfDisplayName(const QString &displayName) const
+{
+    if (!theDisplayNameIndexFlag) {
+        theDisplayNameIndex.clear();
+        theDisplayNameIndex.reserve(theTables.size());
+
+        // Iterate backwards, so that the first of equal display names wins.
+        for (int index = theTables.size() - 1; index >= 0; --index) {
+            theDisplayNameIndex.insert(theTables.at(index).displayName(),
+                index);
+        }
+        theDisplayNameIndexFlag = true;
+    }
+
+    return theDisplayNameIndex.value(displayName, -1);
+}
+
+const QlomTable * QlomTableRegistry::findByName(const QString &tableName) const
+{
+    const int index = indexOfName(tableName);
+    return (-1 == index ? 0 : &theTables.at(index));
+}
+
+QList<QlomTable> QlomTableRegistry::tables() const
+{
+    return theTables.toList();
+}
+
+void QlomTableRegistry::setDocument(const Glom::Document *document)
+{
+    for (QVector<QlomTable>::iterator iter = theTables.begin();
+         iter != theTables.end();
+         ++iter) {
+        (*iter).setDocument(document);
+    }
+
+    // Titles read from another document might differ.
+    theDisplayNameIndexFlag = false;
+}
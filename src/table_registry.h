@@ -0,0 +1,88 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_TABLE_REGISTRY_H_
+#define QLOM_TABLE_REGISTRY_H_
+
+#include "table.h"
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/** The tables of a Glom document, each owned once.
+ *  QlomDocument fills a registry when a document is loaded, and shares it
+ *  with the models that need the table list, rather than copying the list
+ *  into each of them. Tables can be looked up by position, which is also
+ *  their row in QlomTablesModel, and in constant time by table name or by
+ *  display name.
+ *  The display name index is built on first use, because the display names
+ *  of lazily read tables are only read from the document when needed. */
+class QlomTableRegistry
+{
+public:
+    /** Create an empty registry. */
+    QlomTableRegistry();
+
+    /** Add a table at the end of the registry.
+     *  @param[in] table the table to add */
+    void addTable(const QlomTable &table);
+
+    /** Get the number of tables.
+     *  @returns the number of tables in the registry */
+    int count() const;
+
+    /** Get a table by position.
+     *  @param[in] index a position, from 0 to count() - 1
+     *  @returns the table */
+    const QlomTable & at(int index) const;
+
+    /** Find a table by the name it has in the database.
+     *  @param[in] tableName the table name
+     *  @returns the position of the table, or -1 if there is none */
+    int indexOfName(const QString &tableName) const;
+
+    /** Find a table by the name it has for display to the user.
+     *  @param[in] displayName the display name
+     *  @returns the position of the table, or -1 if there is none */
+    int indexOfDisplayName(const QString &displayName) const;
+
+    /** Find a table by the name it has in the database.
+     *  @param[in] tableName the table name
+     *  @returns the table, or 0 if there is none */
+    const QlomTable * findByName(const QString &tableName) const;
+
+    /** Get a copy of all tables, in order, for instance to save them.
+     *  @returns the tables */
+    QList<QlomTable> tables() const;
+
+    /** Set the document to read lazy table properties from, for all tables.
+     *  @param[in] document the document, or 0 once it is destroyed */
+    void setDocument(const Glom::Document *document);
+
+private:
+    QVector<QlomTable> theTables; /**< the tables, in document order */
+    QHash<QString, int> theNameIndex; /**< positions by table name */
+    mutable QHash<QString, int> theDisplayNameIndex; /**< positions by
+                                                          display name */
+    mutable bool theDisplayNameIndexFlag; /**< whether theDisplayNameIndex
+                                               is up to date */
+};
+
+#endif /* QLOM_TABLE_REGISTRY_H_ */
@@ -18,16 +18,23 @@
 
 #include "tables_model.h"
 
-QlomTablesModel::QlomTablesModel(QList<QlomTable> tableList, QObject *parent) :
+QlomTablesModel::QlomTablesModel(
+    const std::shared_ptr<const QlomTableRegistry> &tables, QObject *parent) :
     QAbstractListModel(parent),
-    theTableList(tableList)
+    theTables(tables)
 {
+    Q_ASSERT(theTables);
+}
+
+int QlomTablesModel::rowOfTable(const QString &tableName) const
+{
+    return theTables->indexOfName(tableName);
 }
 
 int QlomTablesModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    return theTableList.length();
+    return theTables->count();
 }
 
 QVariant QlomTablesModel::data(const QModelIndex &index, int role) const
@@ -35,15 +42,15 @@ QVariant QlomTablesModel::data(const QModelIndex &index, int role) const
     if(!index.isValid()) {
         return QVariant();
     }
-    if(index.row() >= theTableList.length()) {
+    if(index.row() >= theTables->count()) {
         return QVariant();
     }
     switch(role) {
     case Qt::DisplayRole:
-        return theTableList.at(index.row()).displayName();
+        return theTables->at(index.row()).displayName();
         break;
     case Qlom::TableNameRole:
-        return theTableList.at(index.row()).tableName();
+        return theTables->at(index.row()).tableName();
         break;
     default:
         return QVariant();
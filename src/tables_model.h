@@ -19,10 +19,11 @@
 #ifndef QLOM_TABLES_MODEL_H_
 #define QLOM_TABLES_MODEL_H_
 
-#include "table.h"
+#include "table_registry.h"
+
+#include <memory>
 
 #include <QAbstractListModel>
-#include <QList>
 #include <QStringList>
 
 namespace Qlom
@@ -36,23 +37,28 @@ enum TablesModelRoles {
 } // namespace Qlom
 
 /** A model of the tables in a Glom document.
- *  The model contains a list of Table objects, which contain both the name of
- *  the tables for display to the user and for accessing the database.
- *  Currently, the QlomTable list is not stored in the model, and is only used
- *  for populating the model with data at construction time. */
+ *  The model refers to the QlomTableRegistry of the document, whose tables
+ *  contain both the name of the tables for display to the user and for
+ *  accessing the database. The registry is shared, not copied, and each row
+ *  of the model is the table at the same position in the registry. */
 class QlomTablesModel : public QAbstractListModel
 {
     Q_OBJECT
 
 public:
     /** Construct a new model from a Glom document.
-     *  @param[in] tableList a list of QlomTable objects to read information
-     *  from
+     *  @param[in] tables the registry of the tables to read information from
      *  @param[in] parent a parent QObject, that will take ownership of the
      *  model */
-    explicit QlomTablesModel(const QList<QlomTable> tableList,
+    explicit QlomTablesModel(
+        const std::shared_ptr<const QlomTableRegistry> &tables,
         QObject *parent = 0);
 
+    /** Find the row of a table.
+     *  @param[in] tableName the name of the table in the database
+     *  @returns the row of the table, or -1 if there is none */
+    int rowOfTable(const QString &tableName) const;
+
     /** Calculate the number of rows in the model.
      *  @param[in] parent the parent index in the heirarchy
      *  @returns the number of rows in the model */
@@ -73,8 +79,9 @@ public:
         int role = Qt::DisplayRole) const;
 
 private:
-    QList<QlomTable> theTableList; /**< the list of tables in the Glom
-                                    *   document */
+    std::shared_ptr<const QlomTableRegistry> theTables; /**< the tables in
+                                                             the Glom
+                                                             document */
 };
 
 #endif /* QLOM_TABLES_MODEL_H_ */
@@ -0,0 +1,335 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+/** The number of events kept per thread. Older events are overwritten. */
+static const int eventsPerThread = 65536;
+
+/** The number of buffers of finished threads that are kept, so that the
+ *  events of short-lived threads such as document loaders can be saved. */
+static const int maxFinishedBuffers = 8;
+
+namespace
+{
+
+/** The ring buffer of one thread. Its mutex is only contended while the
+ *  events are saved or cleared. */
+struct ThreadBuffer
+{
+    QMutex mutex;
+    QVector<QlomTraceEvent> events;
+    int next; /**< the position of the next event */
+    bool wrappedFlag; /**< whether events have been overwritten */
+    bool finishedFlag; /**< whether the thread has finished */
+    quint64 threadId;
+    QString threadName;
+};
+
+/** Owns the buffer of a thread, and marks it as finished when the thread
+ *  finishes. */
+struct ThreadBufferHolder
+{
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadBufferHolder()
+    {
+        if (buffer) {
+            QMutexLocker locker(&buffer->mutex);
+            buffer->finishedFlag = true;
+        }
+    }
+};
+
+/** The monotonic clock of the trace, started on first use. */
+struct TraceClock
+{
+    TraceClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+
+} // namespace
+
+/** Whether recording is enabled. */
+static QAtomicInt enabledFlag(0);
+
+static TraceClock & traceClock()
+{
+    static TraceClock clock;
+    return clock;
+}
+
+static QMutex & registryMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+/** The buffers of all threads that have recorded events. */
+static QList<std::shared_ptr<ThreadBuffer> > & registry()
+{
+    static QList<std::shared_ptr<ThreadBuffer> > buffers;
+    return buffers;
+}
+
+/** Forget the buffers of finished threads, keeping the most recent ones.
+ *  registryMutex() must be locked.
+ *  @param[in] keep the number of buffers of finished threads to keep */
+static void pruneFinishedBuffers(int keep)
+{
+    QList<std::shared_ptr<ThreadBuffer> > &buffers = registry();
+    int finished = 0;
+    for (int index = buffers.size() - 1; index >= 0; --index) {
+        bool finishedFlag = false;
+        {
+            QMutexLocker locker(&buffers.at(index)->mutex);
+            finishedFlag = buffers.at(index)->finishedFlag;
+        }
+
+        if (finishedFlag && ++finished > keep) {
+            buffers.removeAt(index);
+        }
+    }
+}
+
+static ThreadBuffer & threadBuffer()
+{
+    static thread_local ThreadBufferHolder holder;
+    if (!holder.buffer) {
+        std::shared_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+        buffer->events.resize(eventsPerThread);
+        buffer->next = 0;
+        buffer->wrappedFlag = false;
+        buffer->finishedFlag = false;
+
+        QThread *thread = QThread::currentThread();
+        buffer->threadId = reinterpret_cast<quintptr>(
+            QThread::currentThreadId());
+        if (QCoreApplication::instance()
+            && thread == QCoreApplication::instance()->thread()) {
+            buffer->threadName = QLatin1String("GUI thread");
+        } else if (!thread->objectName().isEmpty()) {
+            buffer->threadName = thread->objectName();
+        } else {
+            buffer->threadName =
+                QString::fromLatin1(thread->metaObject()->className());
+        }
+
+        QMutexLocker locker(&registryMutex());
+        pruneFinishedBuffers(maxFinishedBuffers);
+        registry().push_back(buffer);
+        holder.buffer = buffer;
+    }
+
+    return *holder.buffer;
+}
+
+void QlomTrace::setEnabled(bool enabled)
+{
+    // Start the clock now, rather than on the first event.
+    traceClock();
+    enabledFlag.storeRelease(enabled ? 1 : 0);
+}
+
+bool QlomTrace::isEnabled()
+{
+    return enabledFlag.loadAcquire() != 0;
+}
+
+qint64 QlomTrace::now()
+{
+    return traceClock().timer.nsecsElapsed();
+}
+
+/** Whether an event began before another one, to sort events by time.
+ *  @param[in] first an event
+ *  @param[in] second another event
+ *  @returns true if first began earlier */
+static bool beganEarlier(const QlomTraceEvent &first,
+    const QlomTraceEvent &second)
+{
+    return first.beginNsecs < second.beginNsecs;
+}
+
+void QlomTrace::record(const char *name, const char *category,
+    qint64 beginNsecs, qint64 endNsecs)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    QMutexLocker locker(&buffer.mutex);
+
+    QlomTraceEvent &event = buffer.events[buffer.next];
+    event.name = name;
+    event.category = category;
+    event.beginNsecs = beginNsecs;
+    event.endNsecs = endNsecs;
+
+    if (++buffer.next == buffer.events.size()) {
+        buffer.next = 0;
+        buffer.wrappedFlag = true;
+    }
+}
+
+void QlomTrace::recordInstant(const char *name, const char *category,
+    qint64 nsecs)
+{
+    record(name, category, nsecs, -1);
+}
+
+QVector<QlomTraceEvent> QlomTrace::events(const char *category)
+{
+    QList<std::shared_ptr<ThreadBuffer> > buffers;
+    {
+        QMutexLocker locker(&registryMutex());
+        buffers = registry();
+    }
+
+    QVector<QlomTraceEvent> events;
+    for (QList<std::shared_ptr<ThreadBuffer> >::const_iterator iter =
+             buffers.begin();
+         iter != buffers.end();
+         ++iter) {
+        ThreadBuffer &buffer = **iter;
+        QMutexLocker locker(&buffer.mutex);
+
+        const int count = (buffer.wrappedFlag ? buffer.events.size()
+            : buffer.next);
+        for (int index = 0; index < count; ++index) {
+            const QlomTraceEvent &event = buffer.events.at(index);
+            if (0 == std::strcmp(event.category, category)) {
+                events.push_back(event);
+            }
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), beganEarlier);
+    return events;
+}
+
+bool QlomTrace::save(const QString &filepath)
+{
+    QList<std::shared_ptr<ThreadBuffer> > buffers;
+    {
+        QMutexLocker locker(&registryMutex());
+        buffers = registry();
+    }
+
+    const QByteArray pid =
+        QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool firstEventFlag = true;
+
+    for (QList<std::shared_ptr<ThreadBuffer> >::const_iterator iter =
+             buffers.begin();
+         iter != buffers.end();
+         ++iter) {
+        ThreadBuffer &buffer = **iter;
+        QMutexLocker locker(&buffer.mutex);
+
+        const QByteArray tid = QByteArray::number(buffer.threadId);
+        if (!firstEventFlag) {
+            json += ',';
+        }
+        firstEventFlag = false;
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid
+            + ",\"tid\":" + tid + ",\"args\":{\"name\":\""
+            + buffer.threadName.toUtf8() + "\"}}";
+
+        // Oldest first, so that the events are in order.
+        const int count = (buffer.wrappedFlag ? buffer.events.size()
+            : buffer.next);
+        const int first = (buffer.wrappedFlag ? buffer.next : 0);
+        for (int offset = 0; offset < count; ++offset) {
+            const QlomTraceEvent &event =
+                buffer.events.at((first + offset) % buffer.events.size());
+            json += ",{\"name\":\"";
+            json += event.name;
+            json += "\",\"cat\":\"";
+            json += event.category;
+            json += "\",\"ts\":";
+            json += QByteArray::number(event.beginNsecs / 1.0e3, 'f', 3);
+            // Points in time are instant events of the whole process.
+            if (-1 == event.endNsecs) {
+                json += ",\"ph\":\"i\",\"s\":\"p\"";
+            } else {
+                json += ",\"ph\":\"X\",\"dur\":";
+                json += QByteArray::number(
+                    (event.endNsecs - event.beginNsecs) / 1.0e3, 'f', 3);
+            }
+            json += ",\"pid\":" + pid + ",\"tid\":" + tid + '}';
+        }
+    }
+    json += "]}";
+
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to open the trace file %s", qPrintable(filepath));
+        return false;
+    }
+
+    file.write(json);
+    if (!file.commit()) {
+        qWarning("Failed to write the trace file %s", qPrintable(filepath));
+        return false;
+    }
+
+    return true;
+}
+
+void QlomTrace::clear()
+{
+    QMutexLocker locker(&registryMutex());
+    pruneFinishedBuffers(0);
+
+    QList<std::shared_ptr<ThreadBuffer> > &buffers = registry();
+    for (QList<std::shared_ptr<ThreadBuffer> >::const_iterator iter =
+             buffers.begin();
+         iter != buffers.end();
+         ++iter) {
+        QMutexLocker bufferLocker(&(*iter)->mutex);
+        (*iter)->next = 0;
+        (*iter)->wrappedFlag = false;
+    }
+}
+
+QlomTraceScope::QlomTraceScope(const char *name, const char *category) :
+    theName(name),
+    theCategory(category),
+    theBeginNsecs(QlomTrace::isEnabled() ? QlomTrace::now() : -1)
+{}
+
+QlomTraceScope::~QlomTraceScope()
+{
+    if (-1 != theBeginNsecs) {
+        QlomTrace::record(theName, theCategory, theBeginNsecs,
+            QlomTrace::now());
+    }
+}
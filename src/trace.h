@@ -0,0 +1,121 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_TRACE_H_
+#define QLOM_TRACE_H_
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+/** An event recorded by QlomTrace. */
+struct QlomTraceEvent
+{
+    const char *name; /**< the name, a string literal */
+    const char *category; /**< the category, a string literal */
+    qint64 beginNsecs; /**< the start, from QlomTrace::now() */
+    qint64 endNsecs; /**< the end from QlomTrace::now(), or -1 for a point
+                          in time */
+};
+
+/** Records trace events in the hot paths of Qlom, such as building and
+ *  running queries, fetching rows and painting cells.
+ *  Each thread records into its own ring buffer, so recording never waits for
+ *  another thread, and only the most recent events are kept. The events can
+ *  be written at any time with save(), in the Chrome trace event format,
+ *  which chrome://tracing and Perfetto can open.
+ *  Tracing is disabled by default, in which case recording only checks a
+ *  flag. It is enabled by the --trace command line option, and by
+ *  QlomStartupProfiler, which records the startup phases as events of the
+ *  "startup" category, on the same clock. */
+class QlomTrace
+{
+public:
+    /** Enable or disable recording. Events recorded so far are kept.
+     *  @param[in] enabled whether to record events */
+    static void setEnabled(bool enabled);
+
+    /** Whether events are being recorded. */
+    static bool isEnabled();
+
+    /** Get the time since the clock of the trace started, for timestamps.
+     *  @returns the time in nanoseconds */
+    static qint64 now();
+
+    /** Record an event that has completed.
+     *  @param[in] name the name of the event, which must be a string literal
+     *  @param[in] category the category of the event, which must be a string
+     *  literal
+     *  @param[in] beginNsecs the start of the event, from now()
+     *  @param[in] endNsecs the end of the event, from now() */
+    static void record(const char *name, const char *category,
+        qint64 beginNsecs, qint64 endNsecs);
+
+    /** Record a point in time, such as the first paint of a widget.
+     *  @param[in] name the name of the event, which must be a string literal
+     *  @param[in] category the category of the event, which must be a string
+     *  literal
+     *  @param[in] nsecs the time of the event, from now() */
+    static void recordInstant(const char *name, const char *category,
+        qint64 nsecs);
+
+    /** Get the events of a category that are still in the buffers of all
+     *  threads.
+     *  @param[in] category the category
+     *  @returns the events, in the order they began */
+    static QVector<QlomTraceEvent> events(const char *category);
+
+    /** Write the events of all threads to a file, as Chrome trace JSON.
+     *  @param[in] filepath the file to write
+     *  @returns true on success, false on failure */
+    static bool save(const QString &filepath);
+
+    /** Discard the events of all threads. */
+    static void clear();
+};
+
+/** Records a trace event for the lifetime of the object. Use the
+ *  QLOM_TRACE_SCOPE() macro rather than this class. */
+class QlomTraceScope
+{
+public:
+    /** Begin an event, if tracing is enabled.
+     *  @param[in] name the name of the event, which must be a string literal
+     *  @param[in] category the category of the event, which must be a string
+     *  literal */
+    QlomTraceScope(const char *name, const char *category);
+
+    /** End the event. */
+    ~QlomTraceScope();
+
+private:
+    Q_DISABLE_COPY(QlomTraceScope)
+
+    const char *theName; /**< the name of the event */
+    const char *theCategory; /**< the category of the event */
+    qint64 theBeginNsecs; /**< the start of the event, or -1 if disabled */
+};
+
+#define QLOM_TRACE_CONCAT_(a, b) a##b
+#define QLOM_TRACE_CONCAT(a, b) QLOM_TRACE_CONCAT_(a, b)
+
+/** Record a trace event from here to the end of the enclosing scope. */
+#define QLOM_TRACE_SCOPE(name, category) \
+    QlomTraceScope QLOM_TRACE_CONCAT(qlomTraceScope, __LINE__)(name, category)
+
+#endif /* QLOM_TRACE_H_ */
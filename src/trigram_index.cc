@@ -0,0 +1,260 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trigram_index.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iterator>
+
+/** The texts indexed between checks for a cancellation and progress
+ *  reports. */
+static const int textsPerCheck = 8192;
+
+/** The size ratio of two posting lists above which the shorter one is
+ *  intersected by binary searches in the longer one, rather than by merging
+ *  them. */
+static const int gallopingRatio = 16;
+
+/** The memory used by an entry of a QHash and the header of its QVector,
+ *  besides the postings. */
+static const qint64 postingListHeaderBytes = 56;
+
+/** Get the distinct trigrams of a text.
+ *  @param[in] text the text
+ *  @returns the trigrams of the case-folded text, each as three UTF-16 code
+ *  units, in ascending order */
+static QVector<quint64> trigrams(const QString &text)
+{
+    const QString folded = text.toCaseFolded();
+    QVector<quint64> keys;
+    if (folded.size() < 3) {
+        return keys;
+    }
+
+    keys.reserve(folded.size() - 2);
+    const QChar *data = folded.constData();
+    for (int position = 0; position + 2 < folded.size(); ++position) {
+        keys.push_back((quint64(data[position].unicode()) << 32)
+            | (quint64(data[position + 1].unicode()) << 16)
+            | quint64(data[position + 2].unicode()));
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+/** Whether a posting list is shorter than another. */
+static bool isShorter(const QVector<qint32> *lhs, const QVector<qint32> *rhs)
+{
+    return lhs->size() < rhs->size();
+}
+
+QlomTrigramIndex::QlomTrigramIndex()
+{}
+
+bool QlomTrigramIndex::canLookUp(const QString &query)
+{
+    return (3 <= query.toCaseFolded().size());
+}
+
+bool QlomTrigramIndex::isBuiltFrom(
+    const QVector<QlomFilterColumn> &columns) const
+{
+    if (columns.size() != theColumns.size()) {
+        return false;
+    }
+
+    /* Appending rows detaches the codes from the copy kept here, so sharing
+     * their data and their rows is enough. */
+    for (int column = 0; column < columns.size(); ++column) {
+        if (columns.at(column).codes().constData()
+                != theColumns.at(column).codes().constData()
+            || columns.at(column).rowCount()
+                != theColumns.at(column).rowCount()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QVector<QVector<qint32> > QlomTrigramIndex::lookup(
+    const QString &query) const
+{
+    QLOM_TRACE_SCOPE("look up trigrams", "search");
+    QVector<QVector<qint32> > codes(theColumns.size());
+
+    // The shortest lists come first, so that the result shrinks quickly.
+    QVector<const QVector<qint32> *> lists;
+    const QVector<quint64> keys = trigrams(query);
+    for (QVector<quint64>::const_iterator iter = keys.begin();
+         iter != keys.end();
+         ++iter) {
+        const QHash<quint64, QVector<qint32> >::const_iterator postings =
+            thePostings.constFind(*iter);
+        if (postings == thePostings.constEnd()) {
+            return codes;
+        }
+        lists.push_back(&*postings);
+    }
+
+    if (lists.isEmpty()) {
+        return codes;
+    }
+
+    std::sort(lists.begin(), lists.end(), isShorter);
+
+    QVector<qint32> ids = *lists.first();
+    for (int list = 1; list < lists.size() && !ids.isEmpty(); ++list) {
+        const QVector<qint32> &postings = *lists.at(list);
+        QVector<qint32> common;
+        if (postings.size() > gallopingRatio * ids.size()) {
+            for (QVector<qint32>::const_iterator iter = ids.begin();
+                 iter != ids.end();
+                 ++iter) {
+                if (std::binary_search(postings.begin(), postings.end(),
+                    *iter)) {
+                    common.push_back(*iter);
+                }
+            }
+        } else {
+            std::set_intersection(ids.begin(), ids.end(), postings.begin(),
+                postings.end(), std::back_inserter(common));
+        }
+        ids = common;
+    }
+
+    // The ids are ascending, and so are the offsets of the columns.
+    int column = 0;
+    for (QVector<qint32>::const_iterator iter = ids.begin();
+         iter != ids.end();
+         ++iter) {
+        while (column + 1 < theOffsets.size()
+               && theOffsets.at(column + 1) <= *iter) {
+            ++column;
+        }
+        codes[column].push_back(*iter - theOffsets.at(column));
+    }
+
+    return codes;
+}
+
+qint64 QlomTrigramIndex::bytes() const
+{
+    qint64 bytes = sizeof(QlomTrigramIndex)
+        + theOffsets.capacity() * sizeof(qint32)
+        + thePostings.capacity() * sizeof(void *);
+    for (QHash<quint64, QVector<qint32> >::const_iterator iter =
+             thePostings.begin();
+         iter != thePostings.end();
+         ++iter) {
+        bytes += postingListHeaderBytes
+            + (*iter).capacity() * sizeof(qint32);
+    }
+
+    return bytes;
+}
+
+QlomTrigramIndexBuilder::QlomTrigramIndexBuilder(
+    const QVector<QlomFilterColumn> &columns, QObject *parent) :
+    QThread(parent),
+    theColumns(columns),
+    theCancelledFlag(0)
+{}
+
+QlomTrigramIndexBuilder::~QlomTrigramIndexBuilder()
+{}
+
+void QlomTrigramIndexBuilder::cancel()
+{
+    theCancelledFlag.storeRelease(1);
+}
+
+bool QlomTrigramIndexBuilder::isCancelled() const
+{
+    return (0 != theCancelledFlag.loadAcquire());
+}
+
+std::shared_ptr<const QlomTrigramIndex> QlomTrigramIndexBuilder::takeIndex()
+{
+    std::shared_ptr<const QlomTrigramIndex> index;
+    if (!isCancelled()) {
+        index = theIndex;
+    }
+
+    theIndex.reset();
+    return index;
+}
+
+void QlomTrigramIndexBuilder::run()
+{
+    QLOM_TRACE_SCOPE("build trigram index", "search");
+    std::shared_ptr<QlomTrigramIndex> index =
+        std::make_shared<QlomTrigramIndex>();
+    index->theColumns = theColumns;
+
+    qint32 textCount = 0;
+    for (QVector<QlomFilterColumn>::const_iterator iter = theColumns.begin();
+         iter != theColumns.end();
+         ++iter) {
+        index->theOffsets.push_back(textCount);
+        textCount += (*iter).texts().size();
+    }
+
+    // Ids are added in ascending order, so the lists stay sorted.
+    qint32 id = 0;
+    int lastPercent = -1;
+    for (QVector<QlomFilterColumn>::const_iterator iter = theColumns.begin();
+         iter != theColumns.end();
+         ++iter) {
+        const QVector<QString> &texts = (*iter).texts();
+        for (int code = 0; code < texts.size(); ++code, ++id) {
+            if (0 == id % textsPerCheck) {
+                if (isCancelled()) {
+                    return;
+                }
+
+                const int percent = int(qint64(100) * id / textCount);
+                if (percent != lastPercent) {
+                    Q_EMIT progressChanged(percent);
+                    lastPercent = percent;
+                }
+            }
+
+            const QVector<quint64> keys = trigrams(texts.at(code));
+            for (QVector<quint64>::const_iterator key = keys.begin();
+                 key != keys.end();
+                 ++key) {
+                index->thePostings[*key].push_back(id);
+            }
+        }
+    }
+
+    // The lists grew by doubling, which would waste a quarter of them.
+    for (QHash<quint64, QVector<qint32> >::iterator iter =
+             index->thePostings.begin();
+         iter != index->thePostings.end();
+         ++iter) {
+        (*iter).squeeze();
+    }
+
+    Q_EMIT progressChanged(100);
+    theIndex = index;
+}
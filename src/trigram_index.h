@@ -0,0 +1,125 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_TRIGRAM_INDEX_H_
+#define QLOM_TRIGRAM_INDEX_H_
+
+#include "row_filter.h"
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+/** An index of the trigrams of the distinct texts of some dictionary-encoded
+ *  columns, for contains-searches. Each sequence of three case-folded
+ *  characters of a text has a posting list of the texts that contain it, in
+ *  ascending order. lookup() intersects the lists of the trigrams of a
+ *  query, shortest first, which leaves the few texts that may contain the
+ *  query, so that only they need to be compared with it.
+ *  The texts are indexed rather than the rows, since the dictionary already
+ *  maps the rows to their texts: the memory grows with the distinct text,
+ *  not with the rows. Each posting costs four bytes, and each text has
+ *  about one posting per character, so the postings cost about four bytes
+ *  per character of distinct text. Each distinct trigram costs about 60
+ *  bytes more, for its entry and its list. A million contacts with 60
+ *  characters of distinct text each thus cost about 250 MB, which is why the
+ *  index is only built on request. bytes() gives the actual cost. */
+class QlomTrigramIndex
+{
+public:
+    /** Create an empty index. */
+    QlomTrigramIndex();
+
+    /** Whether lookup() can narrow down the texts for a query, which needs
+     *  at least one trigram.
+     *  @param[in] query the query */
+    static bool canLookUp(const QString &query);
+
+    /** Whether the index was built from the same extraction of the columns,
+     *  so that its codes are theirs.
+     *  @param[in] columns the columns
+     *  @returns true if the codes match */
+    bool isBuiltFrom(const QVector<QlomFilterColumn> &columns) const;
+
+    /** Find the texts that may contain a query.
+     *  @param[in] query the query, of which canLookUp() must be true
+     *  @returns the codes of the texts of each column that contain all
+     *  trigrams of the query, in ascending order */
+    QVector<QVector<qint32> > lookup(const QString &query) const;
+
+    /** Get the memory used by the index.
+     *  @returns the memory in bytes */
+    qint64 bytes() const;
+
+private:
+    friend class QlomTrigramIndexBuilder;
+
+    QVector<QlomFilterColumn> theColumns; /**< the indexed columns */
+    QVector<qint32> theOffsets; /**< the id of the first text of each
+                                     column; the id of a text is the offset
+                                     of its column plus its code */
+    QHash<quint64, QVector<qint32> > thePostings; /**< the ids of the texts
+                                                       of each trigram */
+};
+
+/** Builds a QlomTrigramIndex on a worker thread, reporting its progress.
+ *  The columns are a copy of QlomListLayoutModel::searchColumns(), whose
+ *  data is implicitly shared and never modified. */
+class QlomTrigramIndexBuilder : public QThread
+{
+    Q_OBJECT
+
+public:
+    /** Create a builder.
+     *  @param[in] columns the columns to index
+     *  @param[in] parent a parent object */
+    explicit QlomTrigramIndexBuilder(const QVector<QlomFilterColumn> &columns,
+        QObject *parent = 0);
+    virtual ~QlomTrigramIndexBuilder();
+
+    /** Ask the builder to stop. This method can be called from any
+     *  thread. */
+    void cancel();
+
+    /** Whether cancel() has been called. */
+    bool isCancelled() const;
+
+    /** Take the index. Only valid once finished() has been emitted.
+     *  @returns the index, or 0 if building was cancelled */
+    std::shared_ptr<const QlomTrigramIndex> takeIndex();
+
+Q_SIGNALS:
+    /** Emitted from the worker thread as the texts are indexed.
+     *  @param[in] percent the share of the texts indexed so far */
+    void progressChanged(int percent);
+
+protected:
+    /** Reimplemented from QThread to build the index. */
+    virtual void run();
+
+private:
+    const QVector<QlomFilterColumn> theColumns; /**< the columns to index */
+    std::shared_ptr<QlomTrigramIndex> theIndex; /**< see takeIndex() */
+    QAtomicInt theCancelledFlag; /**< set by cancel(), from any thread */
+};
+
+#endif /* QLOM_TRIGRAM_INDEX_H_ */
@@ -17,7 +17,14 @@
  */
 
 #include "utils.h"
+#include <QCoreApplication>
 #include <QLocale>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <libglom/init.h>
 
 Glib::ustring qstringToUstring(const QString& qstring)
 {
@@ -37,3 +44,41 @@ std::string getCurrentLocaleId()
 {
     return QLocale().name().toStdString();
 }
+
+/** Protects libglomInitialised. */
+static QMutex libglomMutex;
+
+/** Signalled once libglom has been initialised. */
+static QWaitCondition libglomInitialisedCondition;
+
+/** Whether ensureLibglomInitialised() has initialised libglom. */
+static bool libglomInitialised = false;
+
+void ensureLibglomInitialised()
+{
+    Q_ASSERT(!QCoreApplication::instance()
+        || QThread::currentThread() == QCoreApplication::instance()->thread());
+
+    QMutexLocker locker(&libglomMutex);
+    if(libglomInitialised) {
+        return;
+    }
+
+    // Only the main thread initialises, so waiters need not be blocked.
+    locker.unlock();
+    Glom::libglom_init();
+    locker.relock();
+
+    libglomInitialised = true;
+    libglomInitialisedCondition.wakeAll();
+}
+
+bool waitForLibglom(unsigned long msecs)
+{
+    QMutexLocker locker(&libglomMutex);
+    if(!libglomInitialised) {
+        libglomInitialisedCondition.wait(&libglomMutex, msecs);
+    }
+
+    return libglomInitialised;
+}
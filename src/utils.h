@@ -38,4 +38,19 @@ QString ustringToQstring(const Glib::ustring& ustring);
  */
 std::string getCurrentLocaleId();
 
+/** Initialise libglom, unless it has already been initialised.
+ * This must be called on the main thread, because Glom::libglom_init()
+ * initialises Glib, Gda and Python, which are not documented to support
+ * being initialised from another thread. It must be called before any other
+ * libglom method.
+ */
+void ensureLibglomInitialised();
+
+/** Wait until ensureLibglomInitialised() has been called on the main thread,
+ * so that a worker thread can use libglom.
+ * @param[in] msecs the longest time to wait, in milliseconds
+ * @returns true if libglom is initialised, false if the time ran out
+ */
+bool waitForLibglom(unsigned long msecs);
+
 #endif /* QLOM_UTILS_H_ */
@@ -0,0 +1,202 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_utils.h"
+#include "document.h"
+#include "list_layout_model.h"
+
+#include <iostream>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+
+/** The rows of the first page, about as many as a maximised window shows. */
+static const int firstPageRows = 50;
+
+/** The default number of measurements of each metric. */
+static const int defaultRepetitions = 5;
+
+/** Print the usage of qlom-bench. */
+static void printUsage()
+{
+    std::cout << "Usage: qlom-bench [--repeat=N] [--sort-column=N] "
+                 "[--filter=TEXT] [--output=results.json] document.glom"
+              << std::endl;
+}
+
+/** Get the elapsed time of a timer in milliseconds, with the precision of
+ *  its nanosecond clock.
+ *  @param[in] timer the started timer
+ *  @returns the elapsed time */
+static double elapsedMsecs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+/** Read the display text of rows, as a view does when it paints them.
+ *  @param[in] model the model to read
+ *  @param[in] firstRow the first row to read
+ *  @param[in] lastRow the last row to read */
+static void readRows(const QAbstractItemModel *model, int firstRow,
+    int lastRow)
+{
+    const int columns = model->columnCount();
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            model->data(model->index(row, column)).toString();
+        }
+    }
+}
+
+/** Measure a document once.
+ *  @param[in] filepath the path of the Glom document
+ *  @param[in] sortColumn the column to sort by
+ *  @param[in] filter the text to filter by
+ *  @param[in,out] results the results to add the measurements to
+ *  @returns true on success, false otherwise */
+static bool measure(const QString &filepath, int sortColumn,
+    const QString &filter, QlomBenchResults &results)
+{
+    QlomDocument document;
+    QElapsedTimer timer;
+
+    timer.start();
+    if (!document.loadDocument(filepath)) {
+        std::cerr << "Failed to load " << qPrintable(filepath) << ": "
+                  << qPrintable(document.lastError().what()) << std::endl;
+        return false;
+    }
+    results.addSample("document_load_ms", elapsedMsecs(timer));
+
+    timer.start();
+    QlomListLayoutModel *model = document.createDefaultTableListLayoutModel();
+    if (!model) {
+        std::cerr << "Failed to create the list model: "
+                  << qPrintable(document.lastError().what()) << std::endl;
+        return false;
+    }
+    readRows(model, 0, qMin(0, model->rowCount() - 1));
+    results.addSample("first_row_ms", elapsedMsecs(timer));
+    readRows(model, 1, qMin(firstPageRows, model->rowCount()) - 1);
+    results.addSample("first_page_ms", elapsedMsecs(timer));
+
+    timer.start();
+    while (model->canFetchMore()) {
+        model->fetchMore();
+    }
+    readRows(model, 0, model->rowCount() - 1);
+    results.addSample("full_scan_ms", elapsedMsecs(timer));
+    results.setProperty("rows", model->rowCount());
+    results.setProperty("columns", model->columnCount());
+
+    // Filters in memory, without SQL, if the budget kept every page.
+    const int filterColumn = qBound(0, sortColumn, model->columnCount() - 1);
+    timer.start();
+    if (model->setRowFilter(filterColumn, QlomRowFilter())) {
+        readRows(model, 0, qMin(firstPageRows, model->rowCount()) - 1);
+        results.addSample("row_filter_ms", elapsedMsecs(timer));
+        model->removeRowFilter(filterColumn);
+    }
+
+    {
+        QSortFilterProxyModel proxy;
+        proxy.setSourceModel(model);
+        proxy.setFilterKeyColumn(-1); // All columns.
+
+        timer.start();
+        proxy.setFilterFixedString(filter);
+        readRows(&proxy, 0, qMin(firstPageRows, proxy.rowCount()) - 1);
+        results.addSample("filter_ms", elapsedMsecs(timer));
+        results.setProperty("filtered_rows", proxy.rowCount());
+    }
+
+    // Sorting by a header section of the view sorts the model itself.
+    timer.start();
+    model->sort(qBound(0, sortColumn, model->columnCount() - 1),
+        Qt::AscendingOrder);
+    readRows(model, 0, qMin(firstPageRows, model->rowCount()) - 1);
+    results.addSample("sort_ms", elapsedMsecs(timer));
+
+    delete model;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    // The document is never shown, so do not require a display.
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    int repetitions = defaultRepetitions;
+    int sortColumn = 1;
+    QString filter("Value 1");
+    QString outputFilepath;
+    QString filepath;
+    bool valid = true;
+
+    const QStringList arguments = app.arguments();
+    for (QStringList::const_iterator iter = arguments.begin() + 1;
+         iter != arguments.end() && valid;
+         ++iter) {
+        QString value;
+        if (isBenchOption(*iter, "--repeat", value)) {
+            repetitions = value.toInt(&valid);
+            valid = valid && repetitions > 0;
+        } else if (isBenchOption(*iter, "--sort-column", value)) {
+            sortColumn = value.toInt(&valid);
+        } else if (isBenchOption(*iter, "--filter", value)) {
+            filter = value;
+        } else if (isBenchOption(*iter, "--output", value)) {
+            outputFilepath = value;
+        } else if (filepath.isEmpty() && !(*iter).startsWith("--")) {
+            filepath = QFileInfo(*iter).absoluteFilePath();
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid || filepath.isEmpty()) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    QlomBenchResults results("qlom-bench");
+    results.setProperty("document", filepath);
+    results.setProperty("repetitions", repetitions);
+    results.setProperty("sort_column", sortColumn);
+    results.setProperty("filter", filter);
+
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        if (!measure(filepath, sortColumn, filter, results)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    results.print();
+    if (!outputFilepath.isEmpty() && !results.save(outputFilepath)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,464 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_dataset.h"
+#include "bench_utils.h"
+
+#include <QDate>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTime>
+#include <QVariant>
+#include <QVector>
+#include <QXmlStreamWriter>
+
+/** The name of the database connection of the generator. */
+static const QString generatorConnection("qlom-bench-generator");
+
+/** The rows inserted per transaction. */
+static const int rowsPerTransaction = 50000;
+
+/** The range of the date columns, in days from the first date. */
+static const int dateRangeDays = 10000;
+
+/** The range of the time columns, in seconds from midnight. */
+static const int timeRangeSecs = 24 * 60 * 60;
+
+/** The field types that the generator can fill. */
+enum BenchFieldType {
+    NUMBER_FIELD,
+    TEXT_FIELD,
+    DATE_FIELD,
+    TIME_FIELD,
+    BOOLEAN_FIELD,
+    FIELD_TYPE_COUNT
+};
+
+/** The Glom names of the field types, in the order of BenchFieldType. */
+static const char * const glomTypeNames[FIELD_TYPE_COUNT] = {
+    "Number", "Text", "Date", "Time", "Boolean"
+};
+
+/** The SQLite column types of the field types, as Glom creates them. */
+static const char * const sqlTypeNames[FIELD_TYPE_COUNT] = {
+    "numeric", "text", "date", "time", "boolean"
+};
+
+/** Look up a field type by its Glom name.
+ *  @param[in] fieldType the Glom name of the type
+ *  @returns the type, or FIELD_TYPE_COUNT if it is not supported */
+static BenchFieldType toBenchFieldType(const QString &fieldType)
+{
+    for (int type = 0; type < FIELD_TYPE_COUNT; ++type) {
+        if (fieldType == QLatin1String(glomTypeNames[type])) {
+            return static_cast<BenchFieldType>(type);
+        }
+    }
+
+    return FIELD_TYPE_COUNT;
+}
+
+/** Get the name of a data column.
+ *  @param[in] column the index of the data column
+ *  @returns the field name */
+static QString columnName(int column)
+{
+    return QString("field_%1").arg(column + 1);
+}
+
+/** Generate a value for a cell.
+ *  @param[in] type the field type of the column
+ *  @param[in] random the generator to use
+ *  @param[in] textCardinality the distinct values of text columns
+ *  @returns the value, as it is stored by Glom */
+static QVariant randomValue(BenchFieldType type, BenchRandom &random,
+    int textCardinality)
+{
+    static const QDate firstDate(2000, 1, 1);
+    static const QTime midnight(0, 0);
+
+    switch (type) {
+    case NUMBER_FIELD:
+        return random.below(100000000) / 100.0;
+        break;
+    case TEXT_FIELD:
+        return QString("Value %1").arg(random.below(textCardinality));
+        break;
+    case DATE_FIELD:
+        return firstDate.addDays(random.below(dateRangeDays))
+            .toString(Qt::ISODate);
+        break;
+    case TIME_FIELD:
+        return midnight.addSecs(random.below(timeRangeSecs))
+            .toString("hh:mm:ss");
+        break;
+    default:
+        return static_cast<int>(random.below(2));
+        break;
+    }
+}
+
+/** Fill the tables of a dataset.
+ *  @param[in] db the open, empty database
+ *  @param[in] options the shape of the dataset
+ *  @param[in] types the field types of the data columns
+ *  @param[in] categories the rows of the related table, or 0 for none
+ *  @param[out] error a description of the failure, if any
+ *  @returns true on success, false otherwise */
+static bool fillDatabase(QSqlDatabase &db,
+    const QlomBenchDatasetOptions &options,
+    const QVector<BenchFieldType> &types, qint64 categories, QString &error)
+{
+    QSqlQuery query(db);
+
+    /* A database that is only partly generated is useless anyway, so there
+     * is no need to survive crashes. */
+    if (!query.exec("PRAGMA journal_mode = OFF")
+        || !query.exec("PRAGMA synchronous = OFF")) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    QStringList columns("record_id integer primary key");
+    QStringList placeholders("?");
+    if (categories > 0) {
+        columns.push_back("category_id integer");
+        placeholders.push_back("?");
+    }
+    for (int column = 0; column < types.size(); ++column) {
+        columns.push_back(QString("%1 %2").arg(columnName(column),
+            QLatin1String(sqlTypeNames[types.at(column)])));
+        placeholders.push_back("?");
+    }
+
+    if (!query.exec(QString("CREATE TABLE records (%1)")
+            .arg(columns.join(", ")))) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    BenchRandom random(options.seed);
+
+    if (categories > 0) {
+        if (!query.exec("CREATE TABLE categories "
+                "(category_id integer primary key, name text)")
+            || !db.transaction()
+            || !query.prepare("INSERT INTO categories VALUES (?, ?)")) {
+            error = query.lastError().text();
+            return false;
+        }
+
+        for (qint64 category = 1; category <= categories; ++category) {
+            query.bindValue(0, category);
+            query.bindValue(1, QString("Category %1").arg(category));
+            if (!query.exec()) {
+                error = query.lastError().text();
+                db.rollback();
+                return false;
+            }
+        }
+
+        if (!db.commit()) {
+            error = db.lastError().text();
+            return false;
+        }
+    }
+
+    if (!query.prepare(QString("INSERT INTO records VALUES (%1)")
+            .arg(placeholders.join(", ")))
+        || !db.transaction()) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    const int firstDataColumn = (categories > 0 ? 2 : 1);
+    for (qint64 row = 1; row <= options.rows; ++row) {
+        query.bindValue(0, row);
+        if (categories > 0) {
+            query.bindValue(1,
+                1 + random.below(static_cast<quint32>(categories)));
+        }
+        for (int column = 0; column < types.size(); ++column) {
+            query.bindValue(firstDataColumn + column,
+                randomValue(types.at(column), random,
+                    options.textCardinality));
+        }
+
+        if (!query.exec()) {
+            error = query.lastError().text();
+            db.rollback();
+            return false;
+        }
+
+        // Huge transactions would keep the whole table in the page cache.
+        if (0 == row % rowsPerTransaction
+            && (!db.commit() || !db.transaction())) {
+            error = db.lastError().text();
+            return false;
+        }
+    }
+
+    if (!db.commit()) {
+        error = db.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+/** Write the SQLite database of a dataset.
+ *  @param[in] options the shape of the dataset
+ *  @param[in] types the field types of the data columns
+ *  @param[in] categories the rows of the related table, or 0 for none
+ *  @param[in] filepath the path of the database
+ *  @param[out] error a description of the failure, if any
+ *  @returns true on success, false otherwise */
+static bool writeDatabase(const QlomBenchDatasetOptions &options,
+    const QVector<BenchFieldType> &types, qint64 categories,
+    const QString &filepath, QString &error)
+{
+    if (QFile::exists(filepath) && !QFile::remove(filepath)) {
+        error = QString("Cannot replace the database %1").arg(filepath);
+        return false;
+    }
+
+    bool success = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+            generatorConnection);
+        db.setDatabaseName(filepath);
+        if (db.open()) {
+            success = fillDatabase(db, options, types, categories, error);
+            db.close();
+        } else {
+            error = db.lastError().text();
+        }
+    }
+
+    // The connection can only be removed once no QSqlDatabase refers to it.
+    QSqlDatabase::removeDatabase(generatorConnection);
+    return success;
+}
+
+/** Write the definition of a field.
+ *  @param[in] xml the document writer
+ *  @param[in] name the field name
+ *  @param[in] type the Glom field type
+ *  @param[in] title the field title
+ *  @param[in] primaryKey whether the field is the primary key */
+static void writeField(QXmlStreamWriter &xml, const QString &name,
+    const QString &type, const QString &title, bool primaryKey)
+{
+    xml.writeStartElement("field");
+    xml.writeAttribute("name", name);
+    if (primaryKey) {
+        xml.writeAttribute("primary_key", "true");
+        xml.writeAttribute("unique", "true");
+        xml.writeAttribute("auto_increment", "true");
+    }
+    xml.writeAttribute("type", type);
+    xml.writeAttribute("title", title);
+    xml.writeEmptyElement("calculation");
+    xml.writeEmptyElement("formatting");
+    xml.writeAttribute("format_thousands_separator", "true");
+    xml.writeAttribute("format_decimal_places", "2");
+    xml.writeEndElement();
+}
+
+/** Write the list layout of a table.
+ *  @param[in] xml the document writer
+ *  @param[in] table the table name
+ *  @param[in] items the fields shown in the list, as pairs of a field name
+ *  and a relationship name, which is empty for fields of the table */
+static void writeListLayout(QXmlStreamWriter &xml, const QString &table,
+    const QList<QPair<QString, QString> > &items)
+{
+    xml.writeStartElement("data_layouts");
+    xml.writeStartElement("data_layout");
+    xml.writeAttribute("name", "list");
+    xml.writeAttribute("parent_table", table);
+    xml.writeStartElement("data_layout_groups");
+    xml.writeStartElement("data_layout_group");
+    xml.writeAttribute("name", "main");
+    for (QList<QPair<QString, QString> >::const_iterator iter = items.begin();
+         iter != items.end();
+         ++iter) {
+        xml.writeEmptyElement("data_layout_item");
+        xml.writeAttribute("name", (*iter).first);
+        if (!(*iter).second.isEmpty()) {
+            xml.writeAttribute("relationship", (*iter).second);
+        }
+        xml.writeAttribute("use_default_formatting", "true");
+    }
+    xml.writeEndElement(); // data_layout_group
+    xml.writeEndElement(); // data_layout_groups
+    xml.writeEndElement(); // data_layout
+    xml.writeEndElement(); // data_layouts
+}
+
+/** Write the Glom document of a dataset.
+ *  @param[in] options the shape of the dataset
+ *  @param[in] types the field types of the data columns
+ *  @param[in] categories the rows of the related table, or 0 for none
+ *  @param[in] filepath the path of the document
+ *  @param[out] error a description of the failure, if any
+ *  @returns true on success, false otherwise */
+static bool writeDocument(const QlomBenchDatasetOptions &options,
+    const QVector<BenchFieldType> &types, qint64 categories,
+    const QString &filepath, QString &error)
+{
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("glom_document");
+    xml.writeDefaultNamespace("http://glom.org/glom_document");
+    xml.writeAttribute("format_version", "4");
+    xml.writeAttribute("translation_original_locale", "C");
+    xml.writeAttribute("database_title", "Qlom benchmark");
+    xml.writeAttribute("is_example", "false");
+
+    xml.writeEmptyElement("connection");
+    xml.writeAttribute("hosting_mode", "sqlite");
+    xml.writeAttribute("server", "localhost");
+    xml.writeAttribute("try_other_ports", "true");
+    xml.writeAttribute("database", options.databaseName);
+    xml.writeAttribute("port", "0");
+
+    QList<QPair<QString, QString> > items;
+    xml.writeStartElement("table");
+    xml.writeAttribute("name", "records");
+    xml.writeAttribute("title", "Records");
+    xml.writeAttribute("default", "true");
+    xml.writeStartElement("fields");
+    writeField(xml, "record_id", "Number", "Record ID", true);
+    items.push_back(qMakePair(QString("record_id"), QString()));
+    if (categories > 0) {
+        writeField(xml, "category_id", "Number", "Category ID", false);
+        items.push_back(qMakePair(QString("category_id"), QString()));
+        items.push_back(qMakePair(QString("name"), QString("category")));
+    }
+    for (int column = 0; column < types.size(); ++column) {
+        const QString type(QLatin1String(glomTypeNames[types.at(column)]));
+        writeField(xml, columnName(column), type, QString("Field %1 (%2)")
+            .arg(QString::number(column + 1), type), false);
+        items.push_back(qMakePair(columnName(column), QString()));
+    }
+    xml.writeEndElement(); // fields
+    if (categories > 0) {
+        xml.writeStartElement("relationships");
+        xml.writeEmptyElement("relationship");
+        xml.writeAttribute("name", "category");
+        xml.writeAttribute("key", "category_id");
+        xml.writeAttribute("other_table", "categories");
+        xml.writeAttribute("other_key", "category_id");
+        xml.writeAttribute("title", "Category");
+        xml.writeEndElement(); // relationships
+    }
+    writeListLayout(xml, "records", items);
+    xml.writeEndElement(); // table
+
+    if (categories > 0) {
+        items.clear();
+        xml.writeStartElement("table");
+        xml.writeAttribute("name", "categories");
+        xml.writeAttribute("title", "Categories");
+        xml.writeStartElement("fields");
+        writeField(xml, "category_id", "Number", "Category ID", true);
+        items.push_back(qMakePair(QString("category_id"), QString()));
+        writeField(xml, "name", "Text", "Name", false);
+        items.push_back(qMakePair(QString("name"), QString()));
+        xml.writeEndElement(); // fields
+        writeListLayout(xml, "categories", items);
+        xml.writeEndElement(); // table
+    }
+
+    xml.writeEmptyElement("groups");
+    xml.writeEmptyElement("library_modules");
+    xml.writeEndDocument();
+
+    if (xml.hasError() || !file.commit()) {
+        error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+QlomBenchDatasetOptions::QlomBenchDatasetOptions() :
+    rows(10000),
+    columns(FIELD_TYPE_COUNT),
+    textCardinality(1000),
+    fanOut(100),
+    seed(1),
+    databaseName("qlom_bench")
+{
+    for (int type = 0; type < FIELD_TYPE_COUNT; ++type) {
+        fieldTypes.push_back(QLatin1String(glomTypeNames[type]));
+    }
+}
+
+bool generateBenchDataset(const QlomBenchDatasetOptions &options,
+    const QString &filepath, QString &error)
+{
+    if (options.rows < 0 || options.columns < 0 || options.fanOut < 0
+        || options.textCardinality <= 0 || options.fieldTypes.isEmpty()
+        || options.databaseName.isEmpty()) {
+        error = "Invalid dataset options";
+        return false;
+    }
+
+    QVector<BenchFieldType> types;
+    types.reserve(options.columns);
+    for (int column = 0; column < options.columns; ++column) {
+        const QString &fieldType =
+            options.fieldTypes.at(column % options.fieldTypes.size());
+        const BenchFieldType type = toBenchFieldType(fieldType);
+        if (FIELD_TYPE_COUNT == type) {
+            error = QString("Unsupported field type %1").arg(fieldType);
+            return false;
+        }
+        types.push_back(type);
+    }
+
+    // At least one category, so that every record has a related row.
+    const qint64 categories = (0 == options.fanOut ? 0
+        : qMax(Q_INT64_C(1), options.rows / options.fanOut));
+
+    // Glom looks for the database next to the document.
+    const QString databaseFilepath = QString("%1/%2.db").arg(
+        QFileInfo(filepath).absolutePath(), options.databaseName);
+
+    return writeDatabase(options, types, categories, databaseFilepath, error)
+        && writeDocument(options, types, categories, filepath, error);
+}
+
+bool isBenchFieldType(const QString &fieldType)
+{
+    return FIELD_TYPE_COUNT != toBenchFieldType(fieldType);
+}
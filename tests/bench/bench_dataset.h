@@ -0,0 +1,63 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_BENCH_DATASET_H_
+#define QLOM_BENCH_DATASET_H_
+
+#include <QString>
+#include <QStringList>
+
+/** The shape of a synthetic dataset for the benchmarks.
+ *  The dataset has a main table, "records", with an integer primary key and
+ *  the given number of data columns. If the fan-out is not zero, there is also
+ *  a related table, "categories", with one row per fanOut records on average,
+ *  and the list layout of "records" shows the name of the related category. */
+struct QlomBenchDatasetOptions
+{
+    /** Create the options of a small dataset with a column of each type. */
+    QlomBenchDatasetOptions();
+
+    qint64 rows; /**< the rows of the main table */
+    int columns; /**< the data columns of the main table */
+    QStringList fieldTypes; /**< the Glom types of the data columns, repeated
+                                 as needed: "Number", "Text", "Date", "Time"
+                                 or "Boolean" */
+    int textCardinality; /**< the distinct values in each text column */
+    int fanOut; /**< the records per category, or 0 for no related table */
+    quint32 seed; /**< the seed of the pseudo-random values */
+    QString databaseName; /**< the name of the SQLite database, which is
+                               stored next to the document with a .db
+                               suffix, as Glom does */
+};
+
+/** Generate a SQLite-hosted Glom document with synthetic data. An existing
+ *  document or database of the same name is replaced. The same options always
+ *  generate the same data.
+ *  @param[in] options the shape of the dataset
+ *  @param[in] filepath the path of the Glom document to write
+ *  @param[out] error a description of the failure, if any
+ *  @returns true on success, false otherwise */
+bool generateBenchDataset(const QlomBenchDatasetOptions &options,
+    const QString &filepath, QString &error);
+
+/** Check whether a field type is supported by the generator.
+ *  @param[in] fieldType a Glom field type, such as "Number"
+ *  @returns true if the generator can fill columns of the type */
+bool isBenchFieldType(const QString &fieldType);
+
+#endif /* QLOM_BENCH_DATASET_H_ */
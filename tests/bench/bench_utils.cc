@@ -0,0 +1,150 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QSaveFile>
+
+bool isBenchOption(const QString &argument, const QString &option,
+    QString &value)
+{
+    if (argument == option) {
+        value.clear();
+        return true;
+    }
+
+    if (argument.startsWith(option + QLatin1Char('='))) {
+        value = argument.mid(option.size() + 1);
+        return true;
+    }
+
+    return false;
+}
+
+/** Get the median of samples.
+ *  @param[in] sorted the samples, in ascending order
+ *  @returns the median, or 0 if there are no samples */
+static double sortedMedian(const QVector<double> &sorted)
+{
+    if (sorted.isEmpty()) {
+        return 0.0;
+    }
+
+    const int middle = sorted.size() / 2;
+    return (0 == sorted.size() % 2
+        ? (sorted.at(middle - 1) + sorted.at(middle)) / 2.0
+        : sorted.at(middle));
+}
+
+QlomBenchResults::QlomBenchResults(const QString &benchmark) :
+    theBenchmark(benchmark)
+{}
+
+void QlomBenchResults::setProperty(const QString &name,
+    const QJsonValue &value)
+{
+    theProperties.insert(name, value);
+}
+
+void QlomBenchResults::addSample(const QString &metric, double value)
+{
+    if (!theSamples.contains(metric)) {
+        theMetrics.push_back(metric);
+    }
+
+    theSamples[metric].push_back(value);
+}
+
+double QlomBenchResults::median(const QString &metric) const
+{
+    QVector<double> sorted(theSamples.value(metric));
+    std::sort(sorted.begin(), sorted.end());
+    return sortedMedian(sorted);
+}
+
+void QlomBenchResults::print() const
+{
+    std::printf("%-32s %12s %12s %12s %8s\n", "metric", "median", "min",
+        "max", "samples");
+    for (QStringList::const_iterator iter = theMetrics.begin();
+         iter != theMetrics.end();
+         ++iter) {
+        QVector<double> sorted(theSamples.value(*iter));
+        std::sort(sorted.begin(), sorted.end());
+        std::printf("%-32s %12.3f %12.3f %12.3f %8d\n", qPrintable(*iter),
+            sortedMedian(sorted), sorted.first(), sorted.last(),
+            sorted.size());
+    }
+    std::fflush(stdout);
+}
+
+QJsonDocument QlomBenchResults::toJson() const
+{
+    QJsonObject metrics;
+    for (QStringList::const_iterator iter = theMetrics.begin();
+         iter != theMetrics.end();
+         ++iter) {
+        QVector<double> sorted(theSamples.value(*iter));
+        std::sort(sorted.begin(), sorted.end());
+
+        QJsonArray samples;
+        const QVector<double> values(theSamples.value(*iter));
+        for (QVector<double>::const_iterator value = values.begin();
+             value != values.end();
+             ++value) {
+            samples.append(*value);
+        }
+
+        QJsonObject metric;
+        metric.insert("median", sortedMedian(sorted));
+        metric.insert("min", sorted.first());
+        metric.insert("max", sorted.last());
+        metric.insert("samples", samples);
+        metrics.insert(*iter, metric);
+    }
+
+    QJsonObject results;
+    results.insert("benchmark", theBenchmark);
+    results.insert("timestamp",
+        QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    results.insert("properties", theProperties);
+    results.insert("metrics", metrics);
+    return QJsonDocument(results);
+}
+
+bool QlomBenchResults::save(const QString &filepath) const
+{
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("Failed to open the results file %s", qPrintable(filepath));
+        return false;
+    }
+
+    file.write(toJson().toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        qWarning("Failed to write the results file %s", qPrintable(filepath));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,107 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_BENCH_UTILS_H_
+#define QLOM_BENCH_UTILS_H_
+
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/** Check whether an argument is an option, given as --option or
+ *  --option=value.
+ *  @param[in] argument a command line argument
+ *  @param[in] option the option, such as --rows
+ *  @param[out] value the value given to the option, if any
+ *  @returns whether the argument is the option */
+bool isBenchOption(const QString &argument, const QString &option,
+    QString &value);
+
+/** A xorshift pseudo-random number generator. It is used instead of qrand()
+ *  so that a seed generates the same data with every C library. */
+class BenchRandom
+{
+public:
+    explicit BenchRandom(quint32 seed) :
+        theState(0 == seed ? 1 : seed)
+    {}
+
+    /** Get the next number.
+     *  @param[in] bound the upper bound, which must be positive
+     *  @returns a number from 0 to bound - 1 */
+    quint32 below(quint32 bound)
+    {
+        theState ^= theState << 13;
+        theState ^= theState >> 17;
+        theState ^= theState << 5;
+        return theState % bound;
+    }
+
+private:
+    quint32 theState; /**< never 0 */
+};
+
+/** The results of a benchmark program, written as JSON for
+ *  qlom-bench-compare. Each metric is measured one or more times, and is
+ *  summarised by the median, minimum and maximum of its samples. The name of
+ *  a metric ends with its unit, such as document_load_ms. */
+class QlomBenchResults
+{
+public:
+    /** Create empty results.
+     *  @param[in] benchmark the name of the benchmark program */
+    explicit QlomBenchResults(const QString &benchmark);
+
+    /** Describe the conditions of the benchmark, such as the dataset.
+     *  @param[in] name the name of the property
+     *  @param[in] value the value of the property */
+    void setProperty(const QString &name, const QJsonValue &value);
+
+    /** Add a measurement of a metric.
+     *  @param[in] metric the name of the metric
+     *  @param[in] value the measured value */
+    void addSample(const QString &metric, double value);
+
+    /** Get the median of the samples of a metric.
+     *  @param[in] metric the name of the metric
+     *  @returns the median, or 0 if the metric was not measured */
+    double median(const QString &metric) const;
+
+    /** Print the results as a table, on standard output. */
+    void print() const;
+
+    /** Get the results as JSON.
+     *  @returns the results */
+    QJsonDocument toJson() const;
+
+    /** Write the results as JSON.
+     *  @param[in] filepath the path of the file to write
+     *  @returns true on success, false otherwise */
+    bool save(const QString &filepath) const;
+
+private:
+    QString theBenchmark; /**< the name of the benchmark program */
+    QJsonObject theProperties; /**< see setProperty() */
+    QStringList theMetrics; /**< the metrics, in the order they were added */
+    QHash<QString, QVector<double> > theSamples; /**< per metric */
+};
+
+#endif /* QLOM_BENCH_UTILS_H_ */
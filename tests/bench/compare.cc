@@ -0,0 +1,310 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_utils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStringList>
+
+/** The default tolerance of a metric, as a fraction of its baseline value. */
+static const double defaultTolerance = 0.25;
+
+/** The exit code for regressions, which differs from the one for errors so
+ *  that scripts can tell them apart. */
+static const int regressionExitCode = 1;
+
+/** The exit code for errors, such as unreadable files. */
+static const int errorExitCode = 2;
+
+/** The exit code for a baseline without values, which cannot catch
+ *  regressions, so that it does not pass for a successful check. */
+static const int noBaselineExitCode = 3;
+
+/** Print the usage of qlom-bench-compare. */
+static void printUsage()
+{
+    std::cout << "Usage: qlom-bench-compare [--update] baseline.json "
+                 "results.json...\n"
+                 "Compares the medians of benchmark results with a baseline, "
+                 "and exits with 1 if a\nmetric is slower than its baseline "
+                 "value plus its tolerance, or with 3 if a metric has no\n"
+                 "baseline value yet. --update replaces the baseline values "
+                 "with the results\ninstead." << std::endl;
+}
+
+/** Read a JSON object from a file.
+ *  @param[in] filepath the path of the file
+ *  @param[out] object the object
+ *  @returns true on success, false otherwise */
+static bool readObject(const QString &filepath, QJsonObject &object)
+{
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Failed to open " << qPrintable(filepath) << std::endl;
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(),
+        &error);
+    if (QJsonParseError::NoError != error.error || !document.isObject()) {
+        std::cerr << "Failed to parse " << qPrintable(filepath) << ": "
+                  << qPrintable(error.errorString()) << std::endl;
+        return false;
+    }
+
+    object = document.object();
+    return true;
+}
+
+/** Compare the results with the baseline, and print the differences.
+ *  @param[in] baseline the baseline
+ *  @param[in] medians the median of each measured metric
+ *  @param[in] properties the properties of the results
+ *  @returns the number of regressions, or -1 if a metric was not measured */
+static int compare(const QJsonObject &baseline,
+    const QHash<QString, double> &medians, const QJsonObject &properties)
+{
+    // A different dataset makes the comparison meaningless.
+    const QJsonObject dataset = baseline.value("properties").toObject();
+    for (QJsonObject::const_iterator iter = dataset.begin();
+         iter != dataset.end();
+         ++iter) {
+        if (properties.contains(iter.key())
+            && properties.value(iter.key()) != iter.value()) {
+            std::cout << "warning: the results have a different "
+                      << qPrintable(iter.key()) << " than the baseline"
+                      << std::endl;
+        }
+    }
+
+    std::printf("%-32s %12s %12s %9s %12s  %s\n", "metric", "baseline",
+        "current", "change", "limit", "status");
+
+    int regressions = 0;
+    bool complete = true;
+    const QJsonObject metrics = baseline.value("metrics").toObject();
+    for (QJsonObject::const_iterator iter = metrics.begin();
+         iter != metrics.end();
+         ++iter) {
+        const QJsonObject metric = iter.value().toObject();
+        const double value = metric.value("value").toDouble();
+        const double tolerance =
+            metric.value("tolerance").toDouble(defaultTolerance);
+        const double slack = metric.value("slack").toDouble(0.0);
+        const double limit = value * (1.0 + tolerance) + slack;
+
+        // Metrics without a value have not been measured by bench-baseline.
+        if (!metric.contains("value")) {
+            std::printf("%-32s %12s %12s %9s %12s  %s\n",
+                qPrintable(iter.key()), "-", "-", "-", "-", "NO BASELINE");
+            continue;
+        }
+
+        if (!medians.contains(iter.key())) {
+            std::printf("%-32s %12.3f %12s %9s %12.3f  %s\n",
+                qPrintable(iter.key()), value, "-", "-", limit,
+                "NOT MEASURED");
+            complete = false;
+            continue;
+        }
+
+        const double current = medians.value(iter.key());
+        const double change = (value > 0.0
+            ? 100.0 * (current - value) / value : 0.0);
+        const char *status = "ok";
+        if (current > limit) {
+            status = "REGRESSION";
+            ++regressions;
+        } else if (current < value * (1.0 - tolerance) - slack) {
+            status = "faster, consider updating the baseline";
+        }
+
+        std::printf("%-32s %12.3f %12.3f %+8.1f%% %12.3f  %s\n",
+            qPrintable(iter.key()), value, current, change, limit, status);
+    }
+    std::fflush(stdout);
+
+    return (complete ? regressions : -1);
+}
+
+/** Count the metrics of the baseline that have no measured value.
+ *  @param[in] baseline the baseline
+ *  @returns the number of metrics without a value */
+static int missingValues(const QJsonObject &baseline)
+{
+    int missing = 0;
+    const QJsonObject metrics = baseline.value("metrics").toObject();
+    for (QJsonObject::const_iterator iter = metrics.begin();
+         iter != metrics.end();
+         ++iter) {
+        if (!iter.value().toObject().contains("value")) {
+            ++missing;
+        }
+    }
+
+    return missing;
+}
+
+/** Replace the baseline values with the results, keeping the tolerances.
+ *  @param[in] filepath the path of the baseline
+ *  @param[in] baseline the baseline
+ *  @param[in] medians the median of each measured metric
+ *  @param[in] properties the properties of the results
+ *  @returns true on success, false otherwise */
+static bool update(const QString &filepath, QJsonObject baseline,
+    const QHash<QString, double> &medians, const QJsonObject &properties)
+{
+    QJsonObject metrics = baseline.value("metrics").toObject();
+    for (QJsonObject::iterator iter = metrics.begin();
+         iter != metrics.end();
+         ++iter) {
+        if (medians.contains(iter.key())) {
+            QJsonObject metric = iter.value().toObject();
+            // Three significant decimals are plenty for noisy timings.
+            metric.insert("value",
+                std::floor(medians.value(iter.key()) * 1000.0 + 0.5) / 1000.0);
+            iter.value() = metric;
+        } else {
+            std::cout << "warning: " << qPrintable(iter.key())
+                      << " was not measured and keeps its value" << std::endl;
+        }
+    }
+    baseline.insert("metrics", metrics);
+
+    QJsonObject dataset = baseline.value("properties").toObject();
+    for (QJsonObject::iterator iter = dataset.begin();
+         iter != dataset.end();
+         ++iter) {
+        if (properties.contains(iter.key())) {
+            iter.value() = properties.value(iter.key());
+        }
+    }
+    baseline.insert("properties", dataset);
+
+    QSaveFile file(filepath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Failed to open " << qPrintable(filepath) << std::endl;
+        return false;
+    }
+
+    file.write(QJsonDocument(baseline).toJson(QJsonDocument::Indented));
+    if (!file.commit()) {
+        std::cerr << "Failed to write " << qPrintable(filepath) << std::endl;
+        return false;
+    }
+
+    std::cout << "Updated " << qPrintable(filepath) << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    bool updating = false;
+    QStringList filepaths;
+    const QStringList arguments = app.arguments();
+    for (QStringList::const_iterator iter = arguments.begin() + 1;
+         iter != arguments.end();
+         ++iter) {
+        QString value;
+        if (isBenchOption(*iter, "--update", value) && value.isEmpty()) {
+            updating = true;
+        } else if (!(*iter).startsWith("--")) {
+            filepaths.push_back(*iter);
+        } else {
+            printUsage();
+            return errorExitCode;
+        }
+    }
+
+    if (filepaths.size() < 2) {
+        printUsage();
+        return errorExitCode;
+    }
+
+    QJsonObject baseline;
+    if (!readObject(filepaths.first(), baseline)) {
+        return errorExitCode;
+    }
+
+    // The metrics of the benchmark programs have distinct names.
+    QHash<QString, double> medians;
+    QJsonObject properties;
+    for (QStringList::const_iterator iter = filepaths.begin() + 1;
+         iter != filepaths.end();
+         ++iter) {
+        QJsonObject results;
+        if (!readObject(*iter, results)) {
+            return errorExitCode;
+        }
+
+        const QJsonObject metrics = results.value("metrics").toObject();
+        for (QJsonObject::const_iterator metric = metrics.begin();
+             metric != metrics.end();
+             ++metric) {
+            medians.insert(metric.key(),
+                metric.value().toObject().value("median").toDouble());
+        }
+
+        const QJsonObject resultProperties =
+            results.value("properties").toObject();
+        for (QJsonObject::const_iterator property = resultProperties.begin();
+             property != resultProperties.end();
+             ++property) {
+            properties.insert(property.key(), property.value());
+        }
+    }
+
+    if (updating) {
+        return (update(filepaths.first(), baseline, medians, properties)
+            ? EXIT_SUCCESS : errorExitCode);
+    }
+
+    const int regressions = compare(baseline, medians, properties);
+    const int missing = missingValues(baseline);
+    if (regressions < 0) {
+        std::cout << "Some metrics of the baseline were not measured."
+                  << std::endl;
+        return errorExitCode;
+    } else if (regressions > 0) {
+        std::cout << regressions << " metric(s) regressed beyond their "
+                     "tolerance." << std::endl;
+        return regressionExitCode;
+    } else if (missing > 0) {
+        // A baseline is only meaningful once measured on the reference machine.
+        std::cout << "The regression gate is DISABLED for " << missing
+                  << " metric(s) without a baseline value. Run make "
+                     "bench-baseline on the
+reference machine, and commit "
+                     "tests/bench/baseline.json." << std::endl;
+        return noBaselineExitCode;
+    }
+
+    std::cout << "No regressions." << std::endl;
+    return EXIT_SUCCESS;
+}
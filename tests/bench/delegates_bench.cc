@@ -0,0 +1,187 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "delegates_bench.h"
+#include "layout_delegates.h"
+#include "utils.h"
+
+#include <memory>
+
+#include <QApplication>
+#include <QFontMetrics>
+#include <QImage>
+#include <QLocale>
+#include <QPainter>
+#include <QStandardItemModel>
+#include <QStyleOptionViewItem>
+#include <QTest>
+
+/** The size of the painted cell, in pixels. */
+static const QSize cellSize(200, 24);
+
+/** Create the field details and the delegate of a benchmark row.
+ *  @param[in] fieldType the Glom field type
+ *  @param[in] thousandsSeparator whether numbers use thousands separators
+ *  @param[in] currency the currency symbol of numbers, or an empty string
+ *  @param[in] decimalPlaces the restricted precision of numbers, or -1 for
+ *  the default precision
+ *  @returns the delegate, which the caller owns */
+static QlomLayoutItemFieldDelegate * createDelegate(int fieldType,
+    bool thousandsSeparator, const QString &currency, int decimalPlaces)
+{
+    std::shared_ptr<Glom::Field> field = std::make_shared<Glom::Field>();
+    field->set_name("field");
+    field->set_glom_type(static_cast<Glom::Field::glom_field_type>(fieldType));
+
+    Glom::Formatting formatting;
+    formatting.m_numeric_format.m_use_thousands_separator = thousandsSeparator;
+    formatting.m_numeric_format.m_currency_symbol = qstringToUstring(currency);
+    formatting.m_numeric_format.m_decimal_places_restricted =
+        (decimalPlaces >= 0);
+    formatting.m_numeric_format.m_decimal_places = qMax(0, decimalPlaces);
+
+    return QlomLayoutItemFieldDelegate::create(formatting, field);
+}
+
+/** Add the columns and rows shared by the benchmarks. */
+static void addBenchData()
+{
+    QTest::addColumn<int>("fieldType");
+    QTest::addColumn<bool>("thousandsSeparator");
+    QTest::addColumn<QString>("currency");
+    QTest::addColumn<int>("decimalPlaces");
+    QTest::addColumn<QVariant>("value");
+
+    /* The SQLite driver returns numbers as strings, the PostgreSQL driver
+     * returns them as doubles. */
+    const QVariant number(QString("1234567.891"));
+    QTest::newRow("number")
+        << int(Glom::Field::TYPE_NUMERIC) << false << QString() << -1
+        << number;
+    QTest::newRow("number, double value")
+        << int(Glom::Field::TYPE_NUMERIC) << false << QString() << -1
+        << QVariant(1234567.891);
+    QTest::newRow("number, thousands separator")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString() << -1
+        << number;
+    QTest::newRow("number, currency")
+        << int(Glom::Field::TYPE_NUMERIC) << false << QString("EUR") << -1
+        << number;
+    QTest::newRow("number, thousands separator and currency")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString("EUR") << -1
+        << number;
+    QTest::newRow("number, 0 decimal places")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString() << 0
+        << number;
+    QTest::newRow("number, 2 decimal places")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString() << 2
+        << number;
+    QTest::newRow("number, 15 decimal places")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString() << 15
+        << number;
+    QTest::newRow("number, not a number")
+        << int(Glom::Field::TYPE_NUMERIC) << true << QString() << -1
+        << QVariant(QString("n/a"));
+    QTest::newRow("text")
+        << int(Glom::Field::TYPE_TEXT) << false << QString() << -1
+        << QVariant(QString("Lorem ipsum dolor sit amet"));
+    QTest::newRow("date")
+        << int(Glom::Field::TYPE_DATE) << false << QString() << -1
+        << QVariant(QString("2010-06-15"));
+    QTest::newRow("time")
+        << int(Glom::Field::TYPE_TIME) << false << QString() << -1
+        << QVariant(QString("13:45:30"));
+    QTest::newRow("boolean")
+        << int(Glom::Field::TYPE_BOOLEAN) << false << QString() << -1
+        << QVariant(1);
+    QTest::newRow("image")
+        << int(Glom::Field::TYPE_IMAGE) << false << QString() << -1
+        << QVariant(QByteArray(4096, '\x7f'));
+}
+
+void QlomDelegatesBench::initTestCase()
+{
+    ensureLibglomInitialised();
+}
+
+void QlomDelegatesBench::displayText_data()
+{
+    addBenchData();
+}
+
+void QlomDelegatesBench::displayText()
+{
+    QFETCH(int, fieldType);
+    QFETCH(bool, thousandsSeparator);
+    QFETCH(QString, currency);
+    QFETCH(int, decimalPlaces);
+    QFETCH(QVariant, value);
+
+    QScopedPointer<QlomLayoutItemFieldDelegate> delegate(createDelegate(
+        fieldType, thousandsSeparator, currency, decimalPlaces));
+    const QLocale locale(QLocale::English, QLocale::UnitedStates);
+
+    QString text;
+    QBENCHMARK {
+        text = delegate->displayText(value, locale);
+    }
+
+    QVERIFY(!text.isEmpty());
+    if (Glom::Field::TYPE_NUMERIC == fieldType && !currency.isEmpty()) {
+        QVERIFY(text.startsWith(currency));
+    }
+}
+
+void QlomDelegatesBench::paint_data()
+{
+    addBenchData();
+}
+
+void QlomDelegatesBench::paint()
+{
+    QFETCH(int, fieldType);
+    QFETCH(bool, thousandsSeparator);
+    QFETCH(QString, currency);
+    QFETCH(int, decimalPlaces);
+    QFETCH(QVariant, value);
+
+    QScopedPointer<QlomLayoutItemFieldDelegate> delegate(createDelegate(
+        fieldType, thousandsSeparator, currency, decimalPlaces));
+
+    QStandardItemModel model(1, 1);
+    const QModelIndex index = model.index(0, 0);
+    model.setData(index, value);
+
+    QStyleOptionViewItem option;
+    option.rect = QRect(QPoint(0, 0), cellSize);
+    option.state = QStyle::State_Enabled;
+    option.palette = QApplication::palette();
+    option.font = QApplication::font();
+    option.fontMetrics = QFontMetrics(option.font);
+    option.locale = QLocale(QLocale::English, QLocale::UnitedStates);
+
+    QImage image(cellSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+
+    QBENCHMARK {
+        delegate->paint(&painter, option, index);
+    }
+}
+
+QTEST_MAIN(QlomDelegatesBench)
@@ -0,0 +1,51 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QLOM_DELEGATES_BENCH_H_
+#define QLOM_DELEGATES_BENCH_H_
+
+#include <QObject>
+
+/** Benchmarks of the delegates that format and paint the cells of list
+ *  views. Each benchmark runs for every Glom field type, and for numbers with
+ *  and without thousands separators and currency, and with small and large
+ *  restricted precision. */
+class QlomDelegatesBench : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    /** Initialise libglom, which the field details need. */
+    void initTestCase();
+
+    /** The field types, formats and values of the benchmarks. */
+    void displayText_data();
+
+    /** Benchmark QlomLayoutItemFieldDelegate::displayText(), which includes
+     *  the numeric formatting. */
+    void displayText();
+
+    /** The field types, formats and values of the benchmarks. */
+    void paint_data();
+
+    /** Benchmark QlomFieldFormattingDelegate::paint(), for a cell of a
+     *  typical size. */
+    void paint();
+};
+
+#endif /* QLOM_DELEGATES_BENCH_H_ */
@@ -0,0 +1,280 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_utils.h"
+#include "filter_kernels.h"
+
+#include <iostream>
+#include <limits>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+
+/** The row counts that the kernels are checked with. Most are not a
+ *  multiple of 64, so that the scalar tails of the SIMD kernels are
+ *  checked as well. */
+static const int checkedRowCounts[] = { 0, 1, 63, 64, 65, 130, 1000, 4097 };
+
+/** The number of distinct codes of the checked columns, including code 0
+ *  for null. */
+static const int checkedCodes = 37;
+
+/** The default number of rows of the measured columns. */
+static const int defaultRows = 1000000;
+
+/** The default number of measurements of each metric. */
+static const int defaultRepetitions = 5;
+
+/** The kernels, in the order of QlomFilterKernels::Kernel. */
+static const char * const kernelNames[] = {
+    "scalar", "sse2", "avx", "avx2"
+};
+
+/** Print the usage of qlom-bench-filter. */
+static void printUsage()
+{
+    std::cout << "Usage: qlom-bench-filter [--rows=N] [--repeat=N] "
+                 "[--output=results.json]\n"
+                 "Checks that every filter kernel of the processor selects "
+                 "the same rows as the\nscalar kernel, and measures the "
+                 "fastest kernel." << std::endl;
+}
+
+/** Get the elapsed time of a timer in milliseconds, with the precision of
+ *  its nanosecond clock.
+ *  @param[in] timer the started timer
+ *  @returns the elapsed time */
+static double elapsedMsecs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+/** Get the number of words of the selection bitmap of some rows. */
+static int wordCount(int rows)
+{
+    return (rows + QlomFilterKernels::rowsPerWord - 1)
+        / QlomFilterKernels::rowsPerWord;
+}
+
+/** Generate a column of numbers, as QlomFilterColumn extracts them. A tenth
+ *  of the rows are NaN, as null values are, and some are infinite.
+ *  @param[in] rows the number of rows
+ *  @param[in,out] random the generator to use
+ *  @returns the number of each row */
+static QVector<double> randomNumbers(int rows, BenchRandom &random)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    QVector<double> numbers;
+    numbers.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        const quint32 kind = random.below(20);
+        if (kind < 2) {
+            numbers.push_back(std::numeric_limits<double>::quiet_NaN());
+        } else if (2 == kind) {
+            numbers.push_back(0 == random.below(2) ? infinity : -infinity);
+        } else {
+            // Whole numbers, so that the limits of the ranges are hit.
+            numbers.push_back(double(random.below(201)) - 100.0);
+        }
+    }
+
+    return numbers;
+}
+
+/** Generate a column of codes, with code 0 for null values.
+ *  @param[in] rows the number of rows
+ *  @param[in] codes the number of distinct codes
+ *  @param[in,out] random the generator to use
+ *  @returns the code of each row */
+static QVector<qint32> randomCodes(int rows, int codes, BenchRandom &random)
+{
+    QVector<qint32> result;
+    result.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        result.push_back(random.below(codes));
+    }
+
+    return result;
+}
+
+/** Check that each kernel selects the same rows as the scalar kernel, for a
+ *  column of a number of rows.
+ *  @param[in] rows the number of rows
+ *  @param[in,out] random the generator to use
+ *  @returns the number of mismatches */
+static int checkKernels(int rows, BenchRandom &random)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double ranges[][2] = {
+        { -infinity, infinity },
+        { -10.0, 10.0 },
+        { 0.0, 0.0 },
+        { 50.0, infinity },
+        { 10.0, -10.0 } // Empty.
+    };
+    const int rangeCount = sizeof(ranges) / sizeof(ranges[0]);
+
+    const QVector<double> numbers = randomNumbers(rows, random);
+    const QVector<qint32> codes = randomCodes(rows, checkedCodes, random);
+
+    // The codes that match; null never does.
+    QVector<qint32> accepted(checkedCodes, 0);
+    for (int code = 1; code < checkedCodes; ++code) {
+        accepted[code] = (0 == random.below(3) ? -1 : 0);
+    }
+
+    int mismatches = 0;
+    for (int kernel = QlomFilterKernels::SSE2_KERNEL;
+         kernel <= QlomFilterKernels::AVX2_KERNEL;
+         ++kernel) {
+        const QlomFilterKernels::Kernel tested =
+            static_cast<QlomFilterKernels::Kernel>(kernel);
+        if (!QlomFilterKernels::isSupported(tested)) {
+            continue;
+        }
+
+        for (int range = 0; range < rangeCount; ++range) {
+            QVector<quint64> expected(wordCount(rows), 0);
+            QlomFilterKernels::selectRange(QlomFilterKernels::SCALAR_KERNEL,
+                numbers.constData(), rows, ranges[range][0],
+                ranges[range][1], expected.data());
+            QVector<quint64> actual(wordCount(rows), 0);
+            QlomFilterKernels::selectRange(tested, numbers.constData(), rows,
+                ranges[range][0], ranges[range][1], actual.data());
+            if (actual != expected) {
+                std::cerr << "The " << kernelNames[kernel]
+                          << " range kernel differs for " << rows
+                          << " rows and the range [" << ranges[range][0]
+                          << ", " << ranges[range][1] << "]" << std::endl;
+                ++mismatches;
+            }
+        }
+
+        QVector<quint64> expected(wordCount(rows), 0);
+        QlomFilterKernels::selectCodes(QlomFilterKernels::SCALAR_KERNEL,
+            codes.constData(), rows, accepted.constData(), expected.data());
+        QVector<quint64> actual(wordCount(rows), 0);
+        QlomFilterKernels::selectCodes(tested, codes.constData(), rows,
+            accepted.constData(), actual.data());
+        if (actual != expected) {
+            std::cerr << "The " << kernelNames[kernel]
+                      << " code kernel differs for " << rows << " rows"
+                      << std::endl;
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+/** Measure the fastest kernels once.
+ *  @param[in] numbers the column of numbers
+ *  @param[in] codes the column of codes
+ *  @param[in] accepted the codes that match
+ *  @param[in,out] results the results to add the measurements to */
+static void measure(const QVector<double> &numbers,
+    const QVector<qint32> &codes, const QVector<qint32> &accepted,
+    QlomBenchResults &results)
+{
+    const QlomFilterKernels::Kernel kernel = QlomFilterKernels::fastest();
+    QElapsedTimer timer;
+
+    QVector<quint64> bits(wordCount(numbers.size()), 0);
+    timer.start();
+    QlomFilterKernels::selectRange(kernel, numbers.constData(),
+        numbers.size(), -10.0, 10.0, bits.data());
+    results.addSample("filter_range_ms", elapsedMsecs(timer));
+
+    bits.fill(0);
+    timer.start();
+    QlomFilterKernels::selectCodes(kernel, codes.constData(), codes.size(),
+        accepted.constData(), bits.data());
+    results.addSample("filter_codes_ms", elapsedMsecs(timer));
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int rows = defaultRows;
+    int repetitions = defaultRepetitions;
+    QString outputFilepath;
+    bool valid = true;
+
+    const QStringList arguments = app.arguments();
+    for (QStringList::const_iterator iter = arguments.begin() + 1;
+         iter != arguments.end() && valid;
+         ++iter) {
+        QString value;
+        if (isBenchOption(*iter, "--rows", value)) {
+            rows = value.toInt(&valid);
+            valid = valid && rows > 0;
+        } else if (isBenchOption(*iter, "--repeat", value)) {
+            repetitions = value.toInt(&valid);
+            valid = valid && repetitions > 0;
+        } else if (isBenchOption(*iter, "--output", value)) {
+            outputFilepath = value;
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // A wrong kernel fails the benchmark, rather than skewing its results.
+    BenchRandom random(1);
+    int mismatches = 0;
+    const int rowCounts = sizeof(checkedRowCounts) / sizeof(int);
+    for (int index = 0; index < rowCounts; ++index) {
+        mismatches += checkKernels(checkedRowCounts[index], random);
+    }
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " kernel check(s) failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const QVector<double> numbers = randomNumbers(rows, random);
+    const QVector<qint32> codes = randomCodes(rows, checkedCodes, random);
+    QVector<qint32> accepted(checkedCodes, 0);
+    for (int code = 1; code < checkedCodes; code += 2) {
+        accepted[code] = -1;
+    }
+
+    QlomBenchResults results("qlom-bench-filter");
+    results.setProperty("filter_rows", rows);
+    results.setProperty("repetitions", repetitions);
+    results.setProperty("kernel",
+        QString(kernelNames[QlomFilterKernels::fastest()]));
+
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        measure(numbers, codes, accepted, results);
+    }
+
+    results.print();
+    if (!outputFilepath.isEmpty() && !results.save(outputFilepath)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_dataset.h"
+#include "bench_utils.h"
+
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+
+/** Print the usage of qlom-bench-generate. */
+static void printUsage()
+{
+    std::cout << "Usage: qlom-bench-generate [--rows=N] [--columns=N] "
+                 "[--types=Number,Text,Date,Time,Boolean] "
+                 "[--text-cardinality=N] [--fan-out=N] [--seed=N] "
+                 "[--database=NAME] document.glom" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QlomBenchDatasetOptions options;
+    QString filepath;
+    bool valid = true;
+
+    const QStringList arguments = app.arguments();
+    for (QStringList::const_iterator iter = arguments.begin() + 1;
+         iter != arguments.end() && valid;
+         ++iter) {
+        QString value;
+        if (isBenchOption(*iter, "--rows", value)) {
+            options.rows = value.toLongLong(&valid);
+        } else if (isBenchOption(*iter, "--columns", value)) {
+            options.columns = value.toInt(&valid);
+        } else if (isBenchOption(*iter, "--types", value)) {
+            options.fieldTypes = value.split(QLatin1Char(','));
+            for (QStringList::const_iterator type =
+                     options.fieldTypes.begin();
+                 type != options.fieldTypes.end();
+                 ++type) {
+                valid = valid && isBenchFieldType(*type);
+            }
+        } else if (isBenchOption(*iter, "--text-cardinality", value)) {
+            options.textCardinality = value.toInt(&valid);
+        } else if (isBenchOption(*iter, "--fan-out", value)) {
+            options.fanOut = value.toInt(&valid);
+        } else if (isBenchOption(*iter, "--seed", value)) {
+            options.seed = value.toUInt(&valid);
+        } else if (isBenchOption(*iter, "--database", value)) {
+            options.databaseName = value;
+        } else if (filepath.isEmpty() && !(*iter).startsWith("--")) {
+            filepath = *iter;
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid || filepath.isEmpty()) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString error;
+    if (!generateBenchDataset(options, filepath, error)) {
+        std::cerr << "Failed to generate " << qPrintable(filepath) << ": "
+                  << qPrintable(error) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Generated " << options.rows << " rows in "
+              << timer.elapsed() << " ms: " << qPrintable(filepath)
+              << std::endl;
+    return EXIT_SUCCESS;
+}
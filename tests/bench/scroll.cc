@@ -0,0 +1,580 @@
+/* Qlom is copyright Openismus GmbH, 2010
+ *
+ * This file is part of Qlom
+ *
+ * Qlom is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Qlom is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Qlom. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_utils.h"
+#include "gui/list_view.h"
+#include "gui/main_window.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QFile>
+#include <QFileInfo>
+#include <QScrollBar>
+#include <QSize>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+/** The time of a frame at 60 frames per second, in milliseconds. */
+static const double frameBudgetMsecs = 1000.0 / 60.0;
+
+/** The default number of frames of the scripted traces. */
+static const int defaultFrames = 300;
+
+/** The default number of replays of each trace. */
+static const int defaultRepetitions = 3;
+
+/** The size of the main window, which has to be the same for recording and
+ *  replaying a trace. */
+static const QSize windowSize(1280, 800);
+
+/** The longest wait for the document to load, in milliseconds. */
+static const int loadTimeoutMsecs = 120000;
+
+/** The most frames that an END step replays. */
+static const int maxEndFrames = 1000000;
+
+/** A step of a scroll trace, which is replayed as one frame. */
+struct ScrollStep
+{
+    /** How a step moves the vertical scroll bar. */
+    enum Kind {
+        SCROLL_BY, /**< by amount units, which are rows by default */
+        SCROLL_TO, /**< to the value amount */
+        PAGE, /**< by amount pages */
+        DRAG, /**< to amount times the current maximum */
+        END /**< to the maximum, repeated until no more rows are fetched */
+    };
+
+    Kind kind; /**< the kind of the step */
+    double amount; /**< see Kind */
+};
+
+/** A named sequence of steps. */
+struct ScrollTrace
+{
+    QString name; /**< the prefix of the metrics of the trace */
+    QVector<ScrollStep> steps; /**< a step per frame */
+};
+
+/** The frames of a replayed trace. */
+struct ReplayResult
+{
+    QVector<double> frameMsecs; /**< the time of each frame */
+    int droppedFrames; /**< the display refreshes missed by slow frames */
+    int fetchFrames; /**< the frames that fetched rows */
+    int fetchStalls; /**< the fetching frames that were slow */
+};
+
+/** Records the positions of the vertical scroll bar of a view, one line per
+ *  painted frame, in the format of trace files. */
+class ScrollRecorder : public QObject
+{
+public:
+    /** Start recording.
+     *  @param[in] view the view to record
+     *  @param[in] stream the stream to write the trace to */
+    ScrollRecorder(QAbstractScrollArea *view, QTextStream &stream) :
+        QObject(view),
+        theView(view),
+        theStream(stream),
+        theLastValue(view->verticalScrollBar()->value())
+    {
+        theView->viewport()->installEventFilter(this);
+    }
+
+    /** Reimplemented to record the position at each paint event.
+     *  @param[in] watched the viewport
+     *  @param[in] event the event
+     *  @returns false, so that the viewport handles the event */
+    virtual bool eventFilter(QObject *watched, QEvent *event)
+    {
+        Q_UNUSED(watched);
+
+        if (QEvent::Paint == event->type()) {
+            const int value = theView->verticalScrollBar()->value();
+            if (value != theLastValue) {
+                theStream << "to " << value << '\n';
+                theLastValue = value;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    QAbstractScrollArea *theView; /**< the recorded view */
+    QTextStream &theStream; /**< the trace file */
+    int theLastValue; /**< the last recorded position */
+};
+
+/** Print the usage of qlom-bench-scroll. */
+static void printUsage()
+{
+    std::cout << "Usage: qlom-bench-scroll [--traces=flick,page-down,"
+                 "drag-to-end] [--trace-file=FILE] [--frames=N] "
+                 "[--repeat=N] [--output=results.json] document.glom\n"
+                 "       qlom-bench-scroll --record=FILE document.glom\n"
+                 "Trace files have a step per line: \"by ROWS\", "
+                 "\"to POSITION\", \"page PAGES\", \"drag FRACTION\" or "
+                 "\"end\"." << std::endl;
+}
+
+/** Add a step to a trace.
+ *  @param[in,out] trace the trace
+ *  @param[in] kind the kind of the step
+ *  @param[in] amount the amount of the step */
+static void addStep(ScrollTrace &trace, ScrollStep::Kind kind, double amount)
+{
+    ScrollStep step;
+    step.kind = kind;
+    step.amount = amount;
+    trace.steps.push_back(step);
+}
+
+/** Create a trace of repeated flicks, each of which starts fast and slows
+ *  down like kinetic scrolling.
+ *  @param[in] frames the number of frames
+ *  @returns the trace */
+static ScrollTrace flickTrace(int frames)
+{
+    ScrollTrace trace;
+    trace.name = "flick";
+
+    double velocity = 0.0;
+    double position = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        if (velocity < 0.5) {
+            velocity = 60.0; // Rows per frame.
+        }
+
+        const double previous = position;
+        position += velocity;
+        velocity *= 0.95;
+        addStep(trace, ScrollStep::SCROLL_BY,
+            qRound(position) - qRound(previous));
+    }
+
+    return trace;
+}
+
+/** Create a trace that pages down once per frame.
+ *  @param[in] frames the number of frames
+ *  @returns the trace */
+static ScrollTrace pageDownTrace(int frames)
+{
+    ScrollTrace trace;
+    trace.name = "page_down";
+    for (int frame = 0; frame < frames; ++frame) {
+        addStep(trace, ScrollStep::PAGE, 1.0);
+    }
+
+    return trace;
+}
+
+/** Create a trace that drags the thumb of the scroll bar to the end, and
+ *  then keeps it there until the whole table is fetched.
+ *  @param[in] frames the number of frames of the drag
+ *  @returns the trace */
+static ScrollTrace dragToEndTrace(int frames)
+{
+    ScrollTrace trace;
+    trace.name = "drag_to_end";
+    for (int frame = 1; frame <= frames; ++frame) {
+        addStep(trace, ScrollStep::DRAG, static_cast<double>(frame) / frames);
+    }
+    addStep(trace, ScrollStep::END, 1.0);
+
+    return trace;
+}
+
+/** Read a trace file.
+ *  @param[in] filepath the path of the trace file
+ *  @param[out] trace the trace, named after the file
+ *  @returns true on success, false otherwise */
+static bool loadTrace(const QString &filepath, ScrollTrace &trace)
+{
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        std::cerr << "Failed to open the trace " << qPrintable(filepath)
+                  << std::endl;
+        return false;
+    }
+
+    trace.name = QFileInfo(filepath).completeBaseName();
+    trace.steps.clear();
+
+    QTextStream stream(&file);
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        const QStringList words = line.split(QLatin1Char(' '),
+            QString::SkipEmptyParts);
+        bool valid = (words.size() <= 2);
+        const double amount = (words.size() == 2
+            ? words.at(1).toDouble(&valid) : 1.0);
+        const QString &kind = words.first();
+        if (valid && "by" == kind) {
+            addStep(trace, ScrollStep::SCROLL_BY, amount);
+        } else if (valid && "to" == kind) {
+            addStep(trace, ScrollStep::SCROLL_TO, amount);
+        } else if (valid && "page" == kind) {
+            addStep(trace, ScrollStep::PAGE, amount);
+        } else if (valid && "drag" == kind) {
+            addStep(trace, ScrollStep::DRAG, amount);
+        } else if (valid && "end" == kind) {
+            addStep(trace, ScrollStep::END, 1.0);
+        } else {
+            std::cerr << qPrintable(filepath) << ":" << lineNumber
+                      << ": invalid step \"" << qPrintable(line) << "\""
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Run the event loop until the main window shows the rows of a table.
+ *  @param[in] window the main window, which loads its document
+ *  @returns the list view, or 0 if the document failed to load in time */
+static QlomListView * waitForTable(QlomMainWindow &window)
+{
+    // Wakes the event loop up, so that the timeout is noticed.
+    QTimer ticker;
+    ticker.start(100);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (window.isValid() && timer.elapsed() < loadTimeoutMsecs) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+        QlomListView *view = window.findChild<QlomListView *>();
+        if (view && view->isVisible() && view->model()
+            && view->model()->rowCount() > 0) {
+            // Settle the layout and the first paint before measuring.
+            QCoreApplication::processEvents();
+            view->viewport()->repaint();
+            return view;
+        }
+    }
+
+    return 0;
+}
+
+/** Replay a step of a trace, and paint the resulting frame.
+ *  @param[in] view the list view
+ *  @param[in] step the step
+ *  @returns the time of the frame, in milliseconds */
+static double replayFrame(QlomListView *view, const ScrollStep &step)
+{
+    QScrollBar *scrollBar = view->verticalScrollBar();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    switch (step.kind) {
+    case ScrollStep::SCROLL_BY:
+        scrollBar->setValue(scrollBar->value() + qRound(step.amount));
+        break;
+    case ScrollStep::SCROLL_TO:
+        scrollBar->setValue(qRound(step.amount));
+        break;
+    case ScrollStep::PAGE:
+        scrollBar->setValue(scrollBar->value()
+            + qRound(step.amount * scrollBar->pageStep()));
+        break;
+    default:
+        scrollBar->setValue(qRound(step.amount * scrollBar->maximum()));
+        break;
+    }
+
+    /* Run the delayed layouts and the fetches that the scroll triggered, as
+     * the event loop would before the next paint. */
+    QCoreApplication::processEvents();
+    view->viewport()->repaint();
+
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+/** Replay a trace, from the top of the table.
+ *  @param[in] view the list view
+ *  @param[in] trace the trace
+ *  @returns the frames of the trace */
+static ReplayResult replayTrace(QlomListView *view, const ScrollTrace &trace)
+{
+    ReplayResult result;
+    result.droppedFrames = 0;
+    result.fetchFrames = 0;
+    result.fetchStalls = 0;
+
+    view->scrollToTop();
+    QCoreApplication::processEvents();
+    view->viewport()->repaint();
+
+    const QAbstractItemModel *model = view->model();
+    for (QVector<ScrollStep>::const_iterator iter = trace.steps.begin();
+         iter != trace.steps.end();
+         ++iter) {
+        // An END step is repeated for as long as it fetches rows.
+        bool fetched = true;
+        for (int frame = 0; fetched && frame < maxEndFrames; ++frame) {
+            const int rows = model->rowCount();
+            const double msecs = replayFrame(view, *iter);
+            fetched = (model->rowCount() != rows);
+
+            result.frameMsecs.push_back(msecs);
+            result.droppedFrames += static_cast<int>(msecs / frameBudgetMsecs);
+            if (fetched) {
+                ++result.fetchFrames;
+                if (msecs > frameBudgetMsecs) {
+                    ++result.fetchStalls;
+                }
+            }
+
+            if (ScrollStep::END != (*iter).kind) {
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/** Get a percentile of sorted samples, by the nearest-rank method.
+ *  @param[in] sorted the samples, in ascending order
+ *  @param[in] percentile the percentile, from 0 to 100
+ *  @returns the sample, or 0 if there are none */
+static double nearestRank(const QVector<double> &sorted, int percentile)
+{
+    if (sorted.isEmpty()) {
+        return 0.0;
+    }
+
+    const int rank = (percentile * sorted.size() + 99) / 100;
+    return sorted.at(qBound(1, rank, sorted.size()) - 1);
+}
+
+/** Get the peak resident set size of the process.
+ *  @returns the size in kilobytes */
+static double peakRssKbytes()
+{
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+        return 0.0;
+    }
+
+    return usage.ru_maxrss; // Kilobytes, on Linux.
+}
+
+/** Replay traces over a newly opened document.
+ *  @param[in] filepath the path of the Glom document
+ *  @param[in] traces the traces to replay
+ *  @param[in,out] results the results to add the measurements to
+ *  @returns true on success, false otherwise */
+static bool measure(const QString &filepath, const QList<ScrollTrace> &traces,
+    QlomBenchResults &results)
+{
+    QlomMainWindow window(filepath);
+    window.resize(windowSize);
+
+    QlomListView *view = waitForTable(window);
+    if (!view) {
+        std::cerr << "Failed to show the default table of "
+                  << qPrintable(filepath) << std::endl;
+        return false;
+    }
+
+    for (QList<ScrollTrace>::const_iterator iter = traces.begin();
+         iter != traces.end();
+         ++iter) {
+        const ReplayResult replay = replayTrace(view, *iter);
+        QVector<double> sorted(replay.frameMsecs);
+        std::sort(sorted.begin(), sorted.end());
+
+        const QString &name = (*iter).name;
+        results.addSample(name + "_frames_count", sorted.size());
+        results.addSample(name + "_frame_p50_ms", nearestRank(sorted, 50));
+        results.addSample(name + "_frame_p95_ms", nearestRank(sorted, 95));
+        results.addSample(name + "_frame_p99_ms", nearestRank(sorted, 99));
+        results.addSample(name + "_frame_max_ms",
+            sorted.isEmpty() ? 0.0 : sorted.last());
+        results.addSample(name + "_dropped_frames_count",
+            replay.droppedFrames);
+        results.addSample(name + "_fetch_frames_count", replay.fetchFrames);
+        results.addSample(name + "_fetch_stalls_count", replay.fetchStalls);
+    }
+
+    return true;
+}
+
+/** Record a trace while the user scrolls the default table of a document.
+ *  @param[in] filepath the path of the Glom document
+ *  @param[in] traceFilepath the path of the trace file to write
+ *  @returns the exit code of the application */
+static int record(const QString &filepath, const QString &traceFilepath)
+{
+    QFile file(traceFilepath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        std::cerr << "Failed to open the trace " << qPrintable(traceFilepath)
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    QTextStream stream(&file);
+    stream << "# Recorded over " << QFileInfo(filepath).fileName()
+           << ", in a " << windowSize.width() << "x" << windowSize.height()
+           << " window.\n";
+
+    QlomMainWindow window(filepath);
+    window.resize(windowSize);
+
+    QlomListView *view = waitForTable(window);
+    if (!view) {
+        std::cerr << "Failed to show the default table of "
+                  << qPrintable(filepath) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    new ScrollRecorder(view, stream);
+    std::cout << "Recording to " << qPrintable(traceFilepath)
+              << " until the window is closed." << std::endl;
+    return QCoreApplication::exec();
+}
+
+int main(int argc, char **argv)
+{
+    bool recording = false;
+    for (int index = 1; index < argc; ++index) {
+        QString value;
+        if (isBenchOption(QString::fromLocal8Bit(argv[index]), "--record",
+                value)) {
+            recording = true;
+        }
+    }
+
+    // Replays do not need a display, but recordings do.
+    if (!recording && qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    int frames = defaultFrames;
+    int repetitions = defaultRepetitions;
+    QStringList traceNames;
+    traceNames << "flick" << "page-down" << "drag-to-end";
+    QStringList traceFilepaths;
+    QString recordFilepath;
+    QString outputFilepath;
+    QString filepath;
+    bool valid = true;
+
+    const QStringList arguments = app.arguments();
+    for (QStringList::const_iterator iter = arguments.begin() + 1;
+         iter != arguments.end() && valid;
+         ++iter) {
+        QString value;
+        if (isBenchOption(*iter, "--traces", value)) {
+            traceNames = value.split(QLatin1Char(','),
+                QString::SkipEmptyParts);
+        } else if (isBenchOption(*iter, "--trace-file", value)) {
+            traceFilepaths.push_back(value);
+        } else if (isBenchOption(*iter, "--frames", value)) {
+            frames = value.toInt(&valid);
+            valid = valid && frames > 0;
+        } else if (isBenchOption(*iter, "--repeat", value)) {
+            repetitions = value.toInt(&valid);
+            valid = valid && repetitions > 0;
+        } else if (isBenchOption(*iter, "--record", value)) {
+            recordFilepath = value;
+            valid = !value.isEmpty();
+        } else if (isBenchOption(*iter, "--output", value)) {
+            outputFilepath = value;
+        } else if (filepath.isEmpty() && !(*iter).startsWith("--")) {
+            filepath = QFileInfo(*iter).absoluteFilePath();
+        } else {
+            valid = false;
+        }
+    }
+
+    QList<ScrollTrace> traces;
+    for (QStringList::const_iterator iter = traceNames.begin();
+         iter != traceNames.end() && valid;
+         ++iter) {
+        if ("flick" == *iter) {
+            traces.push_back(flickTrace(frames));
+        } else if ("page-down" == *iter) {
+            traces.push_back(pageDownTrace(frames));
+        } else if ("drag-to-end" == *iter) {
+            traces.push_back(dragToEndTrace(frames));
+        } else {
+            valid = false;
+        }
+    }
+    for (QStringList::const_iterator iter = traceFilepaths.begin();
+         iter != traceFilepaths.end() && valid;
+         ++iter) {
+        ScrollTrace trace;
+        if (!loadTrace(*iter, trace)) {
+            return EXIT_FAILURE;
+        }
+        traces.push_back(trace);
+    }
+
+    if (!valid || filepath.isEmpty()) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    if (recording) {
+        return record(filepath, recordFilepath);
+    }
+
+    QlomBenchResults results("qlom-bench-scroll");
+    results.setProperty("document", filepath);
+    results.setProperty("repetitions", repetitions);
+    results.setProperty("frames", frames);
+    results.setProperty("window_width", windowSize.width());
+    results.setProperty("window_height", windowSize.height());
+
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        if (!measure(filepath, traces, results)) {
+            return EXIT_FAILURE;
+        }
+    }
+    results.addSample("peak_rss_kb", peakRssKbytes());
+
+    results.print();
+    if (!outputFilepath.isEmpty() && !results.save(outputFilepath)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}